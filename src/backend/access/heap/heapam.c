@@ -1152,7 +1152,7 @@ fastgetattr(HeapTuple tup, int attnum, TupleDesc tupleDesc,
  * ----------------------------------------------------------------
  */
 void
-heap_scan_scan_prepare_dispatch(Relation rel, Snapshot snapshot)
+heap_scan_scan_prepare_dispatch(Relation rel, Snapshot snapshot, List *qual)
 {
 
 }
@@ -3,6 +3,9 @@
 #include "access/relscan.h"
 #include "access/skey.h"
 #include "access/memoryheapam.h"
+#include "access/hash.h"
+#include "access/stratnum.h"
+#include "access/transam.h"
 #include "access/valid.h"
 #include "catalog/namespace.h"
 #include "cdb/cdbsrlz.h"
@@ -10,16 +13,41 @@
 #include "executor/tuptable.h"
 #include "storage/objectfilerw.h"
 #include "utils/dispatchcat.h"
+#include "utils/fmgroids.h"
+#include "utils/inval.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+
+/*
+ * Keyed scans of the memory heap, which serve every catalog lookup on
+ * compute nodes, would otherwise test each tuple of the table. An index
+ * sorts the hash of one column of every tuple with the tuple's offset, and
+ * is built the first time a scan has an equality key on that column. The
+ * keys are still tested on every tuple returned.
+ */
+struct MemoryHeapIndexEntry
+{
+	uint32		hash;
+	int			offset;		/* offset of the tuple in tupleData */
+};
+
+typedef struct MemoryHeapIndex
+{
+	AttrNumber	attno;
+	Oid			eqfunc;
+	int			nentries;
+	MemoryHeapIndexEntry *entries;
+} MemoryHeapIndex;
 static MemoryHeapData memoryHeapData = {0};
 static MemoryHeapData *memHeapData = &memoryHeapData;
 MemoryContext memoryHeapContext = NULL;
+static MemoryContext memoryHeapDeltaContext = NULL;
 
 char *initCatalogBuf = NULL;
 int initCatalogBufSize = 0;
 
 static void MemoryHeapDataSetInternal(CdbCatalogNode *catalogNode, AuxNode *auxNode);
+static void MemoryHeapDropIndexes(CdbTableHtValue *relHtValue);
 
 bool
 MemoryHeapActive(void)
@@ -55,12 +83,51 @@ ClearMemoryHeapStorage(void)
 		MemoryContextReset(memoryHeapContext);
 
 	cdbCatAuxNode = NULL;
+	memoryHeapDeltaContext = NULL;
 
 	memHeapData->memTableHash = NULL;
 	memHeapData->fullxid = 0;
+	memHeapData->catalogVersion = 0;
 	BuildMemoryHeapStorage();
 }
 
+/*
+ * Memory for a delta reply of the catalog server. Its catalog tuples are
+ * copied into the memory heap, everything else in it is only kept until the
+ * next reply, so aux data of the previous query goes away here.
+ */
+MemoryContext
+MemoryHeapDeltaContext(void)
+{
+	HASH_SEQ_STATUS status;
+	CdbTableHtValue *relHtValue;
+
+	hash_seq_init(&status, memHeapData->memTableHash);
+	while ((relHtValue = hash_seq_search(&status)) != NULL)
+	{
+		if (relHtValue->relId >= FirstNormalObjectId)
+		{
+			MemoryHeapDropIndexes(relHtValue);
+			hash_search(memHeapData->memTableHash, &relHtValue->relId,
+						HASH_REMOVE, NULL);
+		}
+	}
+
+	if (cdbCatAuxNode)
+	{
+		cdbCatAuxNode->catalog = NULL;
+		cdbCatAuxNode->aux = NULL;
+	}
+
+	if (memoryHeapDeltaContext)
+		MemoryContextDelete(memoryHeapDeltaContext);
+	memoryHeapDeltaContext = AllocSetContextCreate(memoryHeapContext,
+												   "memory heap delta context",
+												   ALLOCSET_DEFAULT_SIZES);
+
+	return memoryHeapDeltaContext;
+}
+
 void
 MemoryHeapDataSetCat(CdbCatalogNode *catalog)
 {
@@ -151,6 +218,69 @@ MemoryHeapSetTableData(CatalogTableNode *tableNode)
 
 	relHtValue->tupleDataSize = tableNode->tupleDataSize;
 	relHtValue->tupleData = tableNode->tupleData;
+	relHtValue->indexes = NIL;
+}
+
+/*
+ * Add the catalog tuples of a delta to those already held. The node then
+ * lists all of them again, as QEs are sent the whole catalog.
+ */
+static void
+MemoryHeapMergeTableData(CdbCatalogNode *catalogNode)
+{
+	HASH_SEQ_STATUS status;
+	CdbTableHtValue *relHtValue;
+	ListCell   *lc;
+	MemoryContext oldCtx;
+
+	foreach(lc, catalogNode->tableList)
+	{
+		CatalogTableNode *tableNode = lfirst(lc);
+		bool		exist;
+
+		relHtValue = hash_search(memHeapData->memTableHash, &tableNode->relId,
+								 HASH_ENTER, &exist);
+		if (!exist)
+		{
+			relHtValue->tupleDataSize = 0;
+			relHtValue->tupleData = palloc(tableNode->tupleDataSize);
+			relHtValue->indexes = NIL;
+		}
+		else
+		{
+			MemoryHeapDropIndexes(relHtValue);
+			relHtValue->tupleData = repalloc(relHtValue->tupleData,
+											 relHtValue->tupleDataSize +
+											 tableNode->tupleDataSize);
+		}
+
+		memcpy(relHtValue->tupleData + relHtValue->tupleDataSize,
+			   tableNode->tupleData, tableNode->tupleDataSize);
+		relHtValue->tupleDataSize += tableNode->tupleDataSize;
+	}
+
+	/* lookups that found nothing before may be cached as negative entries */
+	if (catalogNode->tableList != NIL)
+		InvalidateSystemCaches();
+
+	oldCtx = MemoryContextSwitchTo(memoryHeapDeltaContext);
+
+	catalogNode->tableList = NIL;
+	hash_seq_init(&status, memHeapData->memTableHash);
+	while ((relHtValue = hash_seq_search(&status)) != NULL)
+	{
+		CatalogTableNode *tableNode;
+
+		tableNode = makeNode(CatalogTableNode);
+		tableNode->relId = relHtValue->relId;
+		tableNode->tupleData = relHtValue->tupleData;
+		tableNode->tupleDataSize = relHtValue->tupleDataSize;
+
+		catalogNode->tableList = lappend(catalogNode->tableList, tableNode);
+	}
+	catalogNode->catalog_delta = false;
+
+	MemoryContextSwitchTo(oldCtx);
 }
 
 static void
@@ -168,6 +298,7 @@ MemoryHeapDataSetInternal(CdbCatalogNode *catalogNode, AuxNode *auxNode)
 		ListCell   *lc;
 
 		memHeapData->fullxid = catalogNode->full_xid;
+		memHeapData->catalogVersion = catalogNode->catalog_version;
 		FillTempNamespace(catalogNode->namespace_1,
 						  catalogNode->namespace_2);
 		S3SetBucketId(catalogNode->CatalogServerId);
@@ -179,8 +310,11 @@ MemoryHeapDataSetInternal(CdbCatalogNode *catalogNode, AuxNode *auxNode)
 		}
 
 		/* Fill data to memory table */
-		foreach(lc, catalogNode->tableList)
-			MemoryHeapSetTableData(lfirst(lc));
+		if (catalogNode->catalog_delta)
+			MemoryHeapMergeTableData(catalogNode);
+		else
+			foreach(lc, catalogNode->tableList)
+				MemoryHeapSetTableData(lfirst(lc));
 	}
 
 	if (auxNode)
@@ -195,6 +329,190 @@ MemoryHeapDataSetInternal(CdbCatalogNode *catalogNode, AuxNode *auxNode)
 	MemoryContextSwitchTo(oldCtx);
 }
 
+static void
+MemoryHeapDropIndexes(CdbTableHtValue *relHtValue)
+{
+	ListCell   *lc;
+
+	foreach(lc, relHtValue->indexes)
+	{
+		MemoryHeapIndex *index = lfirst(lc);
+
+		pfree(index->entries);
+	}
+	list_free_deep(relHtValue->indexes);
+	relHtValue->indexes = NIL;
+}
+
+/*
+ * Hash a value compared with eqfunc, so that values it finds equal hash
+ * alike. Returns false for equality operators we have no hash for.
+ */
+static bool
+MemoryHeapHashValue(Oid eqfunc, Datum value, uint32 *hash)
+{
+	switch (eqfunc)
+	{
+		case F_OIDEQ:
+			*hash = DatumGetUInt32(hash_uint32((uint32) DatumGetObjectId(value)));
+			return true;
+		case F_INT2EQ:
+			*hash = DatumGetUInt32(hash_uint32((uint32) DatumGetInt16(value)));
+			return true;
+		case F_INT4EQ:
+			*hash = DatumGetUInt32(hash_uint32((uint32) DatumGetInt32(value)));
+			return true;
+		case F_CHAREQ:
+			*hash = DatumGetUInt32(hash_uint32((uint32) DatumGetChar(value)));
+			return true;
+		case F_BOOLEQ:
+			*hash = DatumGetUInt32(hash_uint32((uint32) DatumGetBool(value)));
+			return true;
+		case F_NAMEEQ:
+			{
+				/* the key may be a plain C string rather than a padded name */
+				char	   *str = DatumGetCString(value);
+
+				*hash = DatumGetUInt32(hash_any((unsigned char *) str,
+												strnlen(str, NAMEDATALEN)));
+				return true;
+			}
+		default:
+			return false;
+	}
+}
+
+static int
+MemoryHeapIndexEntryCmp(const void *a, const void *b)
+{
+	const MemoryHeapIndexEntry *ea = a;
+	const MemoryHeapIndexEntry *eb = b;
+
+	if (ea->hash != eb->hash)
+		return ea->hash < eb->hash ? -1 : 1;
+	if (ea->offset != eb->offset)
+		return ea->offset < eb->offset ? -1 : 1;
+	return 0;
+}
+
+static MemoryHeapIndex *
+MemoryHeapGetIndex(CdbTableHtValue *relHtValue, TupleDesc tupdesc,
+				   AttrNumber attno, Oid eqfunc)
+{
+	MemoryHeapIndex *index;
+	MemoryContext oldCtx;
+	ListCell   *lc;
+	HeapTuple	tuple;
+	int			curIndex = 0;
+	int			offset = 0;
+
+	foreach(lc, relHtValue->indexes)
+	{
+		index = lfirst(lc);
+		if (index->attno == attno && index->eqfunc == eqfunc)
+			return index;
+	}
+
+	oldCtx = MemoryContextSwitchTo(memoryHeapContext);
+
+	index = palloc(sizeof(MemoryHeapIndex));
+	index->attno = attno;
+	index->eqfunc = eqfunc;
+	index->nentries = 0;
+	index->entries = palloc(sizeof(MemoryHeapIndexEntry) *
+							Max(relHtValue->tupleDataSize /
+								(int) (sizeof(HeapTupleData) + SizeofHeapTupleHeader),
+								1));
+
+	while ((tuple = TupleDataGetNext(relHtValue->tupleData, &curIndex,
+									 relHtValue->tupleDataSize)) != NULL)
+	{
+		Datum		value;
+		bool		isnull;
+
+		value = heap_getattr(tuple, attno, tupdesc, &isnull);
+		if (!isnull)
+		{
+			MemoryHeapIndexEntry *entry = &index->entries[index->nentries++];
+
+			MemoryHeapHashValue(eqfunc, value, &entry->hash);
+			entry->offset = offset;
+		}
+		offset = curIndex;
+	}
+
+	qsort(index->entries, index->nentries, sizeof(MemoryHeapIndexEntry),
+		  MemoryHeapIndexEntryCmp);
+
+	relHtValue->indexes = lappend(relHtValue->indexes, index);
+
+	MemoryContextSwitchTo(oldCtx);
+
+	return index;
+}
+
+/*
+ * Limit the scan to the index entries whose hash matches an equality key,
+ * if one of the keys allows it.
+ */
+static void
+MemoryHeapIndexScan(MemoryHeapDesc scan)
+{
+	Relation	rel = scan->rs_base.rs_rd;
+	CdbTableHtValue *relHtValue;
+	MemoryHeapIndex *index;
+	ScanKey		key = NULL;
+	uint32		hash;
+	int			lo;
+	int			hi;
+	int			i;
+
+	for (i = 0; i < scan->rs_base.rs_nkeys; i++)
+	{
+		ScanKey		cur = &scan->rs_base.rs_key[i];
+
+		if (cur->sk_flags == 0 &&
+			cur->sk_strategy == BTEqualStrategyNumber &&
+			cur->sk_attno > 0 &&
+			MemoryHeapHashValue(cur->sk_func.fn_oid, cur->sk_argument, &hash))
+		{
+			key = cur;
+			break;
+		}
+	}
+
+	if (key == NULL)
+		return;
+
+	relHtValue = hash_search(memHeapData->memTableHash, &RelationGetRelid(rel),
+							 HASH_FIND, NULL);
+	if (relHtValue == NULL)
+		return;
+
+	index = MemoryHeapGetIndex(relHtValue, RelationGetDescr(rel),
+							   key->sk_attno, key->sk_func.fn_oid);
+
+	/* first entry with the hash */
+	lo = 0;
+	hi = index->nentries;
+	while (lo < hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		if (index->entries[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	scan->idxEntries = index->entries;
+	scan->idxCur = lo;
+	scan->idxEnd = lo;
+	while (scan->idxEnd < index->nentries &&
+		   index->entries[scan->idxEnd].hash == hash)
+		scan->idxEnd++;
+}
+
 char *
 memoryTableGetData(Oid relid, int *size)
 {
@@ -233,6 +551,10 @@ MemoryHeapBeginScan(Relation relation, int nkeys, ScanKey key)
 										 &scan->tupleDataSize);
 	scan->curIndex = 0;
 
+	scan->idxEntries = NULL;
+	if (scan->tupleData != NULL && nkeys > 0)
+		MemoryHeapIndexScan(scan);
+
 	return (TableScanDesc) scan;
 }
 
@@ -249,9 +571,25 @@ MemoryHeapGetNextSlot(TableScanDesc sscan, TupleTableSlot *slot)
 	HeapTuple		tuple;
 	bool			testResult = true;
 
-	while ((tuple = TupleDataGetNext(scan->tupleData, &scan->curIndex,
-					scan->tupleDataSize)) != NULL)
+	for (;;)
 	{
+		if (scan->idxEntries)
+		{
+			tuple = NULL;
+			if (scan->idxCur < scan->idxEnd)
+			{
+				int			curIndex = scan->idxEntries[scan->idxCur++].offset;
+
+				tuple = TupleDataGetNext(scan->tupleData, &curIndex,
+										 scan->tupleDataSize);
+			}
+		}
+		else
+			tuple = TupleDataGetNext(scan->tupleData, &scan->curIndex,
+									 scan->tupleDataSize);
+
+		if (tuple == NULL)
+			break;
 
 
 		if (scan->rs_base.rs_key != NULL)
@@ -277,3 +615,9 @@ MemoryHeapGetFullXid(void)
 {
 	return memHeapData->fullxid;
 }
+
+uint64
+MemoryHeapGetCatalogVersion(void)
+{
+	return memHeapData->catalogVersion;
+}
@@ -1,21 +1,41 @@
 #include "postgres.h"
 
 #include "access/genam.h"
+#include "access/transam.h"
 #include "catalog/heap.h"
+#include "catalog/index.h"
 #include "catalog/pg_tile.h"
 #include "access/tileam.h"
 #include "access/xact.h"
 #include "cdb/cdbcatalogfunc.h"
+#include "cdb/cdbsrlz.h"
+#include "cdb/cdbutil.h"
 #include "cdb/cdbvars.h"
+#include "common/base64.h"
 #include "commands/async.h"
+#include "commands/progress.h"
 #include "commands/vacuum.h"
+#include "executor/executor.h"
 #include "miscadmin.h"
 #include "libpq/libpq.h"
+#include "libpq/pqformat.h"
+#include "nodes/nodeFuncs.h"
+#include "pgstat.h"
+#include "optimizer/plancat.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
 #include "storage/predicate.h"
 #include "storage/objectfilerw.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
 #include "utils/builtins.h"
 #include "utils/dispatchcat.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/sampling.h"
+#include "utils/snapmgr.h"
+#include "utils/sortsupport.h"
+#include "utils/typcache.h"
 
 typedef struct TidBlockkey {
     uint32 blockid;
@@ -34,6 +54,7 @@ typedef struct TileDmlDescData
 {
     Relation mainRel;
     Relation visibilityRel;
+    Oid visiRelid;
 
     TileBuf *oldBuffer;
     uint32 oldBufferCurPtrTupNum; //0: invalid, starting from 1; used in copying data from old block to new block
@@ -42,10 +63,58 @@ typedef struct TileDmlDescData
     TileBuf *newBuffer;
     uint32 newBufferTupNum;  // only used in insertdesc. in order to cal tid
     List *visibilityInfo;
+
+    AttrNumber sortAttno;    // column inserted rows are sorted by, or 0
+    MemoryContext sortCtx;   // holds the sort buffer, NULL until needed
+    char *sortBuf;           // inserted rows waiting to be sorted
+    uint32 sortBufSize;
+    uint32 sortBufAlloc;     // room in sortBuf
+    uint32 *sortOffsets;     // where each row starts in sortBuf
+    uint32 sortTupNum;
+    uint32 sortMaxTuples;    // room in sortOffsets
 } TileDmlDescData;
 
 typedef TileDmlDescData *TileDmlDesc;
 
+/*
+ * State of a tile VACUUM. A block is garbage, object and index entries
+ * alike, once no version of the visibility tuple naming it may still be
+ * seen, and the transaction that wrote it ended before any running one
+ * started.
+ */
+typedef struct TileVacuumState
+{
+    HTAB *liveBlocks;           // names of blocks some snapshot may still see
+    HTAB *liveBlockids;         // block ids of their visibility tuples
+    FullTransactionId oldestXmin;
+    uint32 mergedBlocks;
+    uint32 newBlocks;
+    double removedObjects;
+    double removedBytes;
+    double removedIndexTuples;
+} TileVacuumState;
+
+/*
+ * Index fetches only return tuples of blocks the snapshot sees in the
+ * visibility relation. Those are collected on first use, with their keys,
+ * and the block read last is kept decoded.
+ */
+typedef struct TileVisibleBlock
+{
+    uint32 blockid;
+    TileKey key;
+} TileVisibleBlock;
+
+typedef struct IndexFetchTileData
+{
+    IndexFetchTableData xs_base;
+    Relation visiRel;
+    HTAB *visibleBlocks;        // TileVisibleBlocks, NULL until first fetch
+    Snapshot visibleSnapshot;
+    CommandId visibleCid;
+    TileBuf *buffer;
+} IndexFetchTileData;
+
 typedef struct TileDmlState
 {
     TileDmlDesc dmlDesc;
@@ -54,30 +123,293 @@ typedef struct TileDmlState
 
 void *s3Client = NULL;
 
+int tile_prefetch_blocks = 4;
+int tile_upload_parts = 4;
+int tile_merge_threshold = 50;
+char *tile_sort_key = NULL;
+
+/* initial room for inserted rows sorted together by tile_sort_key */
+#define TILE_SORT_INITIAL_SIZE (1024 * 1024)
+
+/* rows ANALYZE takes from each block it picks */
+#define TILE_ANALYZE_BLOCK_ROWS 300
+
+/*
+ * A block handed to S3 by set_page() that may still be going up. The
+ * encoded data belongs to the upload until it has been waited for.
+ */
+typedef struct TilePendingUpload
+{
+    void *request;
+    char *data;
+} TilePendingUpload;
+
+/* pending uploads, oldest first, in TopTransactionContext */
+static List *tilePendingUploads = NIL;
+
+/*
+ * Block changes of a relation made in one subtransaction, not yet sent to
+ * the catalog server.
+ */
+typedef struct TilePendingVisi
+{
+    SubTransactionId subid;
+    Oid relid;
+    List *visiInfo;		// BlockDesc2s
+} TilePendingVisi;
+
+/*
+ * Visibility changes of the statement, in the order they were made, to be
+ * sent to the catalog server in a single batch. Those of a subtransaction
+ * that aborts are dropped. In TopTransactionContext.
+ */
+static List *tilePendingVisi = NIL;
+
+/*
+ * Scans not ended yet. When a subtransaction aborts, the reads ahead of the
+ * scans it started are drained before their memory goes away, see
+ * tile_subxact_callback. In TopTransactionContext.
+ */
+static List *tileOpenScans = NIL;
+
+/* object as read from storage, before it is decoded into a TileBuf */
+static char *tileObjectBuf = NULL;
+
+/*
+ * Stored size and tuple count of a tile table, summed over its visibility
+ * relation. Sums are taken once per transaction and carried along by the
+ * blocks this backend writes; a block replaced or deleted drops the entry,
+ * as its old size is not at hand, and the next caller sums again.
+ */
+typedef struct TileRelTotals
+{
+    Oid relid;
+    uint64 bytes;
+    double tuples;
+} TileRelTotals;
+
+/* in TopTransactionContext, NULL until first used */
+static HTAB *tileRelTotals = NULL;
+
+/*
+ * On the QD, how far the QEs running one dynamic scan have got through the
+ * visibility tuples it was dispatched, see tile_claim_next.
+ */
+typedef struct TileClaimKey
+{
+    int32 commandCount;
+    int32 sliceId;
+    int32 planNodeId;
+    Oid visiRelid;
+} TileClaimKey;
+
+typedef struct TileClaim
+{
+    TileClaimKey key;
+    char *tupleData;	// copy of the aux node's visibility tuples
+    int tupleDataSize;
+    int curIndex;		// where the next claim starts
+    int remaining;		// tuples not claimed yet
+} TileClaim;
+
+/* in TopTransactionContext, NULL until first used */
+static HTAB *tileClaims = NULL;
+
+/*
+ * Tile TIDs carry the block id, not the block key. Outside the catalog
+ * server the visibility tuples come from the QD and cannot be fetched by
+ * TID, so the keys of the blocks listed are remembered here until the
+ * transaction ends, see tile_blockid_get_key.
+ */
+typedef struct TileBlockKeyTag
+{
+    Oid visiRelid;
+    uint32 blockid;
+} TileBlockKeyTag;
+
+typedef struct TileBlockKeyEntry
+{
+    TileBlockKeyTag tag;
+    TileKey key;
+} TileBlockKeyEntry;
+
+/* in TopTransactionContext, NULL until first used */
+static HTAB *tileBlockKeys = NULL;
+
 static void set_page(TileDmlDesc dmlDesc);
 
 static void tile_init_scan(TileScanDesc scan);
 
-static List *tile_get_visi(Relation visiRel, Snapshot snapshot);
+static List *tile_get_visi(Relation visiRel, Snapshot snapshot, List *zoneKeys);
 
 static bool tile_get_page(TileScanDesc desc, BLOCKMOVE page_move);
 static void tile_release_buf(TileBuf *tileBuffer);
 
-static TileKey tid_get_blockkey(ItemPointer tid);
+static TileKey tile_blockid_get_key(Oid visiRelid, uint32 blockid);
 static void MoveAfterToNewPage(TileDmlDesc desc);
 static void FinishTransForCurrentBlock(TileDmlDesc desc);
 static void getblock_internal(TileScanDesc scanDesc);
+static TilePrefetchBuf *tile_prefetch_lookup(TileScanDesc scan, uint32 pageIdx);
+static bool tile_prefetch_wanted(TileScanDesc scan, uint32 pageIdx);
+static TilePrefetchBuf *tile_prefetch_victim(TileScanDesc scan);
+static void tile_prefetch_fetch(TileScanDesc scan, TilePrefetchBuf *slot,
+                                BlockDesc *blockDesc);
+static void tile_prefetch_columns(TileScanDesc scan, TilePrefetchBuf *slot,
+                                  BlockDesc *blockDesc);
+static void tile_prefetch_header(TileScanDesc scan, TilePrefetchBuf *slot,
+                                 bool wait);
+static void tile_prefetch_wait(TileScanDesc scan, TilePrefetchBuf *slot);
+static void tile_prefetch_fill_cache(TileScanDesc scan, TilePrefetchBuf *slot,
+                                     BlockDesc *blockDesc);
+static void tile_prefetch_cancel(TilePrefetchBuf *slot);
+static void tile_prefetch_issue(TileScanDesc scan);
+static void tile_prefetch_release(TileScanDesc scan);
+static bool tile_parallel_claim(TileScanDesc scan, uint32 *pageIdx);
+static bool tile_claim_blocks(TileScanDesc scan);
+static void tile_xact_callback(XactEvent event, void *arg);
+static void tile_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                                  SubTransactionId parentSubid, void *arg);
+static void tile_upload_wait(bool all);
+static TileRelTotals *tile_relation_totals(Relation rel);
+static void tile_totals_add(Relation rel, uint32 bytes, uint32 tuples);
+static void tile_totals_forget(Relation rel);
 
 static TileDmlDesc getDmlDesc(Relation relation);
 static TileFetchDesc get_fetch_descriptor(Relation relation);
 
 static void tile_update_finish(TileDmlDesc dmlDesc);
+static void tile_sort_flush(TileDmlDesc dmlDesc);
+static void tile_sort_release(TileDmlDesc dmlDesc);
+static void tile_index_block_tuples(Relation rel, TileBuf *buf, uint32 blockid);
 static bool tile_fetch(Relation rel, TileFetchDesc desc, ItemPointer tid,
                        Snapshot snapshot, TupleTableSlot *slot);
 static void tile_fetch_finish(TileFetchDesc desc);
 void s3_init(void)
 {
     s3Client = S3InitAccess();
+    RegisterXactCallback(tile_xact_callback, NULL);
+    RegisterSubXactCallback(tile_subxact_callback, NULL);
+}
+
+/*
+ * Read-ahead requests write into scan memory from SDK threads, and uploads
+ * read from transaction memory. If the transaction aborts before they are
+ * waited for, drain them here, before the memory contexts holding their
+ * buffers are reset. A commit must not go through before every block it
+ * refers to is in the bucket.
+ */
+static void
+tile_xact_callback(XactEvent event, void *arg)
+{
+    switch (event) {
+        case XACT_EVENT_PRE_COMMIT:
+        case XACT_EVENT_PARALLEL_PRE_COMMIT:
+        case XACT_EVENT_PRE_PREPARE:
+            tile_upload_wait(true);
+            break;
+        case XACT_EVENT_ABORT:
+        case XACT_EVENT_PARALLEL_ABORT:
+            S3GetObjectCancelAll();
+            S3PutObjectCancelAll(s3Client);
+            tilePendingUploads = NIL;
+            tilePendingVisi = NIL;
+            tileOpenScans = NIL;
+            tileRelTotals = NULL;
+            tileClaims = NULL;
+            tileBlockKeys = NULL;
+            break;
+        case XACT_EVENT_COMMIT:
+        case XACT_EVENT_PARALLEL_COMMIT:
+        case XACT_EVENT_PREPARE:
+            tilePendingUploads = NIL;
+            tilePendingVisi = NIL;
+            tileOpenScans = NIL;
+            tileRelTotals = NULL;
+            tileClaims = NULL;
+            tileBlockKeys = NULL;
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * A subtransaction that aborts frees the memory of the scans it started,
+ * without ending them. Wait for their reads ahead here, before the SDK
+ * threads can write into freed buffers. Its block changes are dropped, so
+ * that they never reach the catalog server. Scans and block changes of a
+ * subtransaction that commits belong to its parent from then on.
+ */
+static void
+tile_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                      SubTransactionId parentSubid, void *arg)
+{
+    ListCell *lc;
+    ListCell *prev = NULL;
+    ListCell *next;
+
+    if (event != SUBXACT_EVENT_ABORT_SUB && event != SUBXACT_EVENT_COMMIT_SUB)
+        return;
+
+    for (lc = list_head(tileOpenScans); lc != NULL; lc = next) {
+        TileScanDesc scan = (TileScanDesc) lfirst(lc);
+        int i;
+
+        next = lnext(lc);
+        if (scan->subid != mySubid) {
+            prev = lc;
+            continue;
+        }
+
+        if (event == SUBXACT_EVENT_COMMIT_SUB) {
+            scan->subid = parentSubid;
+            prev = lc;
+            continue;
+        }
+
+        for (i = 0; i < scan->ringSize; i++)
+            tile_prefetch_cancel(&scan->ring[i]);
+        tileOpenScans = list_delete_cell(tileOpenScans, lc, prev);
+    }
+
+    prev = NULL;
+    for (lc = list_head(tilePendingVisi); lc != NULL; lc = next) {
+        TilePendingVisi *pending = lfirst(lc);
+
+        next = lnext(lc);
+        if (pending->subid != mySubid) {
+            prev = lc;
+            continue;
+        }
+
+        if (event == SUBXACT_EVENT_COMMIT_SUB) {
+            pending->subid = parentSubid;
+            prev = lc;
+            continue;
+        }
+
+        tilePendingVisi = list_delete_cell(tilePendingVisi, lc, prev);
+    }
+}
+
+/*
+ * Finish the uploads set_page() started, oldest first. Unless all is set,
+ * stop at the first one still on its way.
+ */
+static void
+tile_upload_wait(bool all)
+{
+    while (tilePendingUploads != NIL) {
+        TilePendingUpload *upload = linitial(tilePendingUploads);
+
+        if (!all && !S3PutObjectDone(upload->request))
+            break;
+
+        tilePendingUploads = list_delete_first(tilePendingUploads);
+        S3PutObjectWait(s3Client, upload->request);
+        pfree(upload->data);
+        pfree(upload);
+    }
 }
 
 void s3_destroy(void)
@@ -91,6 +423,7 @@ release_tile_dml_state(Relation rel) {
     if (rel->tileDmlDesc) {
         tile_release_buf(rel->tileDmlDesc->oldBuffer);
         tile_release_buf(rel->tileDmlDesc->newBuffer);
+        tile_sort_release(rel->tileDmlDesc);
         pfree(rel->tileDmlDesc);
         rel->tileDmlDesc = NULL;
     }
@@ -111,6 +444,9 @@ tile_init_buf(void) {
 
     buf->bufStartPtr = MemoryContextAlloc(CacheMemoryContext, TILE_BLOCK_SIZE);
     buf->bufSize = 0;
+    buf->tupleOffsets = MemoryContextAlloc(CacheMemoryContext,
+                                           sizeof(uint32) * TILE_MAX_TUPLES);
+    buf->tupleNum = 0;
     return buf;
 }
 
@@ -139,6 +475,9 @@ tile_init_buf_with_tid(void) {
     buf->blockid = 0;
     buf->bufStartPtr = MemoryContextAlloc(CacheMemoryContext, TILE_BLOCK_SIZE);
     buf->bufSize = 0;
+    buf->tupleOffsets = MemoryContextAlloc(CacheMemoryContext,
+                                           sizeof(uint32) * TILE_MAX_TUPLES);
+    buf->tupleNum = 0;
     buf->key = tile_new_blockkey();
 
     return buf;
@@ -148,6 +487,7 @@ static void
 tile_reset_buf(TileBuf *buf) {
     buf->blockid = 0;
     buf->bufSize = 0;
+    buf->tupleNum = 0;
     buf->key = tile_new_blockkey();
 }
 
@@ -158,6 +498,8 @@ tile_release_buf(TileBuf *tileBuffer) {
 
     if (tileBuffer->bufStartPtr)
         pfree(tileBuffer->bufStartPtr);
+    if (tileBuffer->tupleOffsets)
+        pfree(tileBuffer->tupleOffsets);
 
     pfree(tileBuffer);
 }
@@ -168,15 +510,43 @@ tile_read_buf(Relation relation, ItemPointerData tid, TileKey key,
                 TileBuf *buf) {
     char *block_name;
     char *bucket_name;
+    uint32 size;
 
     // find the target old block
     block_name = GetBlockNameFromKey(key);
     bucket_name = TileMakeBucketPath(relation->rd_node);
     buf->blockid = tile_tid_get_blockid(tid);
     buf->key = key;
-    buf->bufSize = S3GetObject2(s3Client, bucket_name, block_name, buf->bufStartPtr);
-    Assert(buf->bufSize > 0);
-    Assert(buf->bufSize <= TILE_BLOCK_SIZE);
+
+    if (tileObjectBuf == NULL)
+        tileObjectBuf = MemoryContextAlloc(CacheMemoryContext, TILE_BLOCK_SIZE);
+
+    // the block may be one this transaction is still uploading
+    tile_upload_wait(true);
+
+    size = tile_cache_read(bucket_name, block_name, 0, 0, tileObjectBuf);
+    if ((int32) size < 0) {
+        size = S3GetObject2(s3Client, bucket_name, block_name, tileObjectBuf);
+        tile_cache_insert(bucket_name, block_name, 0, 0, tileObjectBuf, size);
+    }
+    Assert(size > 0);
+    Assert(size <= TILE_BLOCK_SIZE);
+
+    if (tile_block_is_columnar(tileObjectBuf, size)) {
+        buf->bufSize = tile_block_decode(RelationGetDescr(relation), tileObjectBuf,
+                                         NULL, buf->bufStartPtr, buf->tupleOffsets);
+        buf->tupleNum = tile_block_ntuples(tileObjectBuf);
+    } else {
+        // a row format object is already what the buffer should hold
+        char *tmp = buf->bufStartPtr;
+
+        buf->bufStartPtr = tileObjectBuf;
+        buf->bufSize = size;
+        buf->tupleNum = tile_block_row_offsets(buf->bufStartPtr, &buf->bufSize,
+                                               buf->tupleOffsets);
+        tileObjectBuf = tmp;
+    }
+
     pfree(block_name);
     pfree(bucket_name);
 }
@@ -190,19 +560,23 @@ tile_slot_callbacks(Relation relation)
 
 
 static void
-tile_scan_prepare_dispatch(Relation rel, Snapshot snapshot) {
+tile_scan_prepare_dispatch(Relation rel, Snapshot snapshot, List *qual) {
     Oid visiRelOid;
     Relation visiRel;
     MemoryContext oldCtx;
+    List *zoneKeys;
 
     if (!DataDispatcherActive())
         return;
 
+    // blocks the zone maps rule out are not shipped to the segments
+    zoneKeys = tile_zonemap_keys(rel, qual);
+
     oldCtx = MemoryContextSwitchTo(dataDispatchCtx);
 
     visiRelOid = PgTileGetVisiRelId(RelationGetRelid(rel));
     visiRel = table_open(visiRelOid, AccessShareLock);
-    tile_get_visi(visiRel, snapshot);
+    tile_get_visi(visiRel, snapshot, zoneKeys);
 
     table_close(visiRel, AccessShareLock);
 
@@ -211,11 +585,12 @@ tile_scan_prepare_dispatch(Relation rel, Snapshot snapshot) {
 
 
 static TableScanDesc
-tile_beginscan(Relation relation, Snapshot snapshot,
-               int nkeys, ScanKey key,
-               ParallelTableScanDesc parallel_scan,
-               uint32 flags) {
+tile_beginscan_internal(Relation relation, Snapshot snapshot,
+                        int nkeys, ScanKey key,
+                        ParallelTableScanDesc parallel_scan,
+                        uint32 flags, List *qual) {
     TileScanDesc scan;
+    MemoryContext oldCtx;
 
     RelationIncrementReferenceCount(relation);
 
@@ -241,7 +616,100 @@ tile_beginscan(Relation relation, Snapshot snapshot,
 
     tile_init_scan(scan);
 
-    scan->visiInfo = tile_get_visi(scan->visiRel, snapshot);
+    scan->subid = GetCurrentSubTransactionId();
+    oldCtx = MemoryContextSwitchTo(TopTransactionContext);
+    tileOpenScans = lappend(tileOpenScans, scan);
+    MemoryContextSwitchTo(oldCtx);
+
+    scan->zoneKeys = tile_zonemap_keys(relation, qual);
+    scan->visiInfo = tile_get_visi(scan->visiRel, snapshot, scan->zoneKeys);
+
+    return (TableScanDesc) scan;
+}
+
+static TableScanDesc
+tile_beginscan(Relation relation, Snapshot snapshot,
+               int nkeys, ScanKey key,
+               ParallelTableScanDesc parallel_scan,
+               uint32 flags) {
+    return tile_beginscan_internal(relation, snapshot, nkeys, key,
+                                   parallel_scan, flags, NIL);
+}
+
+struct TileExtractcolumnContext
+{
+    bool *cols;
+    AttrNumber natts;
+};
+
+static bool
+tile_extractcolumns_walker(Node *node, struct TileExtractcolumnContext *ecCtx)
+{
+    if (node == NULL)
+        return false;
+
+    if (IsA(node, Var)) {
+        Var *var = (Var *) node;
+
+        if (IS_SPECIAL_VARNO(var->varno))
+            return false;
+
+        if (var->varattno > 0 && var->varattno <= ecCtx->natts)
+            ecCtx->cols[var->varattno - 1] = true;
+        else if (var->varattno == 0) {
+            // whole-row reference
+            for (AttrNumber attno = 0; attno < ecCtx->natts; attno++)
+                ecCtx->cols[attno] = true;
+            return true;
+        }
+
+        return false;
+    }
+
+    return expression_tree_walker(node, tile_extractcolumns_walker, (void *) ecCtx);
+}
+
+/*
+ * Only the columns referenced by the targetlist and quals are fetched from
+ * columnar blocks, the others come back as NULL. If nothing is referenced,
+ * as for count(*), no chunk is read at all. Blocks whose zone maps refute
+ * the qual are not read either.
+ */
+static TableScanDesc
+tile_beginscan_extractcolumns(Relation rel, Snapshot snapshot,
+                              List *targetlist, List *qual, bool *proj,
+                              List *constraintList, uint32 flags)
+{
+    TileScanDesc scan;
+    AttrNumber natts = RelationGetNumberOfAttributes(rel);
+    bool *cols;
+    AttrNumber attno;
+
+    scan = (TileScanDesc) tile_beginscan_internal(rel, snapshot, 0, NULL, NULL,
+                                                  flags, qual);
+
+    cols = MemoryContextAllocZero(scan->scanCtx, sizeof(bool) * natts);
+    if (proj)
+        memcpy(cols, proj, sizeof(bool) * natts);
+    else {
+        struct TileExtractcolumnContext ecCtx;
+
+        ecCtx.cols = cols;
+        ecCtx.natts = natts;
+        tile_extractcolumns_walker((Node *) targetlist, &ecCtx);
+        tile_extractcolumns_walker((Node *) qual, &ecCtx);
+        tile_extractcolumns_walker((Node *) constraintList, &ecCtx);
+    }
+
+    for (attno = 0; attno < natts; attno++) {
+        if (!cols[attno])
+            break;
+    }
+
+    if (attno < natts)
+        scan->proj = cols;
+    else
+        pfree(cols);
 
     return (TableScanDesc) scan;
 }
@@ -249,8 +717,9 @@ tile_beginscan(Relation relation, Snapshot snapshot,
 static void
 tile_init_scan(TileScanDesc scan) {
     Oid visiRelOid;
+    int i;
 
-    scan->buffer = palloc(TILE_BLOCK_SIZE);
+    scan->buffer = NULL;
     scan->bufferPointer = scan->buffer;
     scan->bufferLen = 0;
     scan->curPageIdx = 0;
@@ -259,11 +728,9 @@ tile_init_scan(TileScanDesc scan) {
     scan->visiRel = table_open(visiRelOid, AccessShareLock);
 
     scan->visiInfo = NIL;
-    scan->bufTupleLenArr = palloc(TILE_BLOCK_SIZE);
-    scan->bufTupleLenArrPtr = scan->bufTupleLenArr;
+    scan->tupleOffsets = palloc(sizeof(uint32) * TILE_MAX_TUPLES);
     scan->bufTupleNum = 0;
 
-    scan->tuple = NULL;
     scan->blockid = 0;
     scan->seq = 0;
     if (scan->scanCtx)
@@ -271,33 +738,139 @@ tile_init_scan(TileScanDesc scan) {
     scan->scanCtx = AllocSetContextCreate(CurrentMemoryContext,
                                           "TileScanContext",
                                           ALLOCSET_DEFAULT_SIZES);
+
+    // read ahead only for sequential scans, analyze jumps between random blocks
+    scan->bucketPath = TileMakeBucketPath(scan->rs_base.rs_rd->rd_node);
+    if (scan->rs_base.rs_flags & SO_TYPE_SEQSCAN)
+        scan->ringSize = tile_prefetch_blocks + 1;
+    else
+        scan->ringSize = 1;
+    scan->ring = palloc0(sizeof(TilePrefetchBuf) * scan->ringSize);
+    for (i = 0; i < scan->ringSize; i++)
+        scan->ring[i].pageIdx = -1;
+
+    scan->claimedPages = NULL;
+    scan->nclaimedPages = 0;
+    if (scan->rs_base.rs_parallel)
+        scan->claimedPages = palloc(sizeof(uint32) * scan->ringSize);
+
+    scan->dynamic = false;
+    scan->claimsDone = false;
+    scan->planNodeId = -1;
 }
 
-static List *
-tile_get_visi(Relation visiRel, Snapshot snapshot) {
+/*
+ * Whether the zone map of a visibility tuple shows its block holds no row
+ * matching zoneKeys. zoneCtx is reset before returning.
+ */
+static bool
+tile_visi_skip(Relation visiRel, HeapTuple sysTuple, List *zoneKeys,
+               MemoryContext zoneCtx) {
+    MemoryContext oldCtx;
+    Datum zonemap;
+    bool isNull;
+    bool skip = false;
+
+    oldCtx = MemoryContextSwitchTo(zoneCtx);
+    zonemap = heap_getattr(sysTuple, TILE_VISI_ZONEMAP_ATTNUM,
+                           RelationGetDescr(visiRel), &isNull);
+    if (!isNull)
+        skip = tile_zonemap_skip(DatumGetByteaPP(zonemap), zoneKeys);
+    MemoryContextSwitchTo(oldCtx);
+    MemoryContextReset(zoneCtx);
+
+    return skip;
+}
+
+static BlockDesc *
+tile_visi_block(Relation visiRel, HeapTuple sysTuple) {
     Datum values[3];
+    bool isNull;
     BlockDesc *block_desc;
+
+    values[0] = heap_getattr(sysTuple, 1, RelationGetDescr(visiRel), &isNull);
+    values[1] = heap_getattr(sysTuple, 2, RelationGetDescr(visiRel), &isNull);
+    values[2] = heap_getattr(sysTuple, 3, RelationGetDescr(visiRel), &isNull);
+
+    block_desc = makeNode(BlockDesc);
+    block_desc->block_size = DatumGetUInt32(values[0]);
+    strcpy(block_desc->block_name, DatumGetName(values[1])->data);
+    block_desc->block_tuple_num = DatumGetUInt32(values[2]);
+    block_desc->blockid = heaptid_to_blockid(sysTuple->t_self);
+
+    if (!IS_CATALOG_SERVER()) {
+        TileBlockKeyTag tag;
+        TileBlockKeyEntry *entry;
+
+        if (tileBlockKeys == NULL) {
+            HASHCTL ctl;
+
+            MemSet(&ctl, 0, sizeof(ctl));
+            ctl.keysize = sizeof(TileBlockKeyTag);
+            ctl.entrysize = sizeof(TileBlockKeyEntry);
+            ctl.hcxt = TopTransactionContext;
+            tileBlockKeys = hash_create("Tile block keys", 256, &ctl,
+                                        HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+        }
+
+        MemSet(&tag, 0, sizeof(tag));
+        tag.visiRelid = RelationGetRelid(visiRel);
+        tag.blockid = block_desc->blockid;
+        entry = hash_search(tileBlockKeys, &tag, HASH_ENTER, NULL);
+        entry->key = GetBlockKeyFromBlockName(block_desc->block_name);
+    }
+
+    return block_desc;
+}
+
+/*
+ * Read the blocks listed in the visibility relation, leaving out those whose
+ * zone maps show they hold no row matching zoneKeys. Blocks that are kept are
+ * also handed to the data dispatcher, as a catalog scan would do.
+ */
+static List *
+tile_get_visi(Relation visiRel, Snapshot snapshot, List *zoneKeys) {
     List *visiInfo = NIL;
+    bool hasZoneMap = RelationGetDescr(visiRel)->natts >= TILE_VISI_ZONEMAP_ATTNUM;
+    bool registered = false;
+    MemoryContext zoneCtx = NULL;
 
-    SysScanDesc sysScan;
+    TableScanDesc visiScan;
+    TupleTableSlot *visiSlot;
     HeapTuple sysTuple;
 
-    sysScan = systable_beginscan(visiRel, InvalidOid, false, snapshot, 0, NULL);
-    while ((sysTuple = systable_getnext(sysScan)) != NULL) {
-        bool isNull;
+    if (snapshot == NULL) {
+        snapshot = RegisterSnapshot(GetCatalogSnapshot(RelationGetRelid(visiRel)));
+        registered = true;
+    }
+
+    if (zoneKeys != NIL && hasZoneMap)
+        zoneCtx = AllocSetContextCreate(CurrentMemoryContext,
+                                        "TileZoneMapContext",
+                                        ALLOCSET_DEFAULT_SIZES);
 
-        values[0] = heap_getattr(sysTuple, 1, RelationGetDescr(visiRel), &isNull);
-        values[1] = heap_getattr(sysTuple, 2, RelationGetDescr(visiRel), &isNull);
-        values[2] = heap_getattr(sysTuple, 3, RelationGetDescr(visiRel), &isNull);
+    visiSlot = table_slot_create(visiRel, NULL);
+    visiScan = table_beginscan(visiRel, snapshot, 0, NULL);
+    while (table_scan_getnextslot(visiScan, ForwardScanDirection, visiSlot)) {
+        bool shouldFree;
 
-        block_desc = makeNode(BlockDesc);
-        block_desc->block_size = DatumGetUInt32(values[0]);
-        strcpy(block_desc->block_name, DatumGetName(values[1])->data);
-        block_desc->block_tuple_num = DatumGetUInt32(values[2]);;
-        block_desc->blockid = heaptid_to_blockid(sysTuple->t_self);
-        visiInfo = lappend(visiInfo, block_desc);
+        sysTuple = ExecFetchSlotHeapTuple(visiSlot, false, &shouldFree);
+        Assert(!shouldFree);
+
+        if (zoneCtx && tile_visi_skip(visiRel, sysTuple, zoneKeys, zoneCtx))
+            continue;
+
+        CdbGetTuple(sysTuple);
+
+        visiInfo = lappend(visiInfo, tile_visi_block(visiRel, sysTuple));
     }
-    systable_endscan(sysScan);
+    table_endscan(visiScan);
+    ExecDropSingleTupleTableSlot(visiSlot);
+
+    if (zoneCtx)
+        MemoryContextDelete(zoneCtx);
+    if (registered)
+        UnregisterSnapshot(snapshot);
 
     return visiInfo;
 }
@@ -311,11 +884,17 @@ tile_endscan(TableScanDesc sscan) {
     if (IS_CATALOG_SERVER())
         list_free_deep(desc->visiInfo);
 
-    pfree(desc->buffer);
-    pfree(desc->bufTupleLenArr);
+    tileOpenScans = list_delete_ptr(tileOpenScans, desc);
+    tile_prefetch_release(desc);
+    pfree(desc->tupleOffsets);
+    if (desc->claimedPages)
+        pfree(desc->claimedPages);
     if (desc->scanCtx) {
         MemoryContextDelete(desc->scanCtx);
     }
+
+    if (desc->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
+        UnregisterSnapshot(desc->rs_base.rs_snapshot);
 }
 
 static void
@@ -323,11 +902,21 @@ tile_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
             bool allow_strat, bool allow_sync, bool allow_pagemode) {
     // reset
     TileScanDescData *oscan = (TileScanDescData *) sscan;
+
+    /*
+     * Another pass has to see the same blocks, and the QD only hands out
+     * each block once, so this participant takes all that are left.
+     */
+    if (oscan->dynamic)
+        while (tile_claim_blocks(oscan))
+            ;
+
     oscan->bufferPointer = oscan->buffer;
     oscan->bufferLen = 0;
     oscan->curPageIdx = 0;
-    oscan->bufTupleLenArrPtr = oscan->bufTupleLenArr;
     oscan->bufTupleNum = 0;
+    oscan->seq = 0;
+    oscan->nclaimedPages = 0;
 }
 
 static bool
@@ -335,92 +924,54 @@ tile_getnextslot(TableScanDesc sscan, ScanDirection direction,
                  TupleTableSlot *slot) {
     // note: seq2 starting from 1
     TileScanDesc desc = (TileScanDesc) sscan;
-    MinimalTuple mtuple;
-    uint32 tuple_len;
-
-    if (desc->tuple)
-        pfree(desc->tuple);
-    desc->tuple = NULL;
-
 
-    if (list_length(desc->visiInfo) == 0) {
+    if (list_length(desc->visiInfo) == 0 &&
+        !(desc->dynamic && tile_claim_blocks(desc))) {
         return false;
     }
 
     if (ScanDirectionIsForward(direction)) {
         if (desc->bufferLen == 0) {
             // the initial state
-            // get the first block, and read from the scratch
-            if (!tile_get_page(desc, NOMOVE))
+            // get the first block, and read from the scratch;
+            // a parallel scan has to take its first block from the shared cursor
+            if (!tile_get_page(desc, desc->rs_base.rs_parallel ? FORWARD : NOMOVE))
                 return false;
         }
 
-        if (desc->seq == 0) {
-            // previously we've stepped backward out of the bound, now we should start from the scratch
-            // the ptr should be in the correct position
-            desc->seq = 1;
-            Assert(
-                desc->bufferPointer == desc->buffer && desc->bufTupleLenArrPtr == desc->
-                bufTupleLenArr);
-        } else if (desc->seq == desc->bufTupleNum) {
-            // the last tuple has already been read; namely, now point to the last tuple
+        while (desc->seq >= desc->bufTupleNum) {
             // the cur block has been used up, now fetch a newer block and read from the scratch
-            Assert(
-                desc->bufTupleLenArrPtr - desc->bufTupleLenArr == sizeof(mtuple->t_len) *
-                (desc->bufTupleNum - 1));
             if (!tile_get_page(desc, FORWARD)) {
                 // should mark the cur block's cursor out of the boundary,
                 // otherwise, it would be wrong if the user want to fetch backward
-                memcpy(&tuple_len, desc->bufTupleLenArrPtr, sizeof(mtuple->t_len));
-                desc->bufferPointer += tuple_len;
-                desc->seq += 1;
-                desc->bufTupleLenArrPtr += sizeof(mtuple->t_len);
+                desc->seq = desc->bufTupleNum + 1;
                 return false;
             }
-
-            desc->seq += 1;
-        } else {
-            // the cur block is available to provide the desired tuple, read the next tuple
-            Assert(
-                desc->bufTupleLenArrPtr - desc->bufTupleLenArr != desc->bufTupleNum *
-                sizeof(mtuple->t_len)
-                && desc->seq < desc->bufTupleNum);
-            memcpy(&tuple_len, desc->bufTupleLenArrPtr, sizeof(mtuple->t_len));
-            desc->bufferPointer += tuple_len;
-            desc->seq += 1;
-            desc->bufTupleLenArrPtr += sizeof(mtuple->t_len);
         }
+        desc->seq += 1;
     } else if (ScanDirectionIsBackward(direction)) {
         Assert(desc->bufferLen != 0);
-        if (desc->bufferPointer == desc->buffer) {
+        Assert(desc->rs_base.rs_parallel == NULL);
+        while (desc->seq <= 1) {
             // step back to the former block
             if (!tile_get_page(desc, BACKWARD)) {
                 //reset the seq2, the next time we know it should start from the scratch
                 desc->seq = 0;
                 return false;
             }
-            // point to the tail
-            desc->bufTupleLenArrPtr =
-                    desc->bufTupleLenArr + sizeof(mtuple->t_len) * desc->bufTupleNum;
-            desc->bufferPointer = desc->buffer + desc->bufferLen;
+            // point past the tail
             desc->seq = desc->bufTupleNum + 1;
         }
-        // step back one tuple
-        Assert(
-            desc->bufTupleLenArr != desc->bufTupleLenArrPtr && desc->bufferPointer != desc
-            ->buffer &&
-            desc->seq > 1);
-        desc->bufTupleLenArrPtr -= sizeof(mtuple->t_len);
-        memcpy(&tuple_len, desc->bufTupleLenArrPtr, sizeof(mtuple->t_len));
-        desc->bufferPointer -= tuple_len;
         desc->seq -= 1;
     }
 
-    mtuple = (MinimalTuple) desc->bufferPointer;
-    desc->tuple = MemoryContextAlloc(desc->scanCtx, mtuple->t_len);
-    memcpy(desc->tuple, desc->bufferPointer, mtuple->t_len);
-    ExecStoreMinimalTuple((MinimalTuple) desc->tuple, slot, false);
-    slot->tts_tid = blockid_seq_get_tile_tid(desc->blockid, desc->seq, desc->key);
+    /*
+     * The slot points into the block buffer, which is not reused before the
+     * next call moves to another block, by when the slot holds a new tuple.
+     */
+    desc->bufferPointer = desc->buffer + desc->tupleOffsets[desc->seq - 1];
+    ExecStoreMinimalTuple((MinimalTuple) desc->bufferPointer, slot, false);
+    slot->tts_tid = blockid_seq_get_tile_tid(desc->blockid, desc->seq);
 
     return true;
 }
@@ -428,19 +979,239 @@ tile_getnextslot(TableScanDesc sscan, ScanDirection direction,
 static Size
 tile_parallelscan_estimate(Relation rel)
 {
-    elog(ERROR, "tile_parallelscan_estimate has not been supported");
+    return sizeof(ParallelTileScanDescData);
 }
 
 static Size
 tile_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan)
 {
-    elog(ERROR, "tile_parallelscan_initialize has not been supported");
+    ParallelTileScanDesc tpscan = (ParallelTileScanDesc) pscan;
+
+    tpscan->base.phs_relid = RelationGetRelid(rel);
+    tpscan->base.phs_syncscan = false;
+    pg_atomic_init_u32(&tpscan->nextPageIdx, 0);
+
+    return sizeof(ParallelTileScanDescData);
 }
 
 static void
 tile_parallelscan_reinitialize(Relation rel, ParallelTableScanDesc pscan)
 {
-    elog(ERROR, "tile_parallelscan_reinitialize has not been supported");
+    ParallelTileScanDesc tpscan = (ParallelTileScanDesc) pscan;
+
+    pg_atomic_write_u32(&tpscan->nextPageIdx, 0);
+}
+
+/*
+ * Take the next block of a parallel scan that no participant has taken yet.
+ * Returns false once all of them are gone.
+ */
+static bool
+tile_parallel_claim(TileScanDesc scan, uint32 *pageIdx)
+{
+    ParallelTileScanDesc tpscan = (ParallelTileScanDesc) scan->rs_base.rs_parallel;
+    uint32 next;
+
+    next = pg_atomic_fetch_add_u32(&tpscan->nextPageIdx, 1);
+    if (next >= list_length(scan->visiInfo))
+        return false;
+
+    *pageIdx = next;
+    return true;
+}
+
+/*
+ * With tile_block_assignment set to dynamic, a sequential scan on a QE does
+ * not read the share of blocks it was dispatched. It claims blocks from the
+ * QD as it goes instead, so that QEs which finish early take over the work
+ * of the slow ones. The executor calls this right after beginning the scan.
+ */
+void
+tile_scan_set_plan_node(TableScanDesc sscan, int planNodeId) {
+    TileScanDesc scan = (TileScanDesc) sscan;
+
+    if (tile_block_assignment != TILE_ASSIGN_DYNAMIC ||
+        Gp_role != GP_ROLE_EXECUTE ||
+        scan->rs_base.rs_parallel ||
+        !(scan->rs_base.rs_flags & SO_TYPE_SEQSCAN))
+        return;
+
+    Assert(scan->bufferLen == 0);
+    scan->planNodeId = planNodeId;
+    scan->dynamic = true;
+    scan->claimsDone = false;
+    list_free_deep(scan->visiInfo);
+    scan->visiInfo = NIL;
+}
+
+/*
+ * Ask the QD for more blocks of a dynamic scan and append them to visiInfo.
+ * Blocks the zone maps rule out are dropped, so keep asking until at least
+ * one is added. Returns false once the QD has none left.
+ */
+static bool
+tile_claim_blocks(TileScanDesc scan) {
+    int nblocks = list_length(scan->visiInfo);
+    MemoryContext zoneCtx = NULL;
+
+    if (scan->zoneKeys != NIL &&
+        RelationGetDescr(scan->visiRel)->natts >= TILE_VISI_ZONEMAP_ATTNUM)
+        zoneCtx = AllocSetContextCreate(CurrentMemoryContext,
+                                        "TileZoneMapContext",
+                                        ALLOCSET_DEFAULT_SIZES);
+
+    while (!scan->claimsDone && list_length(scan->visiInfo) == nblocks) {
+        char payload[128];
+        unsigned char qtype;
+        int retval;
+        int32 ntuples;
+        int curIndex = 0;
+        int len;
+        char *data;
+        HeapTuple sysTuple;
+        StringInfoData buf;
+        MemoryContext oldCtx;
+
+        snprintf(payload, sizeof(payload), "%d:%d:%d:%u:%d",
+                 gp_command_count, currentSliceId, scan->planNodeId,
+                 RelationGetRelid(scan->visiRel), scan->ringSize);
+        NotifyMyFrontEnd(CDB_NOTIFY_TILE_CLAIM, payload, MyProcPid);
+        pq_flush();
+
+        do {
+            pq_startmsgread();
+            retval = pq_getbyte_if_available(&qtype);
+            if (retval == 0) {
+                pq_endmsgread();
+                CHECK_FOR_INTERRUPTS();
+            }
+
+            if (retval == EOF)
+                ereport(ERROR,
+                        (errcode(ERRCODE_INTERNAL_ERROR),
+                         errmsg("tile claim: connection is gone unexpectedly")));
+        } while (retval != 1);
+        if (qtype == 'X')
+            ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                            errmsg("tile claim: QD closed the connection")));
+        if (qtype != TILE_CLAIM_RESPONSE)
+            ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                            errmsg("tile claim: unexpected message type='%c'", qtype)));
+
+        initStringInfo(&buf);
+        if (pq_getmessage(&buf, 0) != 0)
+            elog(ERROR, "tile claim: unable to parse tile claim response from QD");
+
+        ntuples = pq_getmsgint(&buf, 4);
+        if (ntuples < 0)
+            ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
+                            errmsg("tile claim: QD failed to hand out blocks")));
+        if (ntuples == 0)
+            scan->claimsDone = true;
+
+        // the tuples are laid out as the data dispatcher keeps them
+        data = buf.data + buf.cursor;
+        len = buf.len - buf.cursor;
+        oldCtx = MemoryContextSwitchTo(scan->scanCtx);
+        while ((sysTuple = TupleDataGetNext(data, &curIndex, len)) != NULL) {
+            if (zoneCtx && tile_visi_skip(scan->visiRel, sysTuple,
+                                          scan->zoneKeys, zoneCtx))
+                continue;
+            scan->visiInfo = lappend(scan->visiInfo,
+                                     tile_visi_block(scan->visiRel, sysTuple));
+        }
+        MemoryContextSwitchTo(oldCtx);
+        pfree(buf.data);
+    }
+
+    if (zoneCtx)
+        MemoryContextDelete(zoneCtx);
+
+    return list_length(scan->visiInfo) > nblocks;
+}
+
+/*
+ * Hand the QE asking in message the next blocks of its dynamic scan, as the
+ * visibility tuples the QD got for the statement. Each claim takes half of
+ * what is left spread over the segments, and at least what the QE reads
+ * ahead, so claims shrink as the scan nears its end and stragglers are
+ * left with little. Returns the tuples, with *ntuples set to 0 once every
+ * block has been handed out.
+ */
+char *
+tile_claim_next(const char *message, int32 *ntuples, int *len) {
+    TileClaimKey key;
+    TileClaim *claim;
+    bool found;
+    int want;
+    int take;
+    int start;
+    int i;
+
+    MemSet(&key, 0, sizeof(key));
+    if (sscanf(message, "%d:%d:%d:%u:%d", &key.commandCount, &key.sliceId,
+               &key.planNodeId, &key.visiRelid, &want) != 5)
+        elog(ERROR, "invalid tile claim message");
+
+    if (tileClaims == NULL) {
+        HASHCTL ctl;
+
+        MemSet(&ctl, 0, sizeof(ctl));
+        ctl.keysize = sizeof(TileClaimKey);
+        ctl.entrysize = sizeof(TileClaim);
+        ctl.hcxt = TopTransactionContext;
+        tileClaims = hash_create("Tile claims", 16, &ctl,
+                                 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+    }
+
+    claim = hash_search(tileClaims, &key, HASH_ENTER, &found);
+    if (!found) {
+        AuxNode *auxNode = GetAuxNode();
+        ListCell *cell;
+
+        claim->tupleData = NULL;
+        claim->tupleDataSize = 0;
+        claim->curIndex = 0;
+        claim->remaining = 0;
+
+        if (auxNode == NULL) {
+            hash_search(tileClaims, &key, HASH_REMOVE, NULL);
+            elog(ERROR, "no visibility tuples to claim tile blocks from");
+        }
+
+        /*
+         * The aux node goes away with the statement, while a cursor's QEs
+         * may claim again after later statements. Keep a copy.
+         */
+        foreach(cell, auxNode->tableList) {
+            CatalogTableNode *tableNode = (CatalogTableNode *) lfirst(cell);
+
+            if (tableNode->relId == key.visiRelid) {
+                claim->tupleData = MemoryContextAlloc(TopTransactionContext,
+                                                      Max(tableNode->tupleDataSize, 1));
+                memcpy(claim->tupleData, tableNode->tupleData,
+                       tableNode->tupleDataSize);
+                claim->tupleDataSize = tableNode->tupleDataSize;
+                break;
+            }
+        }
+
+        for (i = 0; TupleDataGetNext(claim->tupleData, &i, claim->tupleDataSize); )
+            claim->remaining++;
+    }
+
+    take = Max(Max(want, 1), claim->remaining / (2 * getgpsegmentCount()));
+    take = Min(take, claim->remaining);
+
+    start = claim->curIndex;
+    for (i = 0; i < take; i++)
+        TupleDataGetNext(claim->tupleData, &claim->curIndex, claim->tupleDataSize);
+    claim->remaining -= take;
+
+    *ntuples = take;
+    *len = claim->curIndex - start;
+
+    return claim->tupleData + start;
 }
 
 
@@ -461,6 +1232,7 @@ tile_access_release(Relation relation) {
         tile_update_finish(relation->tileDmlDesc);
         tile_release_buf(relation->tileDmlDesc->oldBuffer);
         tile_release_buf(relation->tileDmlDesc->newBuffer);
+        tile_sort_release(relation->tileDmlDesc);
         pfree(relation->tileDmlDesc);
         relation->tileDmlDesc = NULL;
     }
@@ -477,19 +1249,73 @@ tile_access_release(Relation relation) {
 static IndexFetchTableData *
 tile_index_fetch_begin(Relation rel)
 {
-    elog(ERROR, "tile_index_fetch has not been supported");
+    IndexFetchTileData *tscan = palloc0(sizeof(IndexFetchTileData));
+
+    tscan->xs_base.rel = rel;
+
+    return &tscan->xs_base;
 }
 
 static void
 tile_index_fetch_reset(IndexFetchTableData *scan)
 {
-    elog(ERROR, "tile_index_fetch has not been supported");
 }
 
 static void
 tile_index_fetch_end(IndexFetchTableData *scan)
 {
-    elog(ERROR, "tile_index_fetch has not been supported");
+    IndexFetchTileData *tscan = (IndexFetchTileData *) scan;
+
+    if (tscan->visibleBlocks)
+        hash_destroy(tscan->visibleBlocks);
+    if (tscan->visiRel)
+        table_close(tscan->visiRel, AccessShareLock);
+    tile_release_buf(tscan->buffer);
+    pfree(tscan);
+}
+
+/*
+ * Collect the blocks snapshot sees. Index entries of blocks rewritten since
+ * are left behind, and are told apart by their block ids not being here.
+ */
+static void
+tile_index_fetch_visible(IndexFetchTileData *tscan, Snapshot snapshot)
+{
+    HASHCTL ctl;
+    List *visiInfo;
+    ListCell *lc;
+
+    if (tscan->visibleBlocks) {
+        if (tscan->visibleSnapshot == snapshot &&
+            tscan->visibleCid == snapshot->curcid)
+            return;
+        hash_destroy(tscan->visibleBlocks);
+    }
+
+    if (tscan->visiRel == NULL)
+        tscan->visiRel = table_open(PgTileGetVisiRelId(RelationGetRelid(tscan->xs_base.rel)),
+                                    AccessShareLock);
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = sizeof(uint32);
+    ctl.entrysize = sizeof(TileVisibleBlock);
+    ctl.hcxt = CurrentMemoryContext;
+    tscan->visibleBlocks = hash_create("tile index visible blocks", 256, &ctl,
+                                       HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+    visiInfo = tile_get_visi(tscan->visiRel, snapshot, NIL);
+    foreach(lc, visiInfo) {
+        BlockDesc *blockDesc = lfirst(lc);
+        TileVisibleBlock *block;
+
+        block = hash_search(tscan->visibleBlocks, &blockDesc->blockid,
+                            HASH_ENTER, NULL);
+        block->key = GetBlockKeyFromBlockName(blockDesc->block_name);
+    }
+    list_free_deep(visiInfo);
+
+    tscan->visibleSnapshot = snapshot;
+    tscan->visibleCid = snapshot->curcid;
 }
 
 static bool
@@ -499,45 +1325,290 @@ tile_index_fetch_tuple(struct IndexFetchTableData *scan,
                            TupleTableSlot *slot,
                            bool *call_again, bool *all_dead)
 {
-    return false;
+    IndexFetchTileData *tscan = (IndexFetchTileData *) scan;
+    TileVisibleBlock *block;
+    uint32 blockid;
+    uint32 seq;
+    MinimalTuple mtuple;
+
+    *call_again = false;
+    if (all_dead)
+        *all_dead = false;
+
+    tile_index_fetch_visible(tscan, snapshot);
+    blockid = tile_tid_get_blockid(*tid);
+    block = hash_search(tscan->visibleBlocks, &blockid, HASH_FIND, NULL);
+    if (block == NULL)
+        return false;
+
+    if (tscan->buffer == NULL)
+        tscan->buffer = tile_init_buf();
+    if (!blockkey_equal(block->key, tscan->buffer->key))
+        tile_read_buf(scan->rel, *tid, block->key, tscan->buffer);
+
+    seq = tile_tid_get_seq(tid);
+    if (seq == 0 || seq > tscan->buffer->tupleNum)
+        return false;
+
+    mtuple = (MinimalTuple) (tscan->buffer->bufStartPtr +
+                             tscan->buffer->tupleOffsets[seq - 1]);
+    ExecStoreMinimalTuple(mtuple, slot, false);
+    slot->tts_tableOid = RelationGetRelid(scan->rel);
+    slot->tts_tid = *tid;
+
+    return true;
 }
 
 
+/* append a tuple to the new block, recording where it starts */
 static void
-tile_insert(TileDmlDesc dmlDesc, MinimalTuple minimalTuple) {
-    if (dmlDesc->newBuffer->bufSize + minimalTuple->t_len > TILE_BLOCK_SIZE) {
-        set_page(dmlDesc);
-    }
+tile_append_tuple(TileDmlDesc dmlDesc, MinimalTuple minimalTuple) {
+    TileBuf *buf = dmlDesc->newBuffer;
 
-    memcpy(dmlDesc->newBuffer->bufStartPtr + dmlDesc->newBuffer->bufSize,
-        minimalTuple, minimalTuple->t_len);
-    dmlDesc->newBuffer->bufSize += minimalTuple->t_len;
+    buf->tupleOffsets[buf->tupleNum++] = buf->bufSize;
+    memcpy(buf->bufStartPtr + buf->bufSize, minimalTuple, minimalTuple->t_len);
+    buf->bufSize += minimalTuple->t_len;
     dmlDesc->newBufferTupNum++;
 }
 
+/*
+ * Copy the tuples of the old block from the current one up to, but not
+ * including, sequence number endSeq into the new block, in one go.
+ */
+static void
+tile_copy_old_tuples(TileDmlDesc dmlDesc, uint32 endSeq) {
+    TileBuf *oldBuf = dmlDesc->oldBuffer;
+    TileBuf *newBuf = dmlDesc->newBuffer;
+    uint32 first = dmlDesc->oldBufferCurPtrTupNum - 1;
+    uint32 last = Min(endSeq - 1, oldBuf->tupleNum);
+    uint32 endDiff;
+    uint32 i;
+
+    if (dmlDesc->oldBufferCurPtrTupNum == 0 || first >= last)
+        return;
+
+    endDiff = last < oldBuf->tupleNum ? oldBuf->tupleOffsets[last] : oldBuf->bufSize;
+    for (i = first; i < last; i++) {
+        newBuf->tupleOffsets[newBuf->tupleNum++] =
+            newBuf->bufSize + oldBuf->tupleOffsets[i] - dmlDesc->oldBufferCurPtrDiff;
+    }
+    memcpy(newBuf->bufStartPtr + newBuf->bufSize,
+           oldBuf->bufStartPtr + dmlDesc->oldBufferCurPtrDiff,
+           endDiff - dmlDesc->oldBufferCurPtrDiff);
+    newBuf->bufSize += endDiff - dmlDesc->oldBufferCurPtrDiff;
+    dmlDesc->newBufferTupNum += last - first;
+
+    dmlDesc->oldBufferCurPtrDiff = endDiff;
+    dmlDesc->oldBufferCurPtrTupNum = last + 1;
+}
 
 static void
-tileam_tuple_insert(Relation relation, TupleTableSlot *slot, CommandId cid,
-                    int options, BulkInsertState bistate)
+tile_insert_block(TileDmlDesc dmlDesc, MinimalTuple minimalTuple) {
+    if (dmlDesc->newBuffer->bufSize + minimalTuple->t_len > TILE_BLOCK_SIZE) {
+        set_page(dmlDesc);
+    }
+
+    tile_append_tuple(dmlDesc, minimalTuple);
+}
+
+/*
+ * Column to sort inserted rows of rel by, or 0. Rows can only be reordered
+ * when nothing keeps the TIDs they were handed out with, that is when the
+ * table has neither indexes nor triggers.
+ */
+static AttrNumber
+tile_sort_attno(Relation rel)
 {
-    TileDmlDesc dmlDesc;
-    MinimalTuple tup;
-    bool		free = true;
+    AttrNumber attno;
+    TypeCacheEntry *typentry;
 
-    dmlDesc = getDmlDesc(relation);
-    tup = ExecFetchSlotMinimalTuple(slot, &free);
-    tile_insert(dmlDesc, tup);
+    if (tile_sort_key == NULL || tile_sort_key[0] == '\0' ||
+        rel->rd_rel->relhasindex || rel->trigdesc != NULL)
+        return InvalidAttrNumber;
 
-    ItemPointerSet(&slot->tts_tid, 0, dmlDesc->newBufferTupNum);
-    slot->tts_tid.xid = dmlDesc->newBuffer->key.tid;
-    slot->tts_tid.seq = dmlDesc->newBuffer->key.seq;
+    attno = get_attnum(RelationGetRelid(rel), tile_sort_key);
+    if (attno <= 0)
+        return InvalidAttrNumber;
 
-    if (free)
-        pfree(tup);
+    typentry = lookup_type_cache(TupleDescAttr(RelationGetDescr(rel), attno - 1)->atttypid,
+                                 TYPECACHE_LT_OPR);
+    if (!OidIsValid(typentry->lt_opr))
+        return InvalidAttrNumber;
+
+    return attno;
 }
 
+/*
+ * Add a row to the new block, or to the sort buffer when inserted rows are
+ * sorted. Returns false in the latter case, as the row has no place in a
+ * block yet.
+ */
+static bool
+tile_insert(TileDmlDesc dmlDesc, MinimalTuple minimalTuple) {
+    Size sortLimit;
 
-static void
+    if (dmlDesc->sortAttno == InvalidAttrNumber ||
+        blockkey_is_valid(dmlDesc->oldBuffer->key)) {
+        tile_insert_block(dmlDesc, minimalTuple);
+        return true;
+    }
+
+    // the buffer grows up to maintenance_work_mem, but holds a block at least
+    sortLimit = Min((Size) maintenance_work_mem * 1024L, MaxAllocSize);
+    sortLimit = Max(sortLimit, TILE_BLOCK_SIZE);
+
+    if (dmlDesc->sortBuf == NULL) {
+        dmlDesc->sortCtx = AllocSetContextCreate(CacheMemoryContext,
+                                                 "TileSortBuffer",
+                                                 ALLOCSET_DEFAULT_SIZES);
+        dmlDesc->sortBufAlloc = Min(TILE_SORT_INITIAL_SIZE, sortLimit);
+        dmlDesc->sortBuf = MemoryContextAlloc(dmlDesc->sortCtx,
+                                              dmlDesc->sortBufAlloc);
+        dmlDesc->sortMaxTuples = 1024;
+        dmlDesc->sortOffsets = MemoryContextAlloc(dmlDesc->sortCtx,
+                                                  sizeof(uint32) * dmlDesc->sortMaxTuples);
+    }
+
+    if (dmlDesc->sortBufSize + minimalTuple->t_len > sortLimit)
+        tile_sort_flush(dmlDesc);
+
+    if (dmlDesc->sortBufSize + minimalTuple->t_len > dmlDesc->sortBufAlloc) {
+        Size newAlloc = dmlDesc->sortBufAlloc;
+
+        while (dmlDesc->sortBufSize + minimalTuple->t_len > newAlloc)
+            newAlloc *= 2;
+        dmlDesc->sortBufAlloc = Min(newAlloc, sortLimit);
+        dmlDesc->sortBuf = repalloc(dmlDesc->sortBuf, dmlDesc->sortBufAlloc);
+    }
+
+    if (dmlDesc->sortTupNum == dmlDesc->sortMaxTuples) {
+        dmlDesc->sortMaxTuples *= 2;
+        dmlDesc->sortOffsets = repalloc(dmlDesc->sortOffsets,
+                                        sizeof(uint32) * dmlDesc->sortMaxTuples);
+    }
+
+    dmlDesc->sortOffsets[dmlDesc->sortTupNum++] = dmlDesc->sortBufSize;
+    memcpy(dmlDesc->sortBuf + dmlDesc->sortBufSize, minimalTuple, minimalTuple->t_len);
+    dmlDesc->sortBufSize += minimalTuple->t_len;
+    return false;
+}
+
+typedef struct TileSortItem
+{
+    Datum value;
+    bool isnull;
+    uint32 offset;
+} TileSortItem;
+
+static int
+tile_sort_cmp(const void *a, const void *b, void *arg)
+{
+    const TileSortItem *itemA = (const TileSortItem *) a;
+    const TileSortItem *itemB = (const TileSortItem *) b;
+    int cmp;
+
+    cmp = ApplySortComparator(itemA->value, itemA->isnull,
+                              itemB->value, itemB->isnull, (SortSupport) arg);
+    if (cmp != 0)
+        return cmp;
+
+    // rows with equal keys keep the order they came in
+    return (itemA->offset > itemB->offset) - (itemA->offset < itemB->offset);
+}
+
+/*
+ * Sort the rows gathered in the sort buffer and cut them into blocks. Each
+ * of the blocks written from a full buffer covers its own slice of the key
+ * range, which is what their zone maps get to skip on, and they are all
+ * uploading together.
+ */
+static void
+tile_sort_flush(TileDmlDesc dmlDesc)
+{
+    Relation rel = dmlDesc->mainRel;
+    TupleDesc tupdesc = RelationGetDescr(rel);
+    Form_pg_attribute att;
+    MemoryContext sortCtx;
+    MemoryContext oldCtx;
+    SortSupportData ssup;
+    TileSortItem *items;
+    uint32 i;
+
+    if (dmlDesc->sortTupNum == 0)
+        return;
+
+    sortCtx = AllocSetContextCreate(CurrentMemoryContext,
+                                    "TileSortContext",
+                                    ALLOCSET_DEFAULT_SIZES);
+    oldCtx = MemoryContextSwitchTo(sortCtx);
+
+    att = TupleDescAttr(tupdesc, dmlDesc->sortAttno - 1);
+    MemSet(&ssup, 0, sizeof(SortSupportData));
+    ssup.ssup_cxt = sortCtx;
+    ssup.ssup_collation = att->attcollation;
+    ssup.ssup_nulls_first = false;
+    ssup.ssup_attno = dmlDesc->sortAttno;
+    PrepareSortSupportFromOrderingOp(lookup_type_cache(att->atttypid,
+                                                       TYPECACHE_LT_OPR)->lt_opr,
+                                     &ssup);
+
+    items = palloc(sizeof(TileSortItem) * dmlDesc->sortTupNum);
+    for (i = 0; i < dmlDesc->sortTupNum; i++) {
+        MinimalTuple mtuple = (MinimalTuple) (dmlDesc->sortBuf + dmlDesc->sortOffsets[i]);
+        HeapTupleData htup;
+
+        htup.t_len = mtuple->t_len + MINIMAL_TUPLE_OFFSET;
+        htup.t_data = (HeapTupleHeader) ((char *) mtuple - MINIMAL_TUPLE_OFFSET);
+        items[i].value = heap_getattr(&htup, dmlDesc->sortAttno, tupdesc,
+                                      &items[i].isnull);
+        items[i].offset = dmlDesc->sortOffsets[i];
+    }
+    qsort_arg(items, dmlDesc->sortTupNum, sizeof(TileSortItem), tile_sort_cmp, &ssup);
+
+    MemoryContextSwitchTo(oldCtx);
+
+    for (i = 0; i < dmlDesc->sortTupNum; i++)
+        tile_insert_block(dmlDesc, (MinimalTuple) (dmlDesc->sortBuf + items[i].offset));
+
+    MemoryContextDelete(sortCtx);
+    dmlDesc->sortBufSize = 0;
+    dmlDesc->sortTupNum = 0;
+}
+
+static void
+tile_sort_release(TileDmlDesc dmlDesc)
+{
+    if (dmlDesc->sortCtx)
+        MemoryContextDelete(dmlDesc->sortCtx);
+    dmlDesc->sortCtx = NULL;
+    dmlDesc->sortBuf = NULL;
+    dmlDesc->sortOffsets = NULL;
+    dmlDesc->sortBufAlloc = 0;
+}
+
+
+static void
+tileam_tuple_insert(Relation relation, TupleTableSlot *slot, CommandId cid,
+                    int options, BulkInsertState bistate)
+{
+    TileDmlDesc dmlDesc;
+    MinimalTuple tup;
+    bool		free = true;
+
+    dmlDesc = getDmlDesc(relation);
+    tup = ExecFetchSlotMinimalTuple(slot, &free);
+    // a sorted row only gets its place when the sort buffer is flushed
+    if (tile_insert(dmlDesc, tup))
+        slot->tts_tid = blockid_seq_get_tile_tid(0, dmlDesc->newBufferTupNum);
+    else
+        ItemPointerSetInvalid(&slot->tts_tid);
+
+    if (free)
+        pfree(tup);
+}
+
+
+static void
 tileam_tuple_insert_speculative(Relation relation, TupleTableSlot *slot,
                                   CommandId cid, int options,
                                   BulkInsertState bistate, uint32 specToken)
@@ -558,7 +1629,7 @@ tileam_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
 {
     TileDmlDesc	desc;
     MinimalTuple	mtuple;
-    bool			shouldFree = false;
+    bool			shouldFree;
     int				i;
 
 
@@ -567,18 +1638,18 @@ tileam_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
     for (i = 0; i < ntuples; i++)
     {
         mtuple = ExecFetchSlotMinimalTuple(slots[i], &shouldFree);
-        tile_insert(desc, mtuple);
-        ItemPointerSet(&slots[i]->tts_tid, 0, desc->newBufferTupNum);
-        slots[i]->tts_tid.xid = desc->newBuffer->key.tid;
-        slots[i]->tts_tid.seq = desc->newBuffer->key.seq;
+        if (tile_insert(desc, mtuple))
+            slots[i]->tts_tid = blockid_seq_get_tile_tid(0, desc->newBufferTupNum);
+        else
+            ItemPointerSetInvalid(&slots[i]->tts_tid);
+        if (shouldFree)
+            pfree(mtuple);
     }
-
-    if (shouldFree)
-        pfree(mtuple);
 }
 
 static HeapTuple
-make_visibility_tuple(Relation metaRel, uint32 pageSize, uint32 tupleNum, TileKey key) {
+make_visibility_tuple(Relation metaRel, uint32 pageSize, uint32 tupleNum, TileKey key,
+                      bytea *zonemap) {
     TupleDesc meta_tuple_desc = RelationGetDescr(metaRel);
     bool *nulls = palloc(meta_tuple_desc->natts * sizeof(bool));
     Datum *values = palloc(meta_tuple_desc->natts * sizeof(Datum));
@@ -593,6 +1664,10 @@ make_visibility_tuple(Relation metaRel, uint32 pageSize, uint32 tupleNum, TileKe
     values[0] = UInt32GetDatum(pageSize);
     values[1] = NameGetDatum(&page_name);
     values[2] = UInt32GetDatum(tupleNum);
+    if (meta_tuple_desc->natts >= TILE_VISI_ZONEMAP_ATTNUM) {
+        values[TILE_VISI_ZONEMAP_ATTNUM - 1] = PointerGetDatum(zonemap);
+        nulls[TILE_VISI_ZONEMAP_ATTNUM - 1] = (zonemap == NULL);
+    }
 
     meta_tuple = heap_form_tuple(meta_tuple_desc, values, nulls);
 
@@ -603,8 +1678,32 @@ static void
 set_page(TileDmlDesc dmlDesc) {
     TM_FailureData tmfd;
     LockTupleMode lockmode;
-    S3ObjKey s3_obj_key;
-    S3Obj s3_obj;
+    char *encoded;
+    uint32 encodedLen;
+    bytea *zonemap;
+    char *bucketPath;
+    char *blockName;
+    TilePendingUpload *upload;
+    MemoryContext oldCtx;
+    uint32 blockid = 0;
+
+    // the encoded block outlives this call, it is uploaded in the background
+    oldCtx = MemoryContextSwitchTo(TopTransactionContext);
+    encoded = tile_block_encode(RelationGetDescr(dmlDesc->mainRel),
+                                dmlDesc->newBuffer->bufStartPtr,
+                                dmlDesc->newBuffer->bufSize,
+                                dmlDesc->newBufferTupNum, &encodedLen,
+                                &zonemap);
+    if (encoded == dmlDesc->newBuffer->bufStartPtr) {
+        encoded = palloc(encodedLen);
+        memcpy(encoded, dmlDesc->newBuffer->bufStartPtr, encodedLen);
+    }
+    MemoryContextSwitchTo(oldCtx);
+
+    if (blockkey_is_valid(dmlDesc->oldBuffer->key))
+        tile_totals_forget(dmlDesc->mainRel);
+    else
+        tile_totals_add(dmlDesc->mainRel, encodedLen, dmlDesc->newBufferTupNum);
 
     if (myClusterId != 0) {
         BlockDesc2 *blockDesc2;
@@ -615,68 +1714,209 @@ set_page(TileDmlDesc dmlDesc) {
         }
 
         if (blockkey_is_valid(dmlDesc->newBuffer->key)) {
-            blockDesc2->block_size = dmlDesc->newBuffer->bufSize;
+            blockDesc2->block_size = encodedLen;
             blockDesc2->block_tuple_num = dmlDesc->newBufferTupNum;
             blockDesc2->newKey = dmlDesc->newBuffer->key;
+            blockDesc2->zonemap = zonemap;
         }
 
         dmlDesc->visibilityInfo = lappend(dmlDesc->visibilityInfo, blockDesc2);
     } else {
         HeapTuple visi_tuple;
+        bool indexed = dmlDesc->mainRel->rd_rel->relhasindex;
 
         visi_tuple = make_visibility_tuple(dmlDesc->visibilityRel,
-                                                 dmlDesc->newBuffer->bufSize,
+                                                 encodedLen,
                                                  dmlDesc->newBufferTupNum,
-                                                 dmlDesc->newBuffer->key);
-
-        if (!blockkey_is_valid(dmlDesc->oldBuffer->key))
-            heap_insert(dmlDesc->visibilityRel, visi_tuple, GetCurrentCommandId(true),
-                        0, NULL);
-        else {
+                                                 dmlDesc->newBuffer->key,
+                                                 zonemap);
+
+        /*
+         * Index entries name the block by the TID of its visibility tuple.
+         * Pruning may hand out the TID of a HOT updated tuple again at once,
+         * while a deleted one keeps its line pointer until VACUUM, which
+         * removes the index entries first, see tileam_vacuum().
+         */
+        if (blockkey_is_valid(dmlDesc->oldBuffer->key)) {
             ItemPointerData heapTid;
 
             heapTid = blockid_to_heaptid(dmlDesc->oldBuffer->blockid);
-            heap_update(dmlDesc->visibilityRel, &heapTid, visi_tuple,
-                        GetCurrentCommandId(true), NULL, true, &tmfd, &lockmode);
+            if (indexed)
+                heap_delete(dmlDesc->visibilityRel, &heapTid,
+                            GetCurrentCommandId(true), NULL, true, &tmfd, false);
+            else
+                heap_update(dmlDesc->visibilityRel, &heapTid, visi_tuple,
+                            GetCurrentCommandId(true), NULL, true, &tmfd, &lockmode);
         }
+        if (!blockkey_is_valid(dmlDesc->oldBuffer->key) || indexed)
+            heap_insert(dmlDesc->visibilityRel, visi_tuple, GetCurrentCommandId(true),
+                        0, NULL);
+        if (indexed)
+            blockid = heaptid_to_blockid(visi_tuple->t_self);
 
         heap_freetuple(visi_tuple);
+        pfree(zonemap);
     }
 
-    s3_obj_key.bucketName = TileMakeBucketPath(dmlDesc->mainRel->rd_node);
-    s3_obj_key.objectName = GetBlockNameFromKey(dmlDesc->newBuffer->key);
-    s3_obj.data = dmlDesc->newBuffer->bufStartPtr;
-    s3_obj.size = dmlDesc->newBuffer->bufSize;
-    S3PutObject(s3Client, s3_obj_key, s3_obj);
-    pfree(s3_obj_key.bucketName);
-    pfree(s3_obj_key.objectName);
+    bucketPath = TileMakeBucketPath(dmlDesc->mainRel->rd_node);
+    blockName = GetBlockNameFromKey(dmlDesc->newBuffer->key);
+    upload = MemoryContextAlloc(TopTransactionContext, sizeof(TilePendingUpload));
+    upload->data = encoded;
+    upload->request = S3PutObjectAsync(s3Client, bucketPath, blockName, encoded,
+                                       encodedLen, tile_upload_parts);
+    oldCtx = MemoryContextSwitchTo(TopTransactionContext);
+    tilePendingUploads = lappend(tilePendingUploads, upload);
+    MemoryContextSwitchTo(oldCtx);
+    pfree(bucketPath);
+    pfree(blockName);
+
+    // give back the buffers of blocks that are up already
+    tile_upload_wait(false);
+
+    if (blockid != 0)
+        tile_index_block_tuples(dmlDesc->mainRel, dmlDesc->newBuffer, blockid);
 
     tile_reset_buf(dmlDesc->newBuffer);
     dmlDesc->newBufferTupNum = 0;
 }
 
+/*
+ * Add the block changes of a relation to the pending batch. The list cells
+ * and block descriptions must already be in TopTransactionContext.
+ */
+static void
+tile_visi_batch_add(Oid relid, List *visiInfo) {
+    TilePendingVisi *pending;
+    MemoryContext oldCtx;
+
+    if (visiInfo == NIL)
+        return;
+
+    oldCtx = MemoryContextSwitchTo(TopTransactionContext);
+    pending = palloc(sizeof(TilePendingVisi));
+    pending->subid = GetCurrentSubTransactionId();
+    pending->relid = relid;
+    pending->visiInfo = visiInfo;
+    tilePendingVisi = lappend(tilePendingVisi, pending);
+    MemoryContextSwitchTo(oldCtx);
+}
+
+/*
+ * A QE reports the block changes of a relation as a base64 encoded
+ * serialized VisiNode, notifications being text.
+ */
+static void
+tile_visi_notify(VisiNode *visiNode) {
+    char *data;
+    char *message;
+    int dataLen;
+    int messageLen;
+
+    data = serializeNode((Node *) visiNode, &dataLen, NULL);
+    message = palloc(pg_b64_enc_len(dataLen) + 1);
+    messageLen = pg_b64_encode(data, dataLen, message);
+    message[messageLen] = '\0';
+
+    NotifyMyFrontEnd(CDB_NOTIFY_TILE, message, MyProcPid);
+    pq_flush();
+
+    pfree(message);
+    pfree(data);
+}
+
 void
 tile_insert_visi_notify(char *message) {
     VisiNode *visiNode;
+    MemoryContext oldCtx;
+    char *data;
+    int dataLen;
 
     if (!message)
         return;
 
-    visiNode = stringToNode(message);
-    cc_send_modify_tabble(visiNode);
+    oldCtx = MemoryContextSwitchTo(TopTransactionContext);
+    data = palloc(pg_b64_dec_len(strlen(message)));
+    dataLen = pg_b64_decode(message, strlen(message), data);
+    if (dataLen < 0)
+        elog(ERROR, "invalid tile visibility notification");
+    visiNode = (VisiNode *) deserializeNode(data, dataLen);
+    pfree(data);
+    MemoryContextSwitchTo(oldCtx);
+
+    tile_visi_batch_add(visiNode->relid, visiNode->visiInfo);
+    pfree(visiNode);
+}
+
+/*
+ * Send the visibility changes of the statement to the catalog server, before
+ * its transaction command ends.
+ */
+void
+tile_insert_visi_flush(void) {
+    List *visiNodes = NIL;
+    ListCell *lc;
+
+    if (tilePendingVisi == NIL)
+        return;
+
+    // one VisiNode per relation, keeping the order of its changes
+    foreach(lc, tilePendingVisi) {
+        TilePendingVisi *pending = lfirst(lc);
+        VisiNode *visiNode = NULL;
+        ListCell *cell;
+
+        foreach(cell, visiNodes) {
+            if (((VisiNode *) lfirst(cell))->relid == pending->relid) {
+                visiNode = lfirst(cell);
+                break;
+            }
+        }
+
+        if (visiNode == NULL) {
+            visiNode = makeNode(VisiNode);
+            visiNode->relid = pending->relid;
+            visiNodes = lappend(visiNodes, visiNode);
+        }
+        visiNode->visiInfo = list_concat(visiNode->visiInfo, pending->visiInfo);
+    }
+
+    list_free_deep(tilePendingVisi);
+    tilePendingVisi = NIL;
+    cc_send_modify_tabble(visiNodes);
 }
 
+/*
+ * Apply the block changes a compute cluster sent. The indexes of a tile table
+ * live here only, so the blocks it wrote are read back and indexed under the
+ * TIDs their visibility tuples get, as set_page() does for local writes.
+ */
 void
 tile_insert_visi_cs(VisiNode *visiNode) {
     Oid visiRelOid;
+    Relation mainRel;
     Relation visiRel;
     ListCell *cell;
     TM_FailureData tmfd;
     LockTupleMode lockmode;
+    bool indexed;
+    TileBuf *indexBuf = NULL;
+
+    TupleTableSlot **slots;
+    TileKey *slotKeys;
+    int nslots = 0;
+
+    mainRel = table_open(visiNode->relid, RowExclusiveLock);
+    indexed = mainRel->rd_rel->relhasindex;
+    if (indexed)
+        indexBuf = tile_init_buf();
 
     visiRelOid = PgTileGetVisiRelId(visiNode->relid);
     visiRel = table_open(visiRelOid, RowExclusiveLock);
 
+    // new blocks go in with one multi-insert at the end
+    slots = palloc(sizeof(TupleTableSlot *) * list_length(visiNode->visiInfo));
+    slotKeys = palloc(sizeof(TileKey) * list_length(visiNode->visiInfo));
+
     foreach(cell, visiNode->visiInfo) {
         BlockDesc2 *blockDesc2;
         blockDesc2 = lfirst(cell);
@@ -691,9 +1931,24 @@ tile_insert_visi_cs(VisiNode *visiNode) {
             visi_tuple = make_visibility_tuple(visiRel,
                                                      blockDesc2->block_size,
                                                      blockDesc2->block_tuple_num,
-                                                     blockDesc2->newKey);
-            heap_update(visiRel, &oldTid, visi_tuple,
-                        GetCurrentCommandId(true), NULL, true, &tmfd, &lockmode);
+                                                     blockDesc2->newKey,
+                                                     blockDesc2->zonemap);
+
+            // a rewritten block must not reuse a TID old index entries name
+            if (indexed) {
+                uint32 blockid;
+
+                heap_delete(visiRel, &oldTid, GetCurrentCommandId(true),
+                            NULL, true, &tmfd, false);
+                heap_insert(visiRel, visi_tuple, GetCurrentCommandId(true),
+                            0, NULL);
+                blockid = heaptid_to_blockid(visi_tuple->t_self);
+                tile_read_buf(mainRel, blockid_seq_get_tile_tid(blockid, 1),
+                              blockDesc2->newKey, indexBuf);
+                tile_index_block_tuples(mainRel, indexBuf, blockid);
+            } else
+                heap_update(visiRel, &oldTid, visi_tuple,
+                            GetCurrentCommandId(true), NULL, true, &tmfd, &lockmode);
             heap_freetuple(visi_tuple);
         } else if (ItemPointerIsValid(&oldTid)) {
             heap_delete(visiRel, &oldTid, GetCurrentCommandId(true),
@@ -704,35 +1959,71 @@ tile_insert_visi_cs(VisiNode *visiNode) {
             visi_tuple = make_visibility_tuple(visiRel,
                                                      blockDesc2->block_size,
                                                      blockDesc2->block_tuple_num,
-                                                     blockDesc2->newKey);
-            heap_insert(visiRel, visi_tuple, GetCurrentCommandId(true),
-                        0, NULL);
-            heap_freetuple(visi_tuple);
+                                                     blockDesc2->newKey,
+                                                     blockDesc2->zonemap);
+            slots[nslots] = MakeSingleTupleTableSlot(RelationGetDescr(visiRel),
+                                                     &TTSOpsHeapTuple);
+            ExecStoreHeapTuple(visi_tuple, slots[nslots], true);
+            slotKeys[nslots] = blockDesc2->newKey;
+            nslots++;
         }
     }
 
+    if (nslots > 0) {
+        BulkInsertState bistate = GetBulkInsertState();
+        int i;
+
+        heap_multi_insert(visiRel, slots, nslots, GetCurrentCommandId(true),
+                          0, bistate);
+        FreeBulkInsertState(bistate);
+
+        // heap_multi_insert() leaves the TID of each tuple in its slot
+        for (i = 0; indexed && i < nslots; i++) {
+            uint32 blockid = heaptid_to_blockid(slots[i]->tts_tid);
+
+            tile_read_buf(mainRel, blockid_seq_get_tile_tid(blockid, 1),
+                          slotKeys[i], indexBuf);
+            tile_index_block_tuples(mainRel, indexBuf, blockid);
+        }
+
+        while (nslots > 0)
+            ExecDropSingleTupleTableSlot(slots[--nslots]);
+    }
+    pfree(slots);
+    pfree(slotKeys);
+    tile_release_buf(indexBuf);
+
     table_close(visiRel, RowExclusiveLock);
+    table_close(mainRel, RowExclusiveLock);
 }
 
 static TM_Result
 tile_delete(TileDmlDesc dmlDesc, ItemPointer tid) {
-    TileKey key;
+    uint32 blockid;
     uint32 targetTupleSeq;
-    MinimalTuple tup;
 
-    key = tid_get_blockkey(tid);
+    // block id 0 is the block being filled, it has no visibility tuple yet
+    blockid = tile_tid_get_blockid(*tid);
+    if (blockid == 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("cannot modify a tile tuple written by the same command")));
 
     // deal with the oldBuf
     if (blockkey_is_valid(dmlDesc->oldBuffer->key)) {
-        if (!blockkey_equal(key, dmlDesc->oldBuffer->key)) {
+        if (blockid != dmlDesc->oldBuffer->blockid) {
             // need finish the current old buf
             FinishTransForCurrentBlock(dmlDesc);
-            tile_read_buf(dmlDesc->mainRel, *tid, key, dmlDesc->oldBuffer);
+            tile_read_buf(dmlDesc->mainRel, *tid,
+                          tile_blockid_get_key(dmlDesc->visiRelid, blockid),
+                          dmlDesc->oldBuffer);
             dmlDesc->oldBufferCurPtrDiff = 0;
             dmlDesc->oldBufferCurPtrTupNum = 1;
         }
     } else {
-        tile_read_buf(dmlDesc->mainRel, *tid, key, dmlDesc->oldBuffer);
+        tile_read_buf(dmlDesc->mainRel, *tid,
+                      tile_blockid_get_key(dmlDesc->visiRelid, blockid),
+                      dmlDesc->oldBuffer);
         dmlDesc->oldBufferCurPtrDiff = 0;
         dmlDesc->oldBufferCurPtrTupNum = 1;
     }
@@ -742,19 +2033,13 @@ tile_delete(TileDmlDesc dmlDesc, ItemPointer tid) {
     if (targetTupleSeq == dmlDesc->oldBufferCurPtrTupNum - 1)
         return TM_Deleted;
 
-    while (dmlDesc->oldBufferCurPtrTupNum < targetTupleSeq) {
-        tup = (MinimalTuple) (dmlDesc->oldBuffer->bufStartPtr + dmlDesc->
-                                 oldBufferCurPtrDiff);
-        memcpy(dmlDesc->newBuffer->bufStartPtr + dmlDesc->newBuffer->bufSize, tup,
-               tup->t_len);
-        dmlDesc->newBuffer->bufSize += tup->t_len;
-        dmlDesc->newBufferTupNum++;
-        dmlDesc->oldBufferCurPtrDiff += tup->t_len;
-        dmlDesc->oldBufferCurPtrTupNum++;
-    }
+    tile_copy_old_tuples(dmlDesc, targetTupleSeq);
 
-    dmlDesc->oldBufferCurPtrDiff +=
-        ((MinimalTuple) (dmlDesc->oldBuffer->bufStartPtr + dmlDesc->oldBufferCurPtrDiff))->t_len;
+    // skip the deleted tuple
+    if (targetTupleSeq < dmlDesc->oldBuffer->tupleNum)
+        dmlDesc->oldBufferCurPtrDiff = dmlDesc->oldBuffer->tupleOffsets[targetTupleSeq];
+    else
+        dmlDesc->oldBufferCurPtrDiff = dmlDesc->oldBuffer->bufSize;
     dmlDesc->oldBufferCurPtrTupNum++;
 
     return TM_Ok;
@@ -779,6 +2064,7 @@ FinishTransForCurrentBlock(TileDmlDesc desc) {
         // insert a new block for the remaining available data
         set_page(desc);
     } else if (desc->oldBuffer->bufSize > 0) {
+        tile_totals_forget(desc->mainRel);
         if (!IS_CATALOG_SERVER()) {
             BlockDesc2 *blockDesc2;
             blockDesc2 = makeNode(BlockDesc2);
@@ -799,26 +2085,60 @@ FinishTransForCurrentBlock(TileDmlDesc desc) {
 
 static void
 MoveAfterToNewPage(TileDmlDesc desc) {
-    MinimalTuple mtuple;
-
-    while (desc->oldBufferCurPtrDiff < desc->oldBuffer->bufSize) {
-        mtuple = (MinimalTuple) (desc->oldBuffer->bufStartPtr + desc->
-                                 oldBufferCurPtrDiff);
-        memcpy(desc->newBuffer->bufStartPtr + desc->newBuffer->bufSize, mtuple,
-               mtuple->t_len);
-        desc->newBuffer->bufSize += mtuple->t_len;
-        desc->newBufferTupNum++;
-        desc->oldBufferCurPtrDiff += mtuple->t_len;
-        desc->oldBufferCurPtrTupNum++;
-    }
+    tile_copy_old_tuples(desc, desc->oldBuffer->tupleNum + 1);
 }
 
+/*
+ * Find the key of a block from its block id, the TID of its visibility
+ * tuple. The catalog server reads the tuple, any version of it will do as
+ * the TID came from a snapshot that sees it. Elsewhere the key was recorded
+ * when the block was listed, by this statement or an earlier one.
+ */
 static TileKey
-tid_get_blockkey(ItemPointer tid) {
+tile_blockid_get_key(Oid visiRelid, uint32 blockid) {
     TileKey key;
 
-    key.tid = tid->xid;
-    key.seq = tid->seq;
+    if (IS_CATALOG_SERVER()) {
+        Relation visiRel = table_open(visiRelid, AccessShareLock);
+        HeapTupleData tuple;
+        Buffer buffer;
+        Datum name;
+        bool isNull;
+
+        tuple.t_self = blockid_to_heaptid(blockid);
+        if (!heap_fetch(visiRel, SnapshotAny, &tuple, &buffer))
+            elog(ERROR, "could not find tile block %u in \"%s\"",
+                 blockid, RelationGetRelationName(visiRel));
+
+        name = heap_getattr(&tuple, 2, RelationGetDescr(visiRel), &isNull);
+        key = GetBlockKeyFromBlockName(DatumGetName(name)->data);
+        ReleaseBuffer(buffer);
+        table_close(visiRel, AccessShareLock);
+    } else {
+        TileBlockKeyTag tag;
+        TileBlockKeyEntry *entry = NULL;
+
+        MemSet(&tag, 0, sizeof(tag));
+        tag.visiRelid = visiRelid;
+        tag.blockid = blockid;
+        if (tileBlockKeys)
+            entry = hash_search(tileBlockKeys, &tag, HASH_FIND, NULL);
+
+        // the TID may come from another segment, list all blocks we were sent
+        if (entry == NULL) {
+            Relation visiRel = table_open(visiRelid, AccessShareLock);
+
+            list_free_deep(tile_get_visi(visiRel, NULL, NIL));
+            table_close(visiRel, AccessShareLock);
+            if (tileBlockKeys)
+                entry = hash_search(tileBlockKeys, &tag, HASH_FIND, NULL);
+        }
+        if (entry == NULL)
+            elog(ERROR, "could not find tile block %u of relation %u",
+                 blockid, visiRelid);
+
+        key = entry->key;
+    }
 
     return key;
 }
@@ -831,10 +2151,7 @@ tile_update(TileDmlDesc dmlDesc, ItemPointer otid, MinimalTuple newTuple) {
     if (result == TM_Deleted)
         return TM_Updated;
 
-    memcpy(dmlDesc->newBuffer->bufStartPtr + dmlDesc->newBuffer->bufSize, newTuple,
-        newTuple->t_len);
-    dmlDesc->newBuffer->bufSize += newTuple->t_len;
-    dmlDesc->newBufferTupNum++;
+    tile_append_tuple(dmlDesc, newTuple);
 
     return TM_Ok;
 }
@@ -850,9 +2167,8 @@ tileam_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
     TileDmlDesc dmlDesc = getDmlDesc(relation);
 
     tile_update(dmlDesc, otid, tup);
-    ItemPointerSet(&slot->tts_tid, 0, dmlDesc->newBufferTupNum);
-    slot->tts_tid.xid = dmlDesc->newBuffer->key.tid;
-    slot->tts_tid.seq = dmlDesc->newBuffer->key.seq;
+    *update_indexes = true;
+    slot->tts_tid = blockid_seq_get_tile_tid(0, dmlDesc->newBufferTupNum);
 
     if (free)
         pfree(tup);
@@ -860,26 +2176,118 @@ tileam_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
     return TM_Ok;
 }
 
+/*
+ * Add the index entries of the block just written, under blockid. Until
+ * then its tuples have no TIDs an index could keep, so inserted and updated
+ * tuples are indexed here rather than by the executor, as are the tuples
+ * carried over from a rewritten block. The entries of the old block are
+ * left behind, index fetches skip them once it is not visible.
+ */
+static void
+tile_index_block_tuples(Relation rel, TileBuf *buf, uint32 blockid) {
+    List *indexOids;
+    ListCell *lc;
+    int nindexes;
+    int idx;
+    Relation *indexRels;
+    IndexInfo **indexInfos;
+    ExprState **predicates;
+    EState *estate;
+    ExprContext *econtext;
+    TupleTableSlot *slot;
+    Datum values[INDEX_MAX_KEYS];
+    bool isnull[INDEX_MAX_KEYS];
+    uint32 i;
+
+    indexOids = RelationGetIndexList(rel);
+    nindexes = list_length(indexOids);
+    if (nindexes == 0)
+        return;
+
+    estate = CreateExecutorState();
+    econtext = GetPerTupleExprContext(estate);
+    slot = MakeSingleTupleTableSlot(RelationGetDescr(rel), &TTSOpsMinimalTuple);
+    econtext->ecxt_scantuple = slot;
+
+    indexRels = palloc(sizeof(Relation) * nindexes);
+    indexInfos = palloc(sizeof(IndexInfo *) * nindexes);
+    predicates = palloc(sizeof(ExprState *) * nindexes);
+    idx = 0;
+    foreach(lc, indexOids) {
+        indexRels[idx] = index_open(lfirst_oid(lc), RowExclusiveLock);
+        indexInfos[idx] = BuildIndexInfo(indexRels[idx]);
+        predicates[idx] = ExecPrepareQual(indexInfos[idx]->ii_Predicate, estate);
+        idx++;
+    }
+
+    for (i = 0; i < buf->tupleNum; i++) {
+        ItemPointerData tid;
+
+        ResetPerTupleExprContext(estate);
+        ExecStoreMinimalTuple((MinimalTuple) (buf->bufStartPtr + buf->tupleOffsets[i]),
+                              slot, false);
+        tid = blockid_seq_get_tile_tid(blockid, i + 1);
+
+        for (idx = 0; idx < nindexes; idx++) {
+            if (!indexInfos[idx]->ii_ReadyForInserts)
+                continue;
+            if (predicates[idx] && !ExecQual(predicates[idx], econtext))
+                continue;
+
+            FormIndexDatum(indexInfos[idx], slot, estate, values, isnull);
+            index_insert(indexRels[idx], values, isnull, &tid, rel,
+                         UNIQUE_CHECK_NO, indexInfos[idx]);
+        }
+    }
+
+    for (idx = 0; idx < nindexes; idx++)
+        index_close(indexRels[idx], RowExclusiveLock);
+    pfree(indexRels);
+    pfree(indexInfos);
+    pfree(predicates);
+    ExecDropSingleTupleTableSlot(slot);
+    FreeExecutorState(estate);
+    list_free(indexOids);
+}
+
 static void
 tile_update_finish(TileDmlDesc dmlDesc) {
+    tile_sort_flush(dmlDesc);
     FinishTransForCurrentBlock(dmlDesc);
 
-    if (myClusterId != 0) {
-        VisiNode *visiNode;
-
-        visiNode = makeNode(VisiNode);
-        visiNode->relid = RelationGetRelid(dmlDesc->mainRel);
-        visiNode->visiInfo = dmlDesc->visibilityInfo;
+    // the blocks must be in the bucket before anyone can see them
+    tile_upload_wait(true);
 
+    if (myClusterId != 0) {
         if (Gp_role == GP_ROLE_EXECUTE) {
-            char *message;
+            VisiNode *visiNode;
 
-            message = nodeToString(visiNode);
-            NotifyMyFrontEnd(CDB_NOTIFY_TILE, message, MyProcPid);
-            pq_flush();
-            pfree(message);
+            visiNode = makeNode(VisiNode);
+            visiNode->relid = RelationGetRelid(dmlDesc->mainRel);
+            visiNode->visiInfo = dmlDesc->visibilityInfo;
+            tile_visi_notify(visiNode);
         } else {
-            cc_send_modify_tabble(visiNode);
+            MemoryContext oldCtx;
+            List *visiInfo = NIL;
+            ListCell *cell;
+
+            // the block descriptions go away with the executor
+            oldCtx = MemoryContextSwitchTo(TopTransactionContext);
+            foreach(cell, dmlDesc->visibilityInfo) {
+                BlockDesc2 *blockDesc2 = makeNode(BlockDesc2);
+
+                memcpy(blockDesc2, lfirst(cell), sizeof(BlockDesc2));
+                if (blockDesc2->zonemap) {
+                    bytea *zonemap = palloc(VARSIZE(blockDesc2->zonemap));
+
+                    memcpy(zonemap, blockDesc2->zonemap, VARSIZE(blockDesc2->zonemap));
+                    blockDesc2->zonemap = zonemap;
+                }
+                visiInfo = lappend(visiInfo, blockDesc2);
+            }
+            MemoryContextSwitchTo(oldCtx);
+
+            tile_visi_batch_add(RelationGetRelid(dmlDesc->mainRel), visiInfo);
         }
     } else
         table_close(dmlDesc->visibilityRel, RowExclusiveLock);
@@ -903,59 +2311,53 @@ tileam_tuple_lock(Relation relation, ItemPointer tid, Snapshot snapshot,
     return TM_Ok;
 }
 
+/*
+ * Write out what is left in the sort buffer once a load is done, so that
+ * its last blocks upload while the statement winds down.
+ */
 static void
 tileam_finish_bulk_insert(Relation relation, int options)
 {
-
+    if (relation->tileDmlDesc)
+        tile_sort_flush(relation->tileDmlDesc);
 }
 
 static bool
 tile_fetch(Relation rel, TileFetchDesc desc, ItemPointer tid, Snapshot snapshot,
            TupleTableSlot *slot) {
-    TileKey key;
+    uint32 blockid;
     MinimalTuple mtuple;
+    uint32 seq;
 
+    blockid = tile_tid_get_blockid(*tid);
 
-    key = tid_get_blockkey(tid);
-
-
-    if (desc->buffer && blockkey_equal(key, desc->buffer->key)) {
-    } else if (rel->tileDmlDesc && rel->tileDmlDesc->newBuffer &&
-               (blockkey_equal(key, rel->tileDmlDesc->newBuffer->key) ||
-                !blockkey_is_valid(key))) {
+    if (blockid == 0) {
+        // the block this backend is still filling
+        if (rel->tileDmlDesc == NULL || rel->tileDmlDesc->newBuffer == NULL)
+            return false;
         if (desc->buffer && desc->bufferShouldFree)
             tile_release_buf(desc->buffer);
 
         desc->buffer = rel->tileDmlDesc->newBuffer;
-        desc->bufferCurPtrTupNum = 1;
-        desc->bufferCurPtrDiff = 0;
         desc->bufferShouldFree = false;
+    } else if (desc->buffer && desc->bufferShouldFree &&
+               desc->buffer->blockid == blockid) {
     } else {
         if (desc->buffer == NULL || !desc->bufferShouldFree) {
             desc->buffer = tile_init_buf();
+            desc->bufferShouldFree = true;
         }
-        tile_read_buf(desc->mainRel, *tid, key, desc->buffer);
-        desc->bufferCurPtrTupNum = 1;
-        desc->bufferCurPtrDiff = 0;
-    }
-
-    if (tile_tid_get_seq(tid) < desc->bufferCurPtrTupNum) {
-        desc->bufferCurPtrTupNum = 1;
-        desc->bufferCurPtrDiff = 0;
-    }
-
-    while (desc->bufferCurPtrDiff < desc->buffer->bufSize &&
-           desc->bufferCurPtrTupNum < tile_tid_get_seq(tid)) {
-        mtuple = (MinimalTuple) (desc->buffer->bufStartPtr + desc->bufferCurPtrDiff);
-        desc->bufferCurPtrDiff += mtuple->t_len;
-        desc->bufferCurPtrTupNum++;
+        tile_read_buf(desc->mainRel, *tid,
+                      tile_blockid_get_key(desc->visiRelid, blockid),
+                      desc->buffer);
     }
 
-    if (desc->bufferCurPtrTupNum != tile_tid_get_seq(tid)) {
+    seq = tile_tid_get_seq(tid);
+    if (seq == 0 || seq > desc->buffer->tupleNum) {
         return false;
     }
 
-    mtuple = (MinimalTuple) (desc->buffer->bufStartPtr + desc->bufferCurPtrDiff);
+    mtuple = (MinimalTuple) (desc->buffer->bufStartPtr + desc->buffer->tupleOffsets[seq - 1]);
     ExecForceStoreMinimalTuple(mtuple, slot, false);
     slot->tts_tableOid = RelationGetRelid(desc->mainRel);
     slot->tts_tid = *tid;
@@ -1019,96 +2421,437 @@ tile_nontransactional_truncate(Relation rel)
     heap_truncate_one_rel(visiRel);
     table_close(visiRel, ExclusiveLock);
     tile_clear_table(rel->rd_node);
+    tile_totals_forget(rel);
 }
 
 
+/*
+ * ANALYZE samples tile tables through tile_acquire_sample_rows(), which
+ * reads whole runs of rows of the blocks it picks, so the block by block
+ * sampling callbacks are never called.
+ */
 static bool
 tile_scan_analyze_next_block(TableScanDesc scan, BlockNumber blockno,
                                   BufferAccessStrategy bstrategy) {
-    TileScanDesc desc = (TileScanDesc) scan;
-    desc->curPageIdx = blockno;
-    getblock_internal(desc);
-
-    return true;
+    elog(ERROR, "tile_scan_analyze_next_block has not been supported");
+    return false;
 }
 
 static bool
 tile_scan_analyze_next_tuple(TableScanDesc scan, TransactionId OldestXmin,
                                   double *liverows, double *deadrows,
                                   TupleTableSlot *slot) {
-    TileScanDesc desc = (TileScanDesc) scan;
-    MinimalTuple mtuple;
-    bool sample_it = false;
+    elog(ERROR, "tile_scan_analyze_next_tuple has not been supported");
+    return false;
+}
 
+/*
+ * Read [offset, offset + length) of a block for ANALYZE into the same place
+ * of data. The local cache is looked at but not filled, a sample should not
+ * push out what scans keep reading.
+ */
+static void
+tile_analyze_read(const char *bucketPath, BlockDesc *blockDesc, uint32 offset,
+                  uint32 length, char *data)
+{
+    if (tile_cache_read(bucketPath, blockDesc->block_name, offset, length,
+                        data + offset) >= 0)
+        return;
 
-    if (desc->bufferLen == 0 || desc->bufferPointer - desc->buffer >= desc->bufferLen) {
-        // no tuple left yet
-        return false;
+    S3GetObjectRange(s3Client, bucketPath, blockDesc->block_name, offset, length,
+                     data + offset);
+}
+
+/*
+ * Copy out the row at index i of a block, numbered from 0. Tile TIDs number
+ * the rows of a block from 1, as scans and DML do.
+ */
+static HeapTuple
+tile_analyze_tuple(char *tuple, BlockDesc *blockDesc, uint32 i)
+{
+    HeapTuple heapTuple;
+
+    heapTuple = heap_tuple_from_minimal_tuple((MinimalTuple) tuple);
+    heapTuple->t_self = blockid_seq_get_tile_tid(blockDesc->blockid, i + 1);
+
+    return heapTuple;
+}
+
+/*
+ * Add want rows of a block to rows, with as few range reads as its layout
+ * allows. A row block with a trailer costs its tuple offsets and one run of
+ * consecutive tuples, starting at random. A columnar block has to be read
+ * chunk by chunk, and once decoded any of its rows may be taken. Blocks
+ * without a trailer are read whole. Returns the number of rows added.
+ */
+static int
+tile_analyze_block(Relation onerel, const char *bucketPath, BlockDesc *blockDesc,
+                   int want, SamplerRandomState randstate, char *data,
+                   char *rowBuf, uint32 *offsets, HeapTuple *rows)
+{
+    TupleDesc tupdesc = RelationGetDescr(onerel);
+    int natts = tupdesc->natts;
+    uint32 size = blockDesc->block_size;
+    uint32 headerLen = Min(TILE_BLOCK_HEADER_SIZE(natts), size);
+    uint32 ntuples;
+    char *tuples;
+    bool whole;
+    RowSamplerData rs;
+    int nrows = 0;
+
+    whole = tile_cache_read(bucketPath, blockDesc->block_name, 0, 0, data) >= 0;
+    if (!whole)
+        tile_analyze_read(bucketPath, blockDesc, 0, headerLen, data);
+
+    if (tile_block_is_columnar(data, headerLen)) {
+        if (!whole) {
+            TileBlockRange *ranges = palloc(sizeof(TileBlockRange) * natts);
+            int nranges;
+            int i;
+
+            nranges = tile_block_ranges(data, NULL, natts, ranges);
+            for (i = 0; i < nranges; i++)
+                tile_analyze_read(bucketPath, blockDesc, ranges[i].offset,
+                                  ranges[i].length, data);
+            pfree(ranges);
+        }
+        tile_block_decode(tupdesc, data, NULL, rowBuf, offsets);
+        ntuples = tile_block_ntuples(data);
+        tuples = rowBuf;
+    } else {
+        uint32 tailLen = sizeof(uint32) * blockDesc->block_tuple_num +
+                         sizeof(TileBlockTrailer);
+        uint32 rowsLen;
+
+        if (!whole && tailLen < size) {
+            TileBlockTrailer trailer;
+
+            tile_analyze_read(bucketPath, blockDesc, size - tailLen, tailLen, data);
+            memcpy(&trailer, data + size - sizeof(TileBlockTrailer),
+                   sizeof(TileBlockTrailer));
+
+            if (trailer.magic == TILE_TRAILER_MAGIC &&
+                trailer.ntuples == blockDesc->block_tuple_num) {
+                uint32 dataLen = size - tailLen;
+                uint32 first;
+                uint32 start;
+                uint32 end;
+                uint32 seq;
+
+                ntuples = trailer.ntuples;
+                memcpy(offsets, data + dataLen, sizeof(uint32) * ntuples);
+                want = Min(want, ntuples);
+
+                first = (uint32) (sampler_random_fract(randstate) *
+                                  (ntuples - want + 1));
+                first = Min(first, ntuples - want);
+                start = offsets[first];
+                end = first + want < ntuples ? offsets[first + want] : dataLen;
+                tile_analyze_read(bucketPath, blockDesc, start, end - start, data);
+
+                for (seq = first; seq < first + want; seq++)
+                    rows[nrows++] = tile_analyze_tuple(data + offsets[seq],
+                                                       blockDesc, seq);
+                return nrows;
+            }
+        }
+
+        // written before blocks had a trailer
+        if (!whole)
+            size = S3GetObject2(s3Client, bucketPath, blockDesc->block_name, data);
+        rowsLen = size;
+        ntuples = tile_block_row_offsets(data, &rowsLen, offsets);
+        tuples = data;
     }
 
-    mtuple = (MinimalTuple) desc->bufferPointer;
-    ExecStoreMinimalTuple(mtuple, slot, false);
-    slot->tts_tid = blockid_seq_get_tile_tid(desc->blockid, desc->seq, desc->key);
-    desc->seq++;
+    RowSampler_Init(&rs, ntuples, want, random());
+    while (RowSampler_HasMore(&rs)) {
+        uint32 seq = RowSampler_Next(&rs);
 
-    switch (desc->cur_buf_block_vacuum_status) {
-        case HEAPTUPLE_LIVE:
-            sample_it = true;
-        *liverows += 1;
-        break;
-        case HEAPTUPLE_DEAD:
-        case HEAPTUPLE_RECENTLY_DEAD:
-            *deadrows += 1;
-        break;
-        case HEAPTUPLE_INSERT_IN_PROGRESS:
-            sample_it = true;
-        *liverows += 1;
-        break;
-        case HEAPTUPLE_DELETE_IN_PROGRESS:
-            *deadrows += 1;
-        break;
-        default:
-            elog(ERROR, "unexpected TupleSatisfiesVacuum result");
-        break;
+        rows[nrows++] = tile_analyze_tuple(tuples + offsets[seq], blockDesc,
+                                           seq);
     }
 
+    return nrows;
+}
+
+/*
+ * Implementation of relation_acquire_sample_rows().
+ *
+ * The visibility relation tells how many tuples each block holds, so the
+ * total is known without reading any block, and blocks can be picked with
+ * probability proportional to their tuple count. A systematic sample over
+ * the running tuple count picks about targrows / TILE_ANALYZE_BLOCK_ROWS
+ * blocks, and every pick takes the same number of rows from its block, so
+ * each row is about as likely as any other to end up in the sample. Rows
+ * come back in the order of the visibility relation.
+ *
+ * Blocks are replaced as a whole, a visible block never holds dead rows.
+ */
+static int
+tile_acquire_sample_rows(Relation onerel, int elevel, HeapTuple *rows,
+                         int targrows, double *totalrows, double *totaldeadrows)
+{
+    Relation visiRel;
+    List *visiInfo;
+    ListCell *lc;
+    SamplerRandomState randstate;
+    char *bucketPath;
+    char *data;
+    char *rowBuf;
+    uint32 *offsets;
+    double total = 0;
+    double seen = 0;
+    double step = 0;
+    double next = 0;
+    int nblocks;
+    int perBlock = 0;
+    int numrows = 0;
+    int sampled = 0;
+
+    visiRel = table_open(PgTileGetVisiRelId(RelationGetRelid(onerel)),
+                         AccessShareLock);
+    visiInfo = tile_get_visi(visiRel, NULL, NIL);
+    table_close(visiRel, AccessShareLock);
+
+    foreach(lc, visiInfo)
+        total += ((BlockDesc *) lfirst(lc))->block_tuple_num;
 
-    // move forward in order to serve the next request
-    desc->bufferPointer += mtuple->t_len;
-    desc->seq++;
+    sampler_random_init_state(random(), randstate);
 
-    if (sample_it)
-        return true;
+    // a table no larger than the sample is read whole
+    nblocks = list_length(visiInfo);
+    if (total > targrows) {
+        nblocks = Min(nblocks, (targrows + TILE_ANALYZE_BLOCK_ROWS - 1) /
+                               TILE_ANALYZE_BLOCK_ROWS);
+        perBlock = (targrows + nblocks - 1) / nblocks;
+        step = total / nblocks;
+        next = step * sampler_random_fract(randstate);
+    }
+    pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_TOTAL, nblocks);
 
-    return false;
-}
+    bucketPath = TileMakeBucketPath(onerel->rd_node);
+    data = palloc(TILE_BLOCK_SIZE);
+    rowBuf = palloc(TILE_BLOCK_SIZE);
+    offsets = palloc(sizeof(uint32) * TILE_MAX_TUPLES);
 
+    foreach(lc, visiInfo) {
+        BlockDesc *blockDesc = lfirst(lc);
+        int want = blockDesc->block_tuple_num;
 
-static uint64
-tileam_relation_size(Relation rel, ForkNumber forkNumber)
-{
-    BlockNumber relpages;
-    double tuples;
+        seen += blockDesc->block_tuple_num;
+        if (step > 0) {
+            int picks = 0;
 
-    /*
-     * FIXME_CLOUD: use real data to get relation size
-     */
+            for (; next < seen; next += step)
+                picks++;
+            want = Min(want, picks * perBlock);
+        }
+        want = Min(want, targrows - numrows);
+        if (want <= 0)
+            continue;
 
-    relpages = rel->rd_rel->relpages;
+        vacuum_delay_point();
 
-    if (relpages == 0)
-    {
-        relpages = 10;
-        tuples = relpages * 400;
+        numrows += tile_analyze_block(onerel, bucketPath, blockDesc, want,
+                                      randstate, data, rowBuf, offsets,
+                                      rows + numrows);
+        pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_DONE, ++sampled);
     }
-    else
-    {
-        tuples = rel->rd_rel->reltuples < 400 ? 400 : rel->rd_rel->reltuples;
+
+    pfree(offsets);
+    pfree(rowBuf);
+    pfree(data);
+    pfree(bucketPath);
+
+    *totalrows = total;
+    *totaldeadrows = 0;
+
+    ereport(elevel,
+            (errmsg("\"%s\": sampled %d of %d blocks, "
+                    "containing %.0f rows; %d rows in sample",
+                    RelationGetRelationName(onerel), sampled,
+                    list_length(visiInfo), total, numrows)));
+
+    return numrows;
+}
+
+
+/*
+ * Feed every tuple the current snapshot sees to the index build. Tile
+ * visibility is decided per block, so all tuples returned are alive.
+ */
+static double
+tile_index_build_range_scan(Relation tableRel, Relation indexRel,
+                            IndexInfo *indexInfo, bool allow_sync,
+                            bool anyvisible, bool progress,
+                            BlockNumber start_blockno, BlockNumber numblocks,
+                            IndexBuildCallback callback, void *callback_state,
+                            TableScanDesc scan) {
+    Datum values[INDEX_MAX_KEYS];
+    bool isnull[INDEX_MAX_KEYS];
+    double reltuples = 0;
+    ExprState *predicate;
+    TupleTableSlot *slot;
+    EState *estate;
+    ExprContext *econtext;
+    Snapshot snapshot = NULL;
+
+    if (start_blockno != 0 || numblocks != InvalidBlockNumber)
+        elog(ERROR, "tile tables do not support block range index builds");
+
+    estate = CreateExecutorState();
+    econtext = GetPerTupleExprContext(estate);
+    slot = table_slot_create(tableRel, NULL);
+    econtext->ecxt_scantuple = slot;
+    predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+
+    if (!scan) {
+        snapshot = RegisterSnapshot(GetTransactionSnapshot());
+        scan = table_beginscan_strat(tableRel, snapshot, 0, NULL, true, allow_sync);
+    }
+
+    while (table_scan_getnextslot(scan, ForwardScanDirection, slot)) {
+        HeapTuple heapTuple;
+        bool shouldFree;
+
+        CHECK_FOR_INTERRUPTS();
+        MemoryContextReset(econtext->ecxt_per_tuple_memory);
+
+        if (predicate != NULL && !ExecQual(predicate, econtext))
+            continue;
+
+        FormIndexDatum(indexInfo, slot, estate, values, isnull);
+
+        heapTuple = ExecFetchSlotHeapTuple(slot, true, &shouldFree);
+        heapTuple->t_self = slot->tts_tid;
+        callback(indexRel, heapTuple, values, isnull, true, callback_state);
+        if (shouldFree)
+            heap_freetuple(heapTuple);
+
+        reltuples += 1;
     }
 
-    return (tuples * 100);
+    table_endscan(scan);
+    if (snapshot)
+        UnregisterSnapshot(snapshot);
+
+    ExecDropSingleTupleTableSlot(slot);
+    FreeExecutorState(estate);
+
+    indexInfo->ii_ExpressionsState = NIL;
+    indexInfo->ii_PredicateState = NULL;
+
+    return reltuples;
 }
 
+static void
+tile_index_validate_scan(Relation tableRel, Relation indexRel,
+                         IndexInfo *indexInfo, Snapshot snapshot,
+                         ValidateIndexState *state) {
+    ereport(ERROR,
+            (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+             errmsg("concurrent index builds are not supported on tile tables")));
+}
+
+/*
+ * Sum the stored size and tuple count of the blocks in the visibility
+ * relation, or return the sums already taken in this transaction. The
+ * visibility tuples are read directly rather than through tile_get_visi(),
+ * planning must not queue them for dispatch.
+ */
+static TileRelTotals *
+tile_relation_totals(Relation rel)
+{
+    TileRelTotals *totals;
+    Oid relid = RelationGetRelid(rel);
+    bool found;
+
+    if (tileRelTotals == NULL) {
+        HASHCTL ctl;
+
+        MemSet(&ctl, 0, sizeof(ctl));
+        ctl.keysize = sizeof(Oid);
+        ctl.entrysize = sizeof(TileRelTotals);
+        ctl.hcxt = TopTransactionContext;
+        tileRelTotals = hash_create("Tile relation totals", 16, &ctl,
+                                    HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+    }
+
+    totals = hash_search(tileRelTotals, &relid, HASH_FIND, NULL);
+    if (totals == NULL) {
+        Relation visiRel;
+        Snapshot snapshot;
+        TableScanDesc visiScan;
+        TupleTableSlot *visiSlot;
+        uint64 bytes = 0;
+        double tuples = 0;
+
+        visiRel = table_open(PgTileGetVisiRelId(relid), AccessShareLock);
+        snapshot = RegisterSnapshot(GetCatalogSnapshot(RelationGetRelid(visiRel)));
+        visiSlot = table_slot_create(visiRel, NULL);
+        visiScan = table_beginscan(visiRel, snapshot, 0, NULL);
+        while (table_scan_getnextslot(visiScan, ForwardScanDirection, visiSlot)) {
+            bool isNull;
+            Datum value;
+
+            value = slot_getattr(visiSlot, 1, &isNull);
+            if (!isNull)
+                bytes += DatumGetUInt32(value);
+            value = slot_getattr(visiSlot, 3, &isNull);
+            if (!isNull)
+                tuples += DatumGetUInt32(value);
+        }
+        table_endscan(visiScan);
+        ExecDropSingleTupleTableSlot(visiSlot);
+        UnregisterSnapshot(snapshot);
+        table_close(visiRel, AccessShareLock);
+
+        totals = hash_search(tileRelTotals, &relid, HASH_ENTER, &found);
+        totals->bytes = bytes;
+        totals->tuples = tuples;
+    }
+
+    return totals;
+}
+
+/* a new block of rel went into the visibility relation */
+static void
+tile_totals_add(Relation rel, uint32 bytes, uint32 tuples)
+{
+    TileRelTotals *totals;
+    Oid relid = RelationGetRelid(rel);
+
+    if (tileRelTotals == NULL)
+        return;
+
+    totals = hash_search(tileRelTotals, &relid, HASH_FIND, NULL);
+    if (totals) {
+        totals->bytes += bytes;
+        totals->tuples += tuples;
+    }
+}
+
+static void
+tile_totals_forget(Relation rel)
+{
+    Oid relid = RelationGetRelid(rel);
+
+    if (tileRelTotals)
+        hash_search(tileRelTotals, &relid, HASH_REMOVE, NULL);
+}
+
+/*
+ * Everything a tile table holds is in the bucket, under the main fork.
+ */
+static uint64
+tileam_relation_size(Relation rel, ForkNumber forkNumber)
+{
+    if (forkNumber != MAIN_FORKNUM && forkNumber != InvalidForkNumber)
+        return 0;
+
+    return tile_relation_totals(rel)->bytes;
+}
 
 static bool
 tileam_relation_needs_toast_table(Relation rel)
@@ -1121,25 +2864,307 @@ tileam_estimate_rel_size(Relation rel, int32 *attr_widths,
                          BlockNumber *pages, double *tuples,
                          double *allvisfrac)
 {
-    BlockNumber relpages;
+    TileRelTotals *totals = tile_relation_totals(rel);
 
-    relpages = rel->rd_rel->relpages;
+    /*
+     * Like heap, don't believe a table that was never written to and never
+     * analyzed is empty; it may be about to be filled.
+     */
+    if (totals->bytes == 0 && rel->rd_rel->relpages == 0) {
+        *pages = 10;
+        *tuples = *pages * 400;
+    } else {
+        *pages = (BlockNumber) Min((totals->bytes + BLCKSZ - 1) / BLCKSZ,
+                                   (uint64) MaxBlockNumber);
+        *tuples = totals->tuples;
+    }
 
-    if (relpages == 0)
-    {
-        relpages = 10;
-        *tuples = relpages * 400;
+    // blocks are immutable, nothing in them is ever left to vacuum
+    *allvisfrac = 1;
+}
+
+/*
+ * Merge the blocks whose tuples fill less than tile_merge_threshold percent
+ * of a block into as few full blocks as they fit in. Tuples are copied the
+ * way an UPDATE carries them over, with new index entries, and the visibility
+ * tuples of the merged blocks are deleted, for a later VACUUM to reclaim.
+ */
+static void
+tile_vacuum_merge(Relation onerel, Relation visiRel, TileVacuumState *vstate,
+                  int elevel)
+{
+    TupleDesc tupdesc = RelationGetDescr(onerel);
+    uint64 rawLimit;
+    int32 tupleWidth;
+    List *visiInfo;
+    List *candidates = NIL;
+    ListCell *lc;
+    TileDmlDesc dmlDesc;
+
+    if (tile_merge_threshold <= 0)
+        return;
+
+    // writers would update the visibility tuples of the blocks merged away
+    if (!ConditionalLockRelation(onerel, ExclusiveLock) ||
+        !ConditionalLockRelation(visiRel, ExclusiveLock)) {
+        ereport(elevel,
+                (errmsg("\"%s\": skipping block merge --- lock not available",
+                        RelationGetRelationName(onerel))));
+        return;
     }
-    else
-    {
-        *tuples = rel->rd_rel->reltuples < 400 ? 400 : rel->rd_rel->reltuples;
+
+    /*
+     * Unlike the rest of a lazy vacuum, merging writes the way DML does, so
+     * this backend must not be left out of snapshots and horizons from here
+     * on. The blocks are picked with a snapshot taken after that.
+     */
+    LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+    MyPgXact->vacuumFlags &= ~PROC_IN_VACUUM;
+    LWLockRelease(ProcArrayLock);
+
+    PushActiveSnapshot(GetLatestSnapshot());
+    visiInfo = tile_get_visi(visiRel, GetActiveSnapshot(), NIL);
+
+    // the raw size of a block is not recorded, estimate it from its tuples
+    tupleWidth = MAXALIGN(SizeofMinimalTupleHeader + BITMAPLEN(tupdesc->natts)) +
+                 get_rel_data_width(onerel, NULL);
+    rawLimit = (uint64) TILE_BLOCK_SIZE * tile_merge_threshold / 100;
+    foreach(lc, visiInfo) {
+        BlockDesc *blockDesc = lfirst(lc);
+
+        if ((uint64) blockDesc->block_tuple_num * tupleWidth < rawLimit)
+            candidates = lappend(candidates, blockDesc);
     }
 
-    *pages = relpages;
-    *allvisfrac = 1;
+    if (list_length(candidates) < 2) {
+        PopActiveSnapshot();
+        list_free(candidates);
+        list_free_deep(visiInfo);
+        return;
+    }
+
+    tile_totals_forget(onerel);
+    dmlDesc = getDmlDesc(onerel);
+    foreach(lc, candidates) {
+        BlockDesc *blockDesc = lfirst(lc);
+        TileBuf *oldBuf = dmlDesc->oldBuffer;
+        ItemPointerData heapTid;
+        TM_FailureData tmfd;
+        TileKey key;
+
+        heapTid = blockid_to_heaptid(blockDesc->blockid);
+        if (heap_delete(visiRel, &heapTid, GetCurrentCommandId(true), NULL, true,
+                        &tmfd, false) != TM_Ok)
+            continue;
+
+        key = GetBlockKeyFromBlockName(blockDesc->block_name);
+        tile_read_buf(onerel, blockid_seq_get_tile_tid(blockDesc->blockid, 0),
+                      key, oldBuf);
+
+        // the visibility tuple is gone already, set_page() must insert a new one
+        MemSet(&oldBuf->key, 0, sizeof(TileKey));
+        oldBuf->blockid = 0;
+
+        if (dmlDesc->newBuffer->bufSize + oldBuf->bufSize > TILE_BLOCK_SIZE) {
+            set_page(dmlDesc);
+            vstate->newBlocks++;
+        }
+
+        dmlDesc->oldBufferCurPtrTupNum = 1;
+        dmlDesc->oldBufferCurPtrDiff = 0;
+        MoveAfterToNewPage(dmlDesc);
+        dmlDesc->oldBufferCurPtrTupNum = 0;
+        oldBuf->bufSize = 0;
+        oldBuf->tupleNum = 0;
+        vstate->mergedBlocks++;
+    }
+    if (dmlDesc->newBuffer->bufSize > 0)
+        vstate->newBlocks++;
+
+    // writes the last block and waits for all of them to be uploaded
+    tile_access_release(onerel);
+
+    PopActiveSnapshot();
+    list_free(candidates);
+    list_free_deep(visiInfo);
+}
+
+/*
+ * Collect the names and block ids of the blocks whose visibility tuples are
+ * not dead to every snapshot, versions deleted or still being written
+ * included.
+ */
+static void
+tile_vacuum_live_blocks(Relation visiRel, TransactionId oldestXmin,
+                        TileVacuumState *vstate)
+{
+    HASHCTL ctl;
+    TableScanDesc scan;
+    HeapTuple tuple;
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = TILE_KEY_SIZE * 2 + 1;
+    ctl.entrysize = TILE_KEY_SIZE * 2 + 1;
+    ctl.hcxt = CurrentMemoryContext;
+    vstate->liveBlocks = hash_create("tile live blocks", 1024, &ctl,
+                                     HASH_ELEM | HASH_CONTEXT);
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = sizeof(uint32);
+    ctl.entrysize = sizeof(uint32);
+    ctl.hcxt = CurrentMemoryContext;
+    vstate->liveBlockids = hash_create("tile live block ids", 1024, &ctl,
+                                       HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+    scan = table_beginscan(visiRel, SnapshotAny, 0, NULL);
+    while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL) {
+        Buffer buffer = ((HeapScanDesc) scan)->rs_cbuf;
+        HTSV_Result result;
+        Datum name;
+        bool isNull;
+        uint32 blockid;
+
+        LockBuffer(buffer, BUFFER_LOCK_SHARE);
+        result = HeapTupleSatisfiesVacuum(tuple, oldestXmin, buffer);
+        LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+        if (result == HEAPTUPLE_DEAD)
+            continue;
+
+        name = heap_getattr(tuple, 2, RelationGetDescr(visiRel), &isNull);
+        blockid = heaptid_to_blockid(tuple->t_self);
+        hash_search(vstate->liveBlocks, DatumGetName(name)->data, HASH_ENTER, NULL);
+        hash_search(vstate->liveBlockids, &blockid, HASH_ENTER, NULL);
+    }
+    table_endscan(scan);
+}
+
+static bool
+tile_vacuum_is_garbage(TileVacuumState *vstate, TileKey key,
+                       const char *blockName)
+{
+    FullTransactionId writer;
+    TransactionId xid;
+
+    if (hash_search(vstate->liveBlocks, blockName, HASH_FIND, NULL))
+        return false;
+
+    /*
+     * A block missing from the visibility relation may be one a running
+     * transaction has uploaded but not registered yet.
+     */
+    writer.value = key.tid;
+    xid = XidFromFullTransactionId(writer);
+    if (!TransactionIdIsNormal(xid) ||
+        !FullTransactionIdPrecedes(writer, vstate->oldestXmin))
+        return false;
+
+    if (TransactionIdPrecedes(xid, ShmemVariableCache->oldestClogXid))
+        return true;
+
+    return TransactionIdDidCommit(xid) || TransactionIdDidAbort(xid);
+}
+
+/*
+ * Index entries only name blocks that were registered, so an entry is
+ * garbage once no visibility tuple is left at its block id.
+ */
+static bool
+tile_vacuum_index_callback(ItemPointer itemptr, void *state)
+{
+    TileVacuumState *vstate = (TileVacuumState *) state;
+    uint32 blockid = tile_tid_get_blockid(*itemptr);
+
+    return hash_search(vstate->liveBlockids, &blockid, HASH_FIND, NULL) == NULL;
 }
 
+/*
+ * Remove the index entries and then the objects of garbage blocks. The
+ * objects are found by listing the relation's prefix, so that blocks whose
+ * visibility tuples were pruned away before this ran are reclaimed too.
+ */
+static void
+tile_vacuum_gc(Relation onerel, Relation visiRel, TileVacuumState *vstate,
+               BufferAccessStrategy bstrategy, int elevel)
+{
+    TransactionId oldestXmin;
+    FullTransactionId nextFullXid;
+    uint32 epoch;
+    Relation *indexRels;
+    int nindexes;
+    int i;
+    char *bucketPath;
+    size_t prefixLen;
+    S3Objs s3Objs;
+    List *garbage = NIL;
+    ListCell *lc;
+    ListCell *lcSize;
+
+    oldestXmin = GetOldestXmin(visiRel, PROCARRAY_FLAGS_VACUUM);
+    nextFullXid = ReadNextFullTransactionId();
+    epoch = EpochFromFullTransactionId(nextFullXid);
+    if (oldestXmin > XidFromFullTransactionId(nextFullXid))
+        epoch--;
+    vstate->oldestXmin = FullTransactionIdFromEpochAndXid(epoch, oldestXmin);
+    tile_vacuum_live_blocks(visiRel, oldestXmin, vstate);
+
+    vac_open_indexes(onerel, RowExclusiveLock, &nindexes, &indexRels);
+    for (i = 0; i < nindexes; i++) {
+        IndexVacuumInfo ivinfo;
+        IndexBulkDeleteResult *stats;
+
+        ivinfo.index = indexRels[i];
+        ivinfo.analyze_only = false;
+        ivinfo.report_progress = false;
+        ivinfo.estimated_count = true;
+        ivinfo.message_level = elevel;
+        ivinfo.num_heap_tuples = onerel->rd_rel->reltuples;
+        ivinfo.strategy = bstrategy;
+
+        stats = index_bulk_delete(&ivinfo, NULL, tile_vacuum_index_callback,
+                                  (void *) vstate);
+        stats = index_vacuum_cleanup(&ivinfo, stats);
+        if (stats) {
+            vstate->removedIndexTuples += stats->tuples_removed;
+            pfree(stats);
+        }
+    }
+    vac_close_indexes(nindexes, indexRels, NoLock);
+
+    // object names are "<bucket path>_<block name>"
+    bucketPath = TileMakeBucketPath(onerel->rd_node);
+    prefixLen = strlen(bucketPath) + 1;
+    s3Objs = S3DeleteObjects(s3Client, bucketPath);
+    forboth(lc, s3Objs.objPathList, lcSize, s3Objs.objSizeList) {
+        char *objPath = lfirst(lc);
+        char *blockName = objPath + prefixLen;
+
+        if (strlen(objPath) == prefixLen + TILE_KEY_SIZE * 2 &&
+            tile_vacuum_is_garbage(vstate, GetBlockKeyFromBlockName(blockName),
+                                   blockName)) {
+            garbage = lappend(garbage, objPath);
+            vstate->removedObjects++;
+            vstate->removedBytes += lfirst_int(lcSize);
+        } else
+            pfree(objPath);
+    }
+
+    // a failure only leaves the objects for the next VACUUM
+    if (garbage != NIL)
+        S3DeleteObjectList(s3Client, garbage, WARNING);
 
+    list_free_deep(garbage);
+    list_free(s3Objs.objPathList);
+    list_free(s3Objs.objSizeList);
+    pfree(bucketPath);
+    hash_destroy(vstate->liveBlocks);
+    hash_destroy(vstate->liveBlockids);
+}
+
+/*
+ * Besides the visibility relation, VACUUM of a tile table merges undersized
+ * blocks and reclaims the blocks no snapshot can see. Both only happen in
+ * the catalog server cluster, which holds the visibility relation.
+ */
 static void
 tileam_vacuum(Relation onerel, VacuumParams *params,
               BufferAccessStrategy bstrategy)
@@ -1148,18 +3173,357 @@ tileam_vacuum(Relation onerel, VacuumParams *params,
                         AccessExclusiveLock : ShareUpdateExclusiveLock;
     Oid visiRelOid = PgTileGetVisiRelId(RelationGetRelid(onerel));
     Relation visiRel = table_open(visiRelOid, lmode);
-    heap_vacuum_rel(visiRel, params, bstrategy);
+    int elevel = (params->options & VACOPT_VERBOSE) ? INFO : DEBUG2;
+
+    if (IS_CATALOG_SERVER()) {
+        TileVacuumState vstate;
+
+        MemSet(&vstate, 0, sizeof(vstate));
+        tile_vacuum_merge(onerel, visiRel, &vstate, elevel);
+
+        /*
+         * Index entries name blocks by the TIDs of their visibility tuples,
+         * which vacuuming the visibility relation frees for reuse. Writers
+         * are kept out until the entries pointing at them are gone.
+         */
+        if (onerel->rd_rel->relhasindex)
+            LockRelation(visiRel, ShareLock);
+        heap_vacuum_rel(visiRel, params, bstrategy);
+        tile_vacuum_gc(onerel, visiRel, &vstate, bstrategy, elevel);
+
+        ereport(elevel,
+                (errmsg("\"%s\": merged %u blocks into %u, removed %.0f objects of %.0f bytes and %.0f index entries",
+                        RelationGetRelationName(onerel),
+                        vstate.mergedBlocks, vstate.newBlocks,
+                        vstate.removedObjects, vstate.removedBytes,
+                        vstate.removedIndexTuples)));
+    } else
+        heap_vacuum_rel(visiRel, params, bstrategy);
+
     relation_close(visiRel, lmode);
 }
 
 
+static TilePrefetchBuf *
+tile_prefetch_lookup(TileScanDesc scan, uint32 pageIdx)
+{
+    int i;
+
+    for (i = 0; i < scan->ringSize; i++) {
+        if (scan->ring[i].pageIdx == (int) pageIdx)
+            return &scan->ring[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * Whether the scan still needs the block at pageIdx: the current one, or one
+ * it is going to move to next. For a serial scan those are the blocks that
+ * follow, for a parallel one those it has taken from the shared cursor.
+ */
+static bool
+tile_prefetch_wanted(TileScanDesc scan, uint32 pageIdx)
+{
+    int i;
+
+    if (scan->rs_base.rs_parallel == NULL)
+        return pageIdx >= scan->curPageIdx &&
+               pageIdx < scan->curPageIdx + scan->ringSize;
+
+    if (pageIdx == scan->curPageIdx)
+        return true;
+    for (i = 0; i < scan->nclaimedPages; i++) {
+        if (scan->claimedPages[i] == pageIdx)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Pick a ring slot to reuse, one holding a block the scan no longer needs.
+ * Returns NULL if every slot is holding a wanted block.
+ */
+static TilePrefetchBuf *
+tile_prefetch_victim(TileScanDesc scan)
+{
+    int i;
+
+    for (i = 0; i < scan->ringSize; i++) {
+        TilePrefetchBuf *slot = &scan->ring[i];
+
+        if (slot->pageIdx < 0 || !tile_prefetch_wanted(scan, slot->pageIdx)) {
+            tile_prefetch_cancel(slot);
+            slot->pageIdx = -1;
+            if (slot->data == NULL)
+                slot->data = MemoryContextAlloc(scan->scanCtx, TILE_BLOCK_SIZE);
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Start reading a block into a ring slot. A projected scan first reads the
+ * block header, then only the byte ranges holding the chunks it needs. The
+ * header is read asynchronously too, and the ranges are asked for once it
+ * is here, see tile_prefetch_header. Whatever the local cache holds is read
+ * from it instead, and what has to come from S3 is noted in cacheFill.
+ */
+static void
+tile_prefetch_fetch(TileScanDesc scan, TilePrefetchBuf *slot, BlockDesc *blockDesc)
+{
+    int natts = RelationGetNumberOfAttributes(scan->rs_base.rs_rd);
+    int32 cached;
+
+    slot->dataLen = blockDesc->block_size;
+    slot->header = NULL;
+    slot->headerLen = 0;
+    slot->requests = NIL;
+    slot->cacheFill = NIL;
+
+    cached = tile_cache_read(scan->bucketPath, blockDesc->block_name, 0, 0,
+                             slot->data);
+    if (cached >= 0) {
+        slot->dataLen = cached;
+        return;
+    }
+
+    if (scan->proj) {
+        slot->headerLen = Min(TILE_BLOCK_HEADER_SIZE(natts), blockDesc->block_size);
+        if (tile_cache_read(scan->bucketPath, blockDesc->block_name, 0,
+                            slot->headerLen, slot->data) < 0) {
+            slot->header = S3GetObjectRangeAsync(s3Client, scan->bucketPath,
+                                                 blockDesc->block_name, 0,
+                                                 slot->headerLen, slot->data);
+            return;
+        }
+    }
+
+    tile_prefetch_columns(scan, slot, blockDesc);
+}
+
+/*
+ * Ask for the data of a block whose header, if the scan is projected, is
+ * in the slot: the ranges of the chunks the scan needs from a columnar
+ * block, or the whole object otherwise.
+ */
+static void
+tile_prefetch_columns(TileScanDesc scan, TilePrefetchBuf *slot, BlockDesc *blockDesc)
+{
+    int natts = RelationGetNumberOfAttributes(scan->rs_base.rs_rd);
+    TileBlockRange *ranges;
+    int nranges;
+    int i;
+    MemoryContext oldCtx;
+
+    oldCtx = MemoryContextSwitchTo(scan->scanCtx);
+
+    if (scan->proj && tile_block_is_columnar(slot->data, slot->headerLen)) {
+        bool *missing = palloc(sizeof(bool) * natts);
+
+        for (i = 0; i < natts; i++) {
+            TileBlockRange chunk;
+
+            missing[i] = scan->proj[i];
+            if (!missing[i] || !tile_block_chunk(slot->data, i, &chunk))
+                continue;
+
+            if (tile_cache_read(scan->bucketPath, blockDesc->block_name,
+                                chunk.offset, chunk.length,
+                                slot->data + chunk.offset) >= 0)
+                missing[i] = false;
+            else {
+                TileBlockRange *fill = palloc(sizeof(TileBlockRange));
+
+                *fill = chunk;
+                slot->cacheFill = lappend(slot->cacheFill, fill);
+            }
+        }
+
+        ranges = palloc(sizeof(TileBlockRange) * natts);
+        nranges = tile_block_ranges(slot->data, missing, natts, ranges);
+        pfree(missing);
+        for (i = 0; i < nranges; i++) {
+            void *request;
+
+            request = S3GetObjectRangeAsync(s3Client, scan->bucketPath,
+                                            blockDesc->block_name,
+                                            ranges[i].offset, ranges[i].length,
+                                            slot->data + ranges[i].offset);
+            slot->requests = lappend(slot->requests, request);
+        }
+        pfree(ranges);
+        MemoryContextSwitchTo(oldCtx);
+        return;
+    }
+
+    slot->requests = list_make1(S3GetObjectAsync(s3Client, scan->bucketPath,
+                                                 blockDesc->block_name, slot->data,
+                                                 TILE_BLOCK_SIZE));
+    slot->cacheFill = list_make1(palloc0(sizeof(TileBlockRange)));
+    MemoryContextSwitchTo(oldCtx);
+}
+
+/*
+ * Once the header GET of a slot is done, cache the header and ask for the
+ * chunks the scan needs. Unless wait is set, a header still on its way is
+ * left alone.
+ */
+static void
+tile_prefetch_header(TileScanDesc scan, TilePrefetchBuf *slot, bool wait)
+{
+    BlockDesc *blockDesc;
+    void *header = slot->header;
+
+    if (header == NULL || (!wait && !S3GetObjectDone(header)))
+        return;
+
+    slot->header = NULL;
+    S3GetObjectWait(header);
+
+    blockDesc = (BlockDesc *) list_nth(scan->visiInfo, slot->pageIdx);
+    tile_cache_insert(scan->bucketPath, blockDesc->block_name, 0, slot->headerLen,
+                      slot->data, slot->headerLen);
+    tile_prefetch_columns(scan, slot, blockDesc);
+}
+
+/*
+ * Add what a slot read from S3 to the local cache. A range of zero length
+ * stands for the whole object.
+ */
+static void
+tile_prefetch_fill_cache(TileScanDesc scan, TilePrefetchBuf *slot,
+                         BlockDesc *blockDesc)
+{
+    ListCell *lc;
+
+    foreach(lc, slot->cacheFill) {
+        TileBlockRange *range = lfirst(lc);
+
+        if (range->length == 0)
+            tile_cache_insert(scan->bucketPath, blockDesc->block_name, 0, 0,
+                              slot->data, slot->dataLen);
+        else
+            tile_cache_insert(scan->bucketPath, blockDesc->block_name,
+                              range->offset, range->length,
+                              slot->data + range->offset, range->length);
+    }
+    list_free_deep(slot->cacheFill);
+    slot->cacheFill = NIL;
+}
+
+static void
+tile_prefetch_wait(TileScanDesc scan, TilePrefetchBuf *slot)
+{
+    ListCell *lc;
+
+    tile_prefetch_header(scan, slot, true);
+    foreach(lc, slot->requests)
+        S3GetObjectWait(lfirst(lc));
+    list_free(slot->requests);
+    slot->requests = NIL;
+}
+
+static void
+tile_prefetch_cancel(TilePrefetchBuf *slot)
+{
+    ListCell *lc;
+
+    if (slot->header)
+        S3GetObjectCancel(slot->header);
+    slot->header = NULL;
+
+    foreach(lc, slot->requests)
+        S3GetObjectCancel(lfirst(lc));
+    list_free(slot->requests);
+    slot->requests = NIL;
+    list_free_deep(slot->cacheFill);
+    slot->cacheFill = NIL;
+}
+
+/*
+ * Keep up to tile_prefetch_blocks GETs in flight for the blocks following
+ * the current one, so the network transfer overlaps tuple processing. A
+ * parallel scan takes the blocks it reads ahead from the shared cursor, so
+ * each participant streams a different set of them. Slots whose headers
+ * have come in since the last call go on to read their chunks.
+ */
+static void
+tile_prefetch_issue(TileScanDesc scan)
+{
+    uint32 nblocks = list_length(scan->visiInfo);
+    uint32 last = scan->curPageIdx + scan->ringSize - 1;
+    uint32 next;
+    int i;
+
+    for (i = 0; i < scan->ringSize; i++)
+        tile_prefetch_header(scan, &scan->ring[i], false);
+
+    if (scan->rs_base.rs_parallel) {
+        while (scan->nclaimedPages < scan->ringSize - 1 &&
+               tile_parallel_claim(scan, &next)) {
+            TilePrefetchBuf *slot;
+
+            slot = tile_prefetch_victim(scan);
+            Assert(slot != NULL);
+            scan->claimedPages[scan->nclaimedPages++] = next;
+            slot->pageIdx = next;
+            tile_prefetch_fetch(scan, slot, (BlockDesc *) list_nth(scan->visiInfo, next));
+        }
+        return;
+    }
+
+    for (next = scan->curPageIdx + 1; next <= last; next++) {
+        TilePrefetchBuf *slot;
+
+        if (next >= nblocks) {
+            // a dynamic scan claims the blocks it reads ahead
+            if (!scan->dynamic || !tile_claim_blocks(scan))
+                break;
+            nblocks = list_length(scan->visiInfo);
+        }
+
+        if (tile_prefetch_lookup(scan, next))
+            continue;
+
+        slot = tile_prefetch_victim(scan);
+        if (slot == NULL)
+            break;
+
+        slot->pageIdx = next;
+        tile_prefetch_fetch(scan, slot, (BlockDesc *) list_nth(scan->visiInfo, next));
+    }
+}
+
+static void
+tile_prefetch_release(TileScanDesc scan)
+{
+    int i;
+
+    for (i = 0; i < scan->ringSize; i++) {
+        tile_prefetch_cancel(&scan->ring[i]);
+        if (scan->ring[i].data)
+            pfree(scan->ring[i].data);
+    }
+    pfree(scan->ring);
+    pfree(scan->bucketPath);
+    if (scan->rowBuffer)
+        pfree(scan->rowBuffer);
+    if (scan->proj)
+        pfree(scan->proj);
+    scan->ring = NULL;
+    scan->rowBuffer = NULL;
+    scan->buffer = NULL;
+}
+
 static void
 getblock_internal(TileScanDesc scanDesc)
 {
-    char *bucketPath;
-    uint32 count;
     BlockDesc *blockDesc;
-    MinimalTuple mtuple;
+    TilePrefetchBuf *slot;
 
     Assert(scanDesc->curPageIdx < list_length(scanDesc->visiInfo) &&
         scanDesc->curPageIdx >= 0);
@@ -1170,34 +3534,59 @@ getblock_internal(TileScanDesc scanDesc)
     scanDesc->key = GetBlockKeyFromBlockName(blockDesc->block_name);
     scanDesc->seq = 0;
 
-    scanDesc->bufTupleLenArrPtr = scanDesc->bufTupleLenArr;
-    scanDesc->bufTupleNum = blockDesc->block_tuple_num;
-
-    bucketPath = TileMakeBucketPath(scanDesc->rs_base.rs_rd->rd_node);
-    scanDesc->bufferLen = S3GetObject2(s3Client, bucketPath, blockDesc->block_name,
-                                       scanDesc->buffer);
-    Assert(scanDesc->bufferLen == blockDesc->block_size);
-    pfree(bucketPath);
-    scanDesc->bufferPointer = scanDesc->buffer;
-
-    count = 0;
-    while (count < blockDesc->block_tuple_num) {
-        Assert(scanDesc->bufferPointer - scanDesc->buffer < TILE_BLOCK_SIZE);
-        mtuple = (MinimalTuple) (scanDesc->bufferPointer);
-        memcpy(scanDesc->bufTupleLenArrPtr, &mtuple->t_len, sizeof(mtuple->t_len));
-        scanDesc->bufTupleLenArrPtr += sizeof(mtuple->t_len);
-        count += 1;
-        scanDesc->bufferPointer += mtuple->t_len;
+    slot = tile_prefetch_lookup(scanDesc, scanDesc->curPageIdx);
+    if (slot == NULL) {
+        // not read ahead, e.g. the first block or a backward move
+        slot = tile_prefetch_victim(scanDesc);
+        Assert(slot != NULL);
+        slot->pageIdx = scanDesc->curPageIdx;
+        tile_prefetch_fetch(scanDesc, slot, blockDesc);
+    }
+    tile_prefetch_wait(scanDesc, slot);
+    tile_prefetch_fill_cache(scanDesc, slot, blockDesc);
+
+    if (tile_block_is_columnar(slot->data, slot->dataLen)) {
+        if (scanDesc->rowBuffer == NULL)
+            scanDesc->rowBuffer = MemoryContextAlloc(scanDesc->scanCtx,
+                                                     TILE_BLOCK_SIZE);
+        scanDesc->bufferLen = tile_block_decode(RelationGetDescr(scanDesc->rs_base.rs_rd),
+                                                slot->data, scanDesc->proj,
+                                                scanDesc->rowBuffer,
+                                                scanDesc->tupleOffsets);
+        scanDesc->bufTupleNum = tile_block_ntuples(slot->data);
+        scanDesc->buffer = scanDesc->rowBuffer;
+    } else {
+        scanDesc->buffer = slot->data;
+        scanDesc->bufferLen = slot->dataLen;
+        scanDesc->bufTupleNum = tile_block_row_offsets(slot->data,
+                                                       &scanDesc->bufferLen,
+                                                       scanDesc->tupleOffsets);
     }
+    Assert(scanDesc->bufTupleNum == blockDesc->block_tuple_num);
     scanDesc->bufferPointer = scanDesc->buffer;
-    scanDesc->bufTupleLenArrPtr = scanDesc->bufTupleLenArr;
+
+    tile_prefetch_issue(scanDesc);
 }
 
 static bool
 tile_get_page(TileScanDesc desc, BLOCKMOVE page_move) {
     switch (page_move) {
         case FORWARD: {
-            if (desc->curPageIdx == list_length(desc->visiInfo) - 1) {
+            if (desc->rs_base.rs_parallel) {
+                uint32 next;
+
+                if (desc->nclaimedPages > 0) {
+                    next = desc->claimedPages[0];
+                    desc->nclaimedPages--;
+                    memmove(desc->claimedPages, desc->claimedPages + 1,
+                            sizeof(uint32) * desc->nclaimedPages);
+                } else if (!tile_parallel_claim(desc, &next))
+                    return false;
+                desc->curPageIdx = next;
+                break;
+            }
+            if (desc->curPageIdx == list_length(desc->visiInfo) - 1 &&
+                !(desc->dynamic && tile_claim_blocks(desc))) {
                 return false;
             }
             desc->curPageIdx += 1;
@@ -1219,44 +3608,30 @@ tile_get_page(TileScanDesc desc, BLOCKMOVE page_move) {
     return true;
 }
 
+/*
+ * Remove the objects of a dropped or truncated relation. This runs once the
+ * transaction has committed, so a failure only leaves garbage in the bucket
+ * and is not worth more than a warning.
+ */
 void
 tile_clear_table(RelFileNode rd_node) {
-    S3Objs s3_objs;
-    ListCell *lc;
-    S3ObjKey s3_obj_key;
-
-    s3_obj_key.bucketName = TileMakeBucketPath(rd_node);
-    s3_objs = S3DeleteObjects(s3Client, s3_obj_key.bucketName);
-
-    foreach(lc, s3_objs.objPathList)
-    {
-        s3_obj_key.objectName = lfirst(lc);
-        S3DeleteObject(s3Client, s3_obj_key.objectName);
-        pfree(s3_obj_key.objectName);
-    }
+    char *bucketPath;
 
-	pfree(s3_obj_key.bucketName);
+    bucketPath = TileMakeBucketPath(rd_node);
+    tile_cache_drop(bucketPath);
+    S3DeletePrefix(s3Client, bucketPath, WARNING);
+    pfree(bucketPath);
 }
 
 void
 tile_clear_db(Oid spcNode, Oid dbNode)
 {
     char *prefix;
-    S3Objs s3_objs;
-    ListCell *lc;
 
     prefix = TileMakeDbPrefix(spcNode, dbNode);
-    s3_objs = S3DeleteObjects(s3Client, prefix);
+    tile_cache_drop(prefix);
+    S3DeletePrefix(s3Client, prefix, WARNING);
     pfree(prefix);
-
-    foreach(lc, s3_objs.objPathList)
-    {
-        char *object_name;
-
-        object_name = lfirst(lc);
-        S3DeleteObject(s3Client, object_name);
-        pfree(object_name);
-    }
 }
 
 static TileDmlDesc
@@ -1267,13 +3642,12 @@ getDmlDesc(Relation relation)
         relation->tileDmlDesc = MemoryContextAllocZero(CacheMemoryContext,
                                                        sizeof(TileDmlDescData));
         relation->tileDmlDesc->mainRel = relation;
+        relation->tileDmlDesc->visiRelid = PgTileGetVisiRelId(RelationGetRelid(relation));
         if (myClusterId != 0)
             relation->tileDmlDesc->visibilityRel = NULL;
-        else {
-            Oid visibilityRelid = PgTileGetVisiRelId(RelationGetRelid(relation));
-            relation->tileDmlDesc->visibilityRel = table_open(visibilityRelid,
+        else
+            relation->tileDmlDesc->visibilityRel = table_open(relation->tileDmlDesc->visiRelid,
                                                               RowExclusiveLock);
-        }
 
         relation->tileDmlDesc->oldBuffer = tile_init_buf();
         relation->tileDmlDesc->oldBufferCurPtrDiff = 0;
@@ -1282,6 +3656,7 @@ getDmlDesc(Relation relation)
         relation->tileDmlDesc->newBuffer = tile_init_buf_with_tid();
         relation->tileDmlDesc->newBufferTupNum = 0; // invalid, no data
         relation->tileDmlDesc->visibilityInfo = NIL;
+        relation->tileDmlDesc->sortAttno = tile_sort_attno(relation);
     }
 
     return relation->tileDmlDesc;
@@ -1295,14 +3670,11 @@ get_fetch_descriptor(Relation relation)
         relation->tileFetchDesc = MemoryContextAllocZero(CacheMemoryContext,
                                                     sizeof(TileFetchDescData));
         relation->tileFetchDesc->mainRel = relation;
-        if (myClusterId == 0) {
-            Oid visiRelOid = PgTileGetVisiRelId(RelationGetRelid(relation));
-            relation->tileFetchDesc->visibilityRel = table_open(visiRelOid,
+        relation->tileFetchDesc->visiRelid = PgTileGetVisiRelId(RelationGetRelid(relation));
+        if (myClusterId == 0)
+            relation->tileFetchDesc->visibilityRel = table_open(relation->tileFetchDesc->visiRelid,
                                                                 AccessShareLock);
-        }
         relation->tileFetchDesc->buffer = NULL;
-        relation->tileFetchDesc->bufferCurPtrDiff = 0;
-        relation->tileFetchDesc->bufferCurPtrTupNum = 0;
     }
 
     return relation->tileFetchDesc;
@@ -1317,6 +3689,7 @@ static const TableAmRoutine tile_methods = {
 
     .scan_prepare_dispatch = tile_scan_prepare_dispatch,
     .scan_begin = tile_beginscan,
+    .scan_begin_extractcolumns = tile_beginscan_extractcolumns,
     .scan_end = tile_endscan,
     .scan_rescan = tile_rescan,
     .scan_getnextslot = tile_getnextslot,
@@ -1350,12 +3723,16 @@ static const TableAmRoutine tile_methods = {
     .relation_nontransactional_truncate = tile_nontransactional_truncate,
     .scan_analyze_next_block = tile_scan_analyze_next_block,
     .scan_analyze_next_tuple = tile_scan_analyze_next_tuple,
+    .relation_acquire_sample_rows = tile_acquire_sample_rows,
 
     .relation_size = tileam_relation_size,
     .relation_needs_toast_table = tileam_relation_needs_toast_table,
 
     .relation_estimate_size = tileam_estimate_rel_size,
 
+    .index_build_range_scan = tile_index_build_range_scan,
+    .index_validate_scan = tile_index_validate_scan,
+
     .relation_vacuum = tileam_vacuum
 };
 
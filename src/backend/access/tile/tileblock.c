@@ -0,0 +1,609 @@
+/*
+ * tileblock.c
+ *
+ * On-object layout of tile blocks.
+ *
+ * In memory a tile block is a plain concatenation of MinimalTuples, which is
+ * what the DML paths in tileam.c append to and walk. When a block is written
+ * to object storage it is converted into a columnar layout:
+ *
+ *		TileBlockHeader
+ *		TileChunkDesc[natts]
+ *		chunk for attribute 1
+ *		...
+ *		chunk for attribute natts
+ *
+ * Each chunk holds a null bitmap for all tuples of the block followed by the
+ * non-null values of that attribute, aligned the same way they are inside a
+ * heap tuple. Every chunk is compressed on its own, so a scan that only needs
+ * a few attributes can range-read the header and just those chunks.
+ *
+ * Objects written before the columnar layout existed start directly with a
+ * MinimalTuple, whose t_len can never match TILE_BLOCK_MAGIC, and are still
+ * read as they are. A block whose columnar form would not fit is stored the
+ * same way, with the offset of each tuple and a TileBlockTrailer appended so
+ * readers need not walk it. Either way a reader ends up with an array of
+ * tuple offsets, which is how tuples are located by sequence number.
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/tileam.h"
+#include "access/tupdesc_details.h"
+#include "catalog/pg_compression.h"
+#include "storage/gp_compress.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+int tile_compresstype = TILE_COMPRESS_DEFAULT;
+int tile_compresslevel = 1;
+
+/* chunks closer together than this are fetched with a single range read */
+#define TILE_RANGE_MERGE_GAP (64 * 1024)
+
+static uint32 tile_chunk_compress(int *compressType, char *src, uint32 srcLen,
+								  char *dst);
+static void tile_chunk_decompress(int compressType, char *src, uint32 srcLen,
+								  char *dst, uint32 dstLen);
+
+#ifdef HAVE_LIBZ
+static CompressionState *
+tile_zlib_state(bool compress)
+{
+	static CompressionState *compressState = NULL;
+	static CompressionState *decompressState = NULL;
+	CompressionState **state = compress ? &compressState : &decompressState;
+
+	if (*state == NULL)
+	{
+		MemoryContext oldCtx = MemoryContextSwitchTo(TopMemoryContext);
+		StorageAttributes sa;
+
+		sa.comptype = "zlib";
+		sa.complevel = Min(tile_compresslevel, 9);
+		sa.blocksize = TILE_BLOCK_SIZE;
+		sa.typid = InvalidOid;
+		*state = callCompressionConstructor(zlib_constructor, NULL, &sa, compress);
+
+		MemoryContextSwitchTo(oldCtx);
+	}
+
+	return *state;
+}
+#endif
+
+/*
+ * Compress srcLen bytes into dst, which has room for srcLen bytes. If the
+ * data does not shrink the chunk is stored as it is and *compressType is
+ * reset to TILE_COMPRESS_NONE.
+ */
+static uint32
+tile_chunk_compress(int *compressType, char *src, uint32 srcLen, char *dst)
+{
+	int32 compressedLen = srcLen;
+
+	switch (*compressType)
+	{
+#ifdef USE_ZSTD
+		case TILE_COMPRESS_ZSTD:
+		{
+			static ZSTD_CCtx *cctx = NULL;
+			size_t	used;
+
+			if (!cctx)
+			{
+				cctx = ZSTD_createCCtx();
+				if (!cctx)
+					elog(ERROR, "out of memory");
+			}
+
+			used = ZSTD_compressCCtx(cctx, dst, srcLen, src, srcLen,
+									 tile_compresslevel);
+			if (!ZSTD_isError(used))
+				compressedLen = used;
+			break;
+		}
+#endif
+#ifdef HAVE_LIBZ
+		case TILE_COMPRESS_ZLIB:
+			gp_trycompress((uint8 *) src, srcLen, (uint8 *) dst, srcLen,
+						   &compressedLen, zlib_compress, tile_zlib_state(true));
+			break;
+#endif
+		default:
+			break;
+	}
+
+	if (compressedLen >= srcLen)
+	{
+		memcpy(dst, src, srcLen);
+		*compressType = TILE_COMPRESS_NONE;
+		return srcLen;
+	}
+
+	return compressedLen;
+}
+
+static void
+tile_chunk_decompress(int compressType, char *src, uint32 srcLen, char *dst,
+					  uint32 dstLen)
+{
+	switch (compressType)
+	{
+		case TILE_COMPRESS_NONE:
+			Assert(srcLen == dstLen);
+			memcpy(dst, src, srcLen);
+			break;
+#ifdef USE_ZSTD
+		case TILE_COMPRESS_ZSTD:
+		{
+			static ZSTD_DCtx *dctx = NULL;
+			size_t	used;
+
+			if (!dctx)
+			{
+				dctx = ZSTD_createDCtx();
+				if (!dctx)
+					elog(ERROR, "out of memory");
+			}
+
+			used = ZSTD_decompressDCtx(dctx, dst, dstLen, src, srcLen);
+			if (ZSTD_isError(used))
+				elog(ERROR, "tile chunk decompression failed: %s",
+					 ZSTD_getErrorName(used));
+			if (used != dstLen)
+				elog(ERROR, "tile chunk decompressed to %zu bytes, expected %u",
+					 used, dstLen);
+			break;
+		}
+#endif
+#ifdef HAVE_LIBZ
+		case TILE_COMPRESS_ZLIB:
+			gp_decompress((uint8 *) src, srcLen, (uint8 *) dst, dstLen,
+						  zlib_decompress, tile_zlib_state(false), 0);
+			break;
+#endif
+		default:
+			elog(ERROR, "tile chunk uses unsupported compression type %d",
+				 compressType);
+	}
+}
+
+bool
+tile_block_is_columnar(char *data, uint32 dataLen)
+{
+	TileBlockHeader header;
+
+	if (dataLen < sizeof(TileBlockHeader))
+		return false;
+
+	memcpy(&header, data, sizeof(TileBlockHeader));
+
+	return header.magic == TILE_BLOCK_MAGIC;
+}
+
+/*
+ * Convert a block of MinimalTuples into the columnar object layout.
+ *
+ * Returns a palloc'd buffer, or rows itself if the columnar form does not
+ * fit in TILE_BLOCK_SIZE, in which case the block is stored row by row.
+ * The block's zone map is built on the way and returned in *zonemap.
+ */
+char *
+tile_block_encode(TupleDesc tupdesc, char *rows, uint32 rowsLen,
+				  uint32 ntuples, uint32 *encodedLen, bytea **zonemap)
+{
+	int			natts = tupdesc->natts;
+	Datum	   *values;
+	bool	   *isnull;
+	char	   *ptr;
+	uint32	   *offsets;
+	uint32		headerSize;
+	uint32		i;
+	int			attno;
+	StringInfoData out;
+	StringInfoData raw;
+	TileBlockHeader header;
+	TileChunkDesc *chunks;
+
+	values = palloc(sizeof(Datum) * natts * ntuples);
+	isnull = palloc(sizeof(bool) * natts * ntuples);
+	offsets = palloc(sizeof(uint32) * ntuples);
+
+	ptr = rows;
+	for (i = 0; i < ntuples; i++)
+	{
+		MinimalTuple mtuple = (MinimalTuple) ptr;
+		HeapTupleData htup;
+
+		offsets[i] = ptr - rows;
+
+		htup.t_len = mtuple->t_len + MINIMAL_TUPLE_OFFSET;
+		htup.t_data = (HeapTupleHeader) ((char *) mtuple - MINIMAL_TUPLE_OFFSET);
+		heap_deform_tuple(&htup, tupdesc, values + i * natts, isnull + i * natts);
+
+		ptr += mtuple->t_len;
+	}
+	Assert(ptr - rows == rowsLen);
+
+	*zonemap = tile_zonemap_build(tupdesc, values, isnull, ntuples);
+
+	headerSize = TILE_BLOCK_HEADER_SIZE(natts);
+	chunks = palloc0(sizeof(TileChunkDesc) * natts);
+
+	initStringInfo(&out);
+	enlargeStringInfo(&out, MAXALIGN(headerSize));
+	MemSet(out.data, 0, MAXALIGN(headerSize));
+	out.len = MAXALIGN(headerSize);
+
+	initStringInfo(&raw);
+	for (attno = 0; attno < natts; attno++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+		uint32	bitmapLen = BITMAPLEN(ntuples);
+		int		compressType = tile_compresstype;
+
+		/* null bitmap first, bit set means not null like in heap tuples */
+		resetStringInfo(&raw);
+		enlargeStringInfo(&raw, bitmapLen);
+		MemSet(raw.data, 0, bitmapLen);
+		raw.len = bitmapLen;
+
+		for (i = 0; i < ntuples; i++)
+		{
+			Datum	value = values[i * natts + attno];
+			Size	off;
+			Size	len;
+
+			if (isnull[i * natts + attno])
+				continue;
+
+			raw.data[i >> 3] |= (1 << (i & 0x07));
+
+			off = att_align_datum(raw.len, att->attalign, att->attlen, value);
+			len = att_addlength_datum(0, att->attlen, value);
+			enlargeStringInfo(&raw, off - raw.len + len);
+			MemSet(raw.data + raw.len, 0, off - raw.len);
+
+			if (att->attbyval)
+				store_att_byval(raw.data + off, value, att->attlen);
+			else
+				memcpy(raw.data + off, DatumGetPointer(value), len);
+
+			raw.len = off + len;
+		}
+
+		enlargeStringInfo(&out, raw.len + MAXIMUM_ALIGNOF);
+		MemSet(out.data + out.len, 0, MAXALIGN(out.len) - out.len);
+		out.len = MAXALIGN(out.len);
+		chunks[attno].offset = out.len;
+		chunks[attno].rawSize = raw.len;
+		chunks[attno].size = tile_chunk_compress(&compressType, raw.data, raw.len,
+												 out.data + out.len);
+		chunks[attno].compressType = compressType;
+		out.len += chunks[attno].size;
+	}
+
+	pfree(raw.data);
+	pfree(values);
+	pfree(isnull);
+
+	if (out.len > TILE_BLOCK_SIZE)
+	{
+		uint32		trailerLen = sizeof(uint32) * ntuples + sizeof(TileBlockTrailer);
+		TileBlockTrailer trailer;
+
+		pfree(chunks);
+		pfree(out.data);
+
+		if (rowsLen + trailerLen > TILE_BLOCK_SIZE)
+		{
+			pfree(offsets);
+			*encodedLen = rowsLen;
+			return rows;
+		}
+
+		trailer.ntuples = ntuples;
+		trailer.magic = TILE_TRAILER_MAGIC;
+		ptr = palloc(rowsLen + trailerLen);
+		memcpy(ptr, rows, rowsLen);
+		memcpy(ptr + rowsLen, offsets, sizeof(uint32) * ntuples);
+		memcpy(ptr + rowsLen + sizeof(uint32) * ntuples, &trailer,
+			   sizeof(TileBlockTrailer));
+		pfree(offsets);
+
+		*encodedLen = rowsLen + trailerLen;
+		return ptr;
+	}
+	pfree(offsets);
+
+	header.magic = TILE_BLOCK_MAGIC;
+	header.version = TILE_BLOCK_VERSION;
+	header.natts = natts;
+	header.ntuples = ntuples;
+	header.headerSize = headerSize;
+	memcpy(out.data, &header, sizeof(TileBlockHeader));
+	memcpy(out.data + sizeof(TileBlockHeader), chunks,
+		   sizeof(TileChunkDesc) * natts);
+	pfree(chunks);
+
+	*encodedLen = out.len;
+	return out.data;
+}
+
+static void
+tile_block_read_header(char *block, TileBlockHeader *header)
+{
+	memcpy(header, block, sizeof(TileBlockHeader));
+
+	if (header->magic != TILE_BLOCK_MAGIC)
+		elog(ERROR, "tile block has an invalid magic number %08x",
+			 header->magic);
+	if (header->version != TILE_BLOCK_VERSION)
+		elog(ERROR, "tile block has unsupported version %u", header->version);
+}
+
+/*
+ * Work out which byte ranges of a columnar block must be fetched to decode
+ * the attributes in proj. block holds at least the header and directory.
+ * Chunks lying close together are merged into a single range.
+ */
+int
+tile_block_ranges(char *block, bool *proj, int natts, TileBlockRange *ranges)
+{
+	TileBlockHeader header;
+	TileChunkDesc *chunks;
+	int		nranges = 0;
+	int		attno;
+
+	tile_block_read_header(block, &header);
+	chunks = (TileChunkDesc *) (block + sizeof(TileBlockHeader));
+
+	for (attno = 0; attno < Min(natts, header.natts); attno++)
+	{
+		TileChunkDesc chunk;
+
+		if (proj && !proj[attno])
+			continue;
+
+		memcpy(&chunk, &chunks[attno], sizeof(TileChunkDesc));
+		if (chunk.size == 0)
+			continue;
+
+		if (nranges > 0 &&
+			chunk.offset <= ranges[nranges - 1].offset +
+							ranges[nranges - 1].length + TILE_RANGE_MERGE_GAP)
+		{
+			ranges[nranges - 1].length = chunk.offset + chunk.size -
+										 ranges[nranges - 1].offset;
+		}
+		else
+		{
+			ranges[nranges].offset = chunk.offset;
+			ranges[nranges].length = chunk.size;
+			nranges++;
+		}
+	}
+
+	return nranges;
+}
+
+/*
+ * Rebuild the MinimalTuples of a columnar block into rows, which has room
+ * for TILE_BLOCK_SIZE bytes, and the offset of each of them into offsets.
+ * Attributes not in proj come back as NULL and their chunks need not be
+ * present in block. Returns the number of bytes written to rows.
+ */
+uint32
+tile_block_decode(TupleDesc tupdesc, char *block, bool *proj, char *rows,
+				  uint32 *offsets)
+{
+	TileBlockHeader header;
+	TileChunkDesc *chunks;
+	TupleDesc	blockDesc = tupdesc;
+	int			natts;
+	int			attno;
+	uint32		i;
+	char	  **chunkData;
+	bool	   *chunkCopied;
+	Size	   *chunkOff;
+	Datum	   *values;
+	bool	   *isnull;
+	char	   *ptr = rows;
+
+	tile_block_read_header(block, &header);
+	chunks = (TileChunkDesc *) (block + sizeof(TileBlockHeader));
+
+	/*
+	 * Attributes added after the block was written are left out of the
+	 * tuple, so that the slot fills in their missing values.
+	 */
+	natts = Min(header.natts, tupdesc->natts);
+	if (natts < tupdesc->natts)
+	{
+		blockDesc = CreateTupleDescCopy(tupdesc);
+		blockDesc->natts = natts;
+	}
+
+	chunkData = palloc0(sizeof(char *) * natts);
+	chunkCopied = palloc0(sizeof(bool) * natts);
+	chunkOff = palloc0(sizeof(Size) * natts);
+	values = palloc(sizeof(Datum) * natts);
+	isnull = palloc(sizeof(bool) * natts);
+
+	for (attno = 0; attno < natts; attno++)
+	{
+		TileChunkDesc chunk;
+
+		if (proj && !proj[attno])
+			continue;
+
+		memcpy(&chunk, &chunks[attno], sizeof(TileChunkDesc));
+		if (chunk.compressType == TILE_COMPRESS_NONE)
+			chunkData[attno] = block + chunk.offset;
+		else
+		{
+			chunkData[attno] = palloc(chunk.rawSize);
+			chunkCopied[attno] = true;
+			tile_chunk_decompress(chunk.compressType, block + chunk.offset,
+								  chunk.size, chunkData[attno], chunk.rawSize);
+		}
+		chunkOff[attno] = BITMAPLEN(header.ntuples);
+	}
+
+	for (i = 0; i < header.ntuples; i++)
+	{
+		MinimalTuple mtuple = (MinimalTuple) ptr;
+		bool	hasnull = false;
+		Size	len;
+		Size	dataLen;
+		int		hoff;
+
+		for (attno = 0; attno < natts; attno++)
+		{
+			Form_pg_attribute att = TupleDescAttr(blockDesc, attno);
+			char   *data = chunkData[attno];
+
+			if (data == NULL || att_isnull(i, (bits8 *) data))
+			{
+				values[attno] = (Datum) 0;
+				isnull[attno] = true;
+				hasnull = true;
+				continue;
+			}
+
+			chunkOff[attno] = att_align_pointer(chunkOff[attno], att->attalign,
+												att->attlen,
+												data + chunkOff[attno]);
+			values[attno] = fetchatt(att, data + chunkOff[attno]);
+			isnull[attno] = false;
+			chunkOff[attno] = att_addlength_pointer(chunkOff[attno], att->attlen,
+													data + chunkOff[attno]);
+		}
+
+		/* same layout heap_form_minimal_tuple() produces, built in place */
+		len = SizeofMinimalTupleHeader;
+		if (hasnull)
+			len += BITMAPLEN(natts);
+		hoff = len = MAXALIGN(len);
+		dataLen = heap_compute_data_size(blockDesc, values, isnull);
+		len += dataLen;
+
+		if (ptr + len > rows + TILE_BLOCK_SIZE)
+			elog(ERROR, "decoded tile block exceeds %d bytes", TILE_BLOCK_SIZE);
+
+		MemSet(mtuple, 0, len);
+		offsets[i] = ptr - rows;
+		mtuple->t_len = len;
+		HeapTupleHeaderSetNatts(mtuple, natts);
+		mtuple->t_hoff = hoff + MINIMAL_TUPLE_OFFSET;
+		heap_fill_tuple(blockDesc, values, isnull, (char *) mtuple + hoff,
+						dataLen, &mtuple->t_infomask,
+						(hasnull ? mtuple->t_bits : NULL));
+
+		ptr += len;
+	}
+
+	for (attno = 0; attno < natts; attno++)
+	{
+		if (chunkCopied[attno])
+			pfree(chunkData[attno]);
+	}
+	pfree(chunkData);
+	pfree(chunkCopied);
+	pfree(chunkOff);
+	pfree(values);
+	pfree(isnull);
+	if (blockDesc != tupdesc)
+		FreeTupleDesc(blockDesc);
+
+	return ptr - rows;
+}
+
+/*
+ * Fill offsets, which has room for TILE_MAX_TUPLES entries, with where each
+ * tuple of a row-format block starts, and return the number of tuples. The
+ * offsets come from the trailer when the block has one, in which case
+ * *rowsLen is cut down to the tuple data. Older blocks are walked instead.
+ */
+uint32
+tile_block_row_offsets(char *rows, uint32 *rowsLen, uint32 *offsets)
+{
+	TileBlockTrailer trailer;
+	uint32		len = *rowsLen;
+	uint32		ntuples = 0;
+	uint32		off;
+
+	if (len > sizeof(TileBlockTrailer))
+	{
+		memcpy(&trailer, rows + len - sizeof(TileBlockTrailer),
+			   sizeof(TileBlockTrailer));
+
+		if (trailer.magic == TILE_TRAILER_MAGIC &&
+			trailer.ntuples > 0 && trailer.ntuples <= TILE_MAX_TUPLES &&
+			sizeof(uint32) * trailer.ntuples + sizeof(TileBlockTrailer) < len)
+		{
+			uint32		dataLen;
+			uint32		last;
+
+			dataLen = len - sizeof(TileBlockTrailer) -
+				sizeof(uint32) * trailer.ntuples;
+			memcpy(offsets, rows + dataLen, sizeof(uint32) * trailer.ntuples);
+			last = offsets[trailer.ntuples - 1];
+
+			/* a row block without a trailer ending in the magic is not fooled */
+			if (offsets[0] == 0 && last < dataLen &&
+				last + ((MinimalTuple) (rows + last))->t_len == dataLen)
+			{
+				*rowsLen = dataLen;
+				return trailer.ntuples;
+			}
+		}
+	}
+
+	for (off = 0; off < len; off += ((MinimalTuple) (rows + off))->t_len)
+	{
+		if (ntuples >= TILE_MAX_TUPLES ||
+			((MinimalTuple) (rows + off))->t_len == 0)
+			elog(ERROR, "tile block is corrupted at offset %u", off);
+		offsets[ntuples++] = off;
+	}
+
+	return ntuples;
+}
+
+/*
+ * Get the byte range of the chunk of attribute attno (0-based). Returns false
+ * if the block has no data stored for it.
+ */
+bool
+tile_block_chunk(char *block, int attno, TileBlockRange *range)
+{
+	TileBlockHeader header;
+	TileChunkDesc chunk;
+
+	tile_block_read_header(block, &header);
+	if (attno >= header.natts)
+		return false;
+
+	memcpy(&chunk, block + sizeof(TileBlockHeader) + attno * sizeof(TileChunkDesc),
+		   sizeof(TileChunkDesc));
+	range->offset = chunk.offset;
+	range->length = chunk.size;
+
+	return chunk.size > 0;
+}
+
+uint32
+tile_block_ntuples(char *block)
+{
+	TileBlockHeader header;
+
+	tile_block_read_header(block, &header);
+
+	return header.ntuples;
+}
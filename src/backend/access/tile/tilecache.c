@@ -0,0 +1,380 @@
+/*
+ * tilecache.c
+ *
+ * Host-local cache of tile objects.
+ *
+ * Tile blocks are write-once: a block name is never reused for different
+ * contents, so a copy read from object storage stays valid until the object
+ * is deleted. Whole objects, block headers and single column chunks read by
+ * scans are kept as files under tile_cache_directory, and an index of them
+ * lives in shared memory so that every backend of the segment shares it.
+ * Hot files stay in the kernel page cache, which serves as the in-memory
+ * tier; keeping another copy in shared memory would only double-buffer them.
+ *
+ * Eviction is a segmented LRU. New entries start on the probation list and
+ * move to the protected list when they are read again, so one large scan
+ * can only push out entries that were never reused. The protected list is
+ * held to TILE_CACHE_PROTECTED_PERCENT of the capacity, its tail falling
+ * back to probation.
+ *
+ * Files are written under a temporary name and renamed into place while
+ * holding the lock, and removed while holding it as well. Readers open the
+ * file under the lock, so an eviction racing with them only unlinks a file
+ * they already hold open. The directory is emptied at postmaster start.
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "access/tileam.h"
+#include "common/file_perm.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/hsearch.h"
+
+int tile_cache_size = 0;
+char *tile_cache_directory = NULL;
+
+/* to size the index, the capacity is assumed to hold entries this large */
+#define TILE_CACHE_AVG_ENTRY (128 * 1024)
+#define TILE_CACHE_MIN_ENTRIES 1024
+#define TILE_CACHE_PROTECTED_PERCENT 80
+
+typedef struct TileCacheKey
+{
+	char	bucketPath[TILE_PATH_SIZE];
+	char	blockName[TILE_KEY_SIZE * 2 + 1];
+	uint32	offset;
+	uint32	length;		// 0 for the whole object
+} TileCacheKey;
+
+typedef struct TileCacheEntry
+{
+	TileCacheKey key;
+	dlist_node	node;
+	uint32		size;
+	bool		protected;
+} TileCacheEntry;
+
+typedef struct TileCacheShared
+{
+	LWLock		lock;
+	uint64		capacity;
+	uint64		used;
+	uint64		protectedUsed;
+	long		nentries;
+	long		maxEntries;
+	dlist_head	probation;	// most recently used first
+	dlist_head	protected;
+} TileCacheShared;
+
+static TileCacheShared *tileCache = NULL;
+static HTAB *tileCacheHash = NULL;
+
+static long
+tile_cache_max_entries(void)
+{
+	return Max((long) ((uint64) tile_cache_size * 1024 * 1024 / TILE_CACHE_AVG_ENTRY),
+			   TILE_CACHE_MIN_ENTRIES);
+}
+
+Size
+TileCacheShmemSize(void)
+{
+	Size		size;
+
+	if (tile_cache_size <= 0)
+		return 0;
+
+	size = MAXALIGN(sizeof(TileCacheShared));
+	size = add_size(size, hash_estimate_size(tile_cache_max_entries(),
+											 sizeof(TileCacheEntry)));
+
+	return size;
+}
+
+void
+TileCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (tile_cache_size <= 0)
+		return;
+
+	tileCache = ShmemInitStruct("Tile Cache", sizeof(TileCacheShared), &found);
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(TileCacheKey);
+	info.entrysize = sizeof(TileCacheEntry);
+	tileCacheHash = ShmemInitHash("Tile Cache Index",
+								  tile_cache_max_entries(),
+								  tile_cache_max_entries(),
+								  &info,
+								  HASH_ELEM | HASH_BLOBS);
+
+	if (found)
+		return;
+
+	LWLockInitialize(&tileCache->lock, LWTRANCHE_TILE_CACHE);
+	tileCache->capacity = (uint64) tile_cache_size * 1024 * 1024;
+	tileCache->used = 0;
+	tileCache->protectedUsed = 0;
+	tileCache->nentries = 0;
+	tileCache->maxEntries = tile_cache_max_entries();
+	dlist_init(&tileCache->probation);
+	dlist_init(&tileCache->protected);
+
+	/* files left by a previous postmaster are not in the index */
+	if (!IsUnderPostmaster)
+	{
+		struct stat st;
+
+		if (stat(tile_cache_directory, &st) == 0)
+			rmtree(tile_cache_directory, false);
+		else if (MakePGDirectory(tile_cache_directory) < 0 && errno != EEXIST)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not create tile cache directory \"%s\": %m",
+							tile_cache_directory)));
+	}
+}
+
+static void
+tile_cache_make_key(TileCacheKey *key, const char *bucketPath,
+					const char *blockName, uint32 offset, uint32 length)
+{
+	MemSet(key, 0, sizeof(TileCacheKey));
+	strlcpy(key->bucketPath, bucketPath, sizeof(key->bucketPath));
+	strlcpy(key->blockName, blockName, sizeof(key->blockName));
+	key->offset = offset;
+	key->length = length;
+}
+
+static void
+tile_cache_path(char *path, const TileCacheKey *key)
+{
+	if (key->length == 0)
+		snprintf(path, MAXPGPATH, "%s/%s_%s", tile_cache_directory,
+				 key->bucketPath, key->blockName);
+	else
+		snprintf(path, MAXPGPATH, "%s/%s_%s.%u.%u", tile_cache_directory,
+				 key->bucketPath, key->blockName, key->offset, key->length);
+}
+
+/* caller holds the lock exclusively */
+static void
+tile_cache_remove(TileCacheEntry *entry)
+{
+	char	path[MAXPGPATH];
+
+	tile_cache_path(path, &entry->key);
+	if (unlink(path) < 0 && errno != ENOENT)
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not remove tile cache file \"%s\": %m", path)));
+
+	dlist_delete(&entry->node);
+	tileCache->used -= entry->size;
+	if (entry->protected)
+		tileCache->protectedUsed -= entry->size;
+	tileCache->nentries--;
+
+	hash_search(tileCacheHash, &entry->key, HASH_REMOVE, NULL);
+}
+
+/* caller holds the lock exclusively */
+static void
+tile_cache_touch(TileCacheEntry *entry)
+{
+	dlist_delete(&entry->node);
+	dlist_push_head(&tileCache->protected, &entry->node);
+	if (!entry->protected)
+	{
+		entry->protected = true;
+		tileCache->protectedUsed += entry->size;
+	}
+
+	while (tileCache->protectedUsed >
+		   tileCache->capacity / 100 * TILE_CACHE_PROTECTED_PERCENT)
+	{
+		TileCacheEntry *demoted;
+
+		demoted = dlist_tail_element(TileCacheEntry, node, &tileCache->protected);
+		dlist_delete(&demoted->node);
+		dlist_push_head(&tileCache->probation, &demoted->node);
+		demoted->protected = false;
+		tileCache->protectedUsed -= demoted->size;
+	}
+}
+
+/*
+ * Read a cached object, or the range [offset, offset + length) of it when
+ * length is not zero, into data. Returns the number of bytes read, or -1 if
+ * it is not cached.
+ */
+int32
+tile_cache_read(const char *bucketPath, const char *blockName, uint32 offset,
+				uint32 length, char *data)
+{
+	TileCacheKey key;
+	TileCacheEntry *entry;
+	char	path[MAXPGPATH];
+	int		fd = -1;
+	uint32	size = 0;
+	ssize_t	nread;
+
+	if (tileCache == NULL)
+		return -1;
+
+	tile_cache_make_key(&key, bucketPath, blockName, offset, length);
+
+	LWLockAcquire(&tileCache->lock, LW_EXCLUSIVE);
+	entry = hash_search(tileCacheHash, &key, HASH_FIND, NULL);
+	if (entry)
+	{
+		tile_cache_path(path, &entry->key);
+		fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+		if (fd >= 0)
+		{
+			size = entry->size;
+			tile_cache_touch(entry);
+		}
+		else
+			tile_cache_remove(entry);
+	}
+	LWLockRelease(&tileCache->lock);
+
+	if (fd < 0)
+		return -1;
+
+	nread = read(fd, data, size);
+	CloseTransientFile(fd);
+
+	if (nread != size)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not read tile cache file \"%s\": %m", path)));
+		return -1;
+	}
+
+	return size;
+}
+
+/*
+ * Add an object, or the range of it starting at offset when length is not
+ * zero, to the cache. Failures only mean the data is not cached.
+ */
+void
+tile_cache_insert(const char *bucketPath, const char *blockName, uint32 offset,
+				  uint32 length, char *data, uint32 size)
+{
+	TileCacheKey key;
+	TileCacheEntry *entry;
+	char	path[MAXPGPATH];
+	char	tmpPath[MAXPGPATH];
+	int		fd;
+	bool	found;
+	bool	written;
+
+	if (tileCache == NULL || size == 0 || size > tileCache->capacity)
+		return;
+
+	tile_cache_make_key(&key, bucketPath, blockName, offset, length);
+
+	LWLockAcquire(&tileCache->lock, LW_SHARED);
+	found = hash_search(tileCacheHash, &key, HASH_FIND, NULL) != NULL;
+	LWLockRelease(&tileCache->lock);
+	if (found)
+		return;
+
+	tile_cache_path(path, &key);
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp.%d", path, MyProcPid);
+
+	fd = OpenTransientFile(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fd < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not create tile cache file \"%s\": %m", tmpPath)));
+		return;
+	}
+	written = write(fd, data, size) == size;
+	if (!written)
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write tile cache file \"%s\": %m", tmpPath)));
+	CloseTransientFile(fd);
+
+	LWLockAcquire(&tileCache->lock, LW_EXCLUSIVE);
+
+	entry = written ? hash_search(tileCacheHash, &key, HASH_FIND, NULL) : NULL;
+	if (!written || entry)
+	{
+		LWLockRelease(&tileCache->lock);
+		unlink(tmpPath);
+		return;
+	}
+
+	/* make room, probation entries go first */
+	while (tileCache->used + size > tileCache->capacity ||
+		   tileCache->nentries >= tileCache->maxEntries)
+	{
+		dlist_head *list = dlist_is_empty(&tileCache->probation) ?
+						   &tileCache->protected : &tileCache->probation;
+
+		if (dlist_is_empty(list))
+			break;
+		tile_cache_remove(dlist_tail_element(TileCacheEntry, node, list));
+	}
+
+	if (rename(tmpPath, path) < 0)
+	{
+		LWLockRelease(&tileCache->lock);
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename tile cache file \"%s\": %m", tmpPath)));
+		unlink(tmpPath);
+		return;
+	}
+
+	entry = hash_search(tileCacheHash, &key, HASH_ENTER, &found);
+	Assert(!found);
+	entry->size = size;
+	entry->protected = false;
+	dlist_push_head(&tileCache->probation, &entry->node);
+	tileCache->used += size;
+	tileCache->nentries++;
+
+	LWLockRelease(&tileCache->lock);
+}
+
+/*
+ * Forget every cached object whose bucket path starts with prefix, once
+ * the objects themselves are deleted.
+ */
+void
+tile_cache_drop(const char *prefix)
+{
+	HASH_SEQ_STATUS status;
+	TileCacheEntry *entry;
+	size_t	len = strlen(prefix);
+
+	if (tileCache == NULL)
+		return;
+
+	LWLockAcquire(&tileCache->lock, LW_EXCLUSIVE);
+	hash_seq_init(&status, tileCacheHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+	{
+		if (strncmp(entry->key.bucketPath, prefix, len) == 0)
+			tile_cache_remove(entry);
+	}
+	LWLockRelease(&tileCache->lock);
+}
@@ -1,5 +1,6 @@
 #include "postgres.h"
 
+#include "access/htup_details.h"
 #include "access/tileam.h"
 
 bool
@@ -50,8 +51,14 @@ tile_tid_get_blockid(ItemPointerData tid)
 	return blockid;
 };
 
+/*
+ * A tile TID holds the block id, which is derived from the TID of the block's
+ * visibility tuple, in its upper 28 bits and the tuple's sequence number in
+ * the block in the lower 20. Block id 0 stands for the block this backend is
+ * still filling. The block key is found through the visibility relation.
+ */
 ItemPointerData
-blockid_seq_get_tile_tid(uint32 blockid, uint32 seq, TileKey key)
+blockid_seq_get_tile_tid(uint32 blockid, uint32 seq)
 {
 	ItemPointerData tid;
 
@@ -61,20 +68,28 @@ blockid_seq_get_tile_tid(uint32 blockid, uint32 seq, TileKey key)
 
 	tid.ip_posid = seq & 0x0000ffff;
 
-	tid.xid = key.tid;
-	tid.seq = key.seq;
-
 	return tid;
 }
 
+/*
+ * A block id packs the page and line pointer offset of a visibility tuple
+ * into 28 bits. The offset gets enough bits for a full page of tuples, so
+ * no two visibility tuples share a block id; the pages left cap the size of
+ * the visibility relation.
+ */
+#define TILE_BLOCKID_OFFSET_BITS 11
+#define TILE_BLOCKID_PAGE_BITS (28 - TILE_BLOCKID_OFFSET_BITS)
+
 ItemPointerData
 blockid_to_heaptid(uint32 blockid)
 {
 	ItemPointerData tid;
 
-	tid.ip_posid = blockid & 0x000000ff;
-	tid.ip_blkid.bi_lo = blockid & 0x00ffff00;
-	tid.ip_blkid.bi_hi = blockid & 0xff000000;
+	StaticAssertStmt(MaxHeapTuplesPerPage < (1 << TILE_BLOCKID_OFFSET_BITS),
+					 "tile block ids cannot hold every line pointer offset");
+
+	ItemPointerSet(&tid, blockid >> TILE_BLOCKID_OFFSET_BITS,
+				   blockid & ((1 << TILE_BLOCKID_OFFSET_BITS) - 1));
 
 	return tid;
 }
@@ -82,15 +97,15 @@ blockid_to_heaptid(uint32 blockid)
 uint32
 heaptid_to_blockid(ItemPointerData tid)
 {
-	uint32 blockid;
+	BlockNumber page = ItemPointerGetBlockNumberNoCheck(&tid);
+	OffsetNumber offset = ItemPointerGetOffsetNumberNoCheck(&tid);
 
-	blockid = tid.ip_blkid.bi_hi & 0x000f;
-	blockid = blockid << 16;
-	blockid += tid.ip_blkid.bi_lo;
-	blockid = blockid << 8;
-	blockid += tid.ip_posid;
+	if (page >= (1 << TILE_BLOCKID_PAGE_BITS) ||
+		offset >= (1 << TILE_BLOCKID_OFFSET_BITS))
+		elog(ERROR, "visibility tuple (%u,%u) is out of range for a tile block id",
+			 page, offset);
 
-	return blockid;
+	return (page << TILE_BLOCKID_OFFSET_BITS) | offset;
 }
 
 static char *
@@ -0,0 +1,471 @@
+/*
+ * tilezonemap.c
+ *
+ * Zone maps of tile blocks.
+ *
+ * When set_page() flushes a block, the number of NULLs and the smallest and
+ * largest value of every attribute are recorded in the zonemap column of the
+ * block's visibility tuple. Before a scan fetches a block, the simple clauses
+ * of its qual are checked against these summaries, and blocks that cannot
+ * contain a matching row are left out. On a cluster this happens on the
+ * catalog server, so skipped blocks are not even shipped to the segments.
+ *
+ * The zone map is a bytea laid out as
+ *
+ *		TileZoneMapHeader
+ *		TileZoneMapAttr[natts]
+ *		min and max of attribute 1, min and max of attribute 2, ...
+ *
+ * Bounds are only kept for types with a default btree opclass and for values
+ * that are not too wide. To keep the visibility tuple small, attributes past
+ * a size budget are not summarized at all.
+ */
+#include "postgres.h"
+
+#include "access/nbtree.h"
+#include "access/stratnum.h"
+#include "access/tileam.h"
+#include "access/tupmacs.h"
+#include "fmgr.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
+
+/* largest min or max value kept for an attribute */
+#define TILE_ZONEMAP_MAX_DATUM 64
+/* budget for the whole zone map, well below the toast threshold */
+#define TILE_ZONEMAP_MAX_SIZE 1536
+
+typedef struct TileZoneMapHeader
+{
+	int32	vl_len_;
+	uint16	natts;		// attributes summarized
+	uint16	pad;
+	uint32	ntuples;
+} TileZoneMapHeader;
+
+typedef struct TileZoneMapAttr
+{
+	uint32	nullcount;
+	uint16	minLen;		// 0 when the attribute has no bounds
+	uint16	maxLen;
+} TileZoneMapAttr;
+
+/*
+ * One clause of a scan qual that can be checked against a zone map: either
+ * "attr op const" with op in the default btree opfamily of the attribute's
+ * type, or a NULL test on the attribute.
+ */
+typedef struct TileZoneKey
+{
+	AttrNumber	attno;
+	int16		attlen;
+	bool		attbyval;
+	bool		isNullTest;
+	NullTestType nullTestType;
+	StrategyNumber strategy;
+	Datum		value;
+	Oid			collation;
+	FmgrInfo	cmp;		// orders attribute values against value
+} TileZoneKey;
+
+static Size
+tile_zonemap_datum_size(Form_pg_attribute att, Datum value)
+{
+	if (att->attbyval)
+		return att->attlen;
+
+	return att_addlength_datum(0, att->attlen, value);
+}
+
+/*
+ * Summarize one block, given its tuples deformed into values/isnull with
+ * tupdesc->natts entries per tuple.
+ */
+bytea *
+tile_zonemap_build(TupleDesc tupdesc, Datum *values, bool *isnull,
+				   uint32 ntuples)
+{
+	int			natts = tupdesc->natts;
+	TileZoneMapHeader header;
+	TileZoneMapAttr *attrs;
+	StringInfoData data;
+	Size		size;
+	int			attno;
+	bytea	   *result;
+
+	attrs = palloc0(sizeof(TileZoneMapAttr) * natts);
+	initStringInfo(&data);
+
+	for (attno = 0; attno < natts; attno++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+		TypeCacheEntry *typentry = NULL;
+		Datum		min = (Datum) 0;
+		Datum		max = (Datum) 0;
+		bool		found = false;
+		int			prevLen = data.len;
+		uint32		i;
+
+		if (!att->attisdropped)
+		{
+			typentry = lookup_type_cache(att->atttypid, TYPECACHE_CMP_PROC_FINFO);
+			if (!OidIsValid(typentry->cmp_proc))
+				typentry = NULL;
+		}
+
+		for (i = 0; i < ntuples; i++)
+		{
+			Datum	value = values[i * natts + attno];
+
+			if (isnull[i * natts + attno])
+			{
+				attrs[attno].nullcount++;
+				continue;
+			}
+
+			if (typentry == NULL)
+				continue;
+
+			if (!found)
+			{
+				min = max = value;
+				found = true;
+			}
+			else if (DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo,
+													 att->attcollation,
+													 value, min)) < 0)
+				min = value;
+			else if (DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo,
+													 att->attcollation,
+													 value, max)) > 0)
+				max = value;
+		}
+
+		if (found)
+		{
+			Datum	bounds[2];
+			Size	lens[2];
+			int		j;
+
+			/* varlenas are kept uncompressed, so they can be compared as-is */
+			bounds[0] = min;
+			bounds[1] = max;
+			for (j = 0; j < 2 && att->attlen == -1; j++)
+				bounds[j] = PointerGetDatum(PG_DETOAST_DATUM_PACKED(bounds[j]));
+
+			lens[0] = tile_zonemap_datum_size(att, bounds[0]);
+			lens[1] = tile_zonemap_datum_size(att, bounds[1]);
+
+			if (lens[0] <= TILE_ZONEMAP_MAX_DATUM &&
+				lens[1] <= TILE_ZONEMAP_MAX_DATUM)
+			{
+				for (j = 0; j < 2; j++)
+				{
+					enlargeStringInfo(&data, lens[j]);
+					if (att->attbyval)
+						store_att_byval(data.data + data.len, bounds[j], att->attlen);
+					else
+						memcpy(data.data + data.len, DatumGetPointer(bounds[j]), lens[j]);
+					data.len += lens[j];
+				}
+				attrs[attno].minLen = lens[0];
+				attrs[attno].maxLen = lens[1];
+			}
+		}
+
+		size = sizeof(TileZoneMapHeader) + sizeof(TileZoneMapAttr) * (attno + 1) +
+			   data.len;
+		if (size > TILE_ZONEMAP_MAX_SIZE)
+		{
+			data.len = prevLen;
+			break;
+		}
+	}
+
+	header.natts = attno;
+	header.pad = 0;
+	header.ntuples = ntuples;
+
+	size = sizeof(TileZoneMapHeader) + sizeof(TileZoneMapAttr) * header.natts +
+		   data.len;
+	result = palloc(size);
+	SET_VARSIZE(&header, size);
+	memcpy(result, &header, sizeof(TileZoneMapHeader));
+	memcpy((char *) result + sizeof(TileZoneMapHeader), attrs,
+		   sizeof(TileZoneMapAttr) * header.natts);
+	memcpy((char *) result + sizeof(TileZoneMapHeader) +
+		   sizeof(TileZoneMapAttr) * header.natts, data.data, data.len);
+
+	pfree(attrs);
+	pfree(data.data);
+
+	return result;
+}
+
+static Node *
+tile_zonemap_strip(Node *node)
+{
+	while (node && IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+
+	return node;
+}
+
+static bool
+tile_zonemap_is_attr(Node *node, TupleDesc tupdesc)
+{
+	Var		   *var;
+
+	if (node == NULL || !IsA(node, Var))
+		return false;
+
+	var = (Var *) node;
+
+	return var->varlevelsup == 0 && !IS_SPECIAL_VARNO(var->varno) &&
+		   var->varattno > 0 && var->varattno <= tupdesc->natts &&
+		   !TupleDescAttr(tupdesc, var->varattno - 1)->attisdropped;
+}
+
+static void
+tile_zonemap_add_keys(TupleDesc tupdesc, Node *clause, List **keys)
+{
+	TileZoneKey *key;
+
+	if (clause == NULL)
+		return;
+
+	if (IsA(clause, List))
+	{
+		ListCell   *lc;
+
+		foreach(lc, (List *) clause)
+			tile_zonemap_add_keys(tupdesc, lfirst(lc), keys);
+	}
+	else if (is_andclause(clause))
+	{
+		tile_zonemap_add_keys(tupdesc, (Node *) ((BoolExpr *) clause)->args, keys);
+	}
+	else if (IsA(clause, NullTest))
+	{
+		NullTest   *ntest = (NullTest *) clause;
+		Var		   *var = (Var *) tile_zonemap_strip((Node *) ntest->arg);
+		Form_pg_attribute att;
+
+		if (ntest->argisrow || !tile_zonemap_is_attr((Node *) var, tupdesc))
+			return;
+
+		att = TupleDescAttr(tupdesc, var->varattno - 1);
+		key = palloc0(sizeof(TileZoneKey));
+		key->attno = var->varattno;
+		key->attlen = att->attlen;
+		key->attbyval = att->attbyval;
+		key->isNullTest = true;
+		key->nullTestType = ntest->nulltesttype;
+		*keys = lappend(*keys, key);
+	}
+	else if (IsA(clause, OpExpr) && list_length(((OpExpr *) clause)->args) == 2)
+	{
+		OpExpr	   *opexpr = (OpExpr *) clause;
+		Node	   *left = tile_zonemap_strip(linitial(opexpr->args));
+		Node	   *right = tile_zonemap_strip(lsecond(opexpr->args));
+		Oid			opno = opexpr->opno;
+		Var		   *var;
+		Const	   *con;
+		Form_pg_attribute att;
+		TypeCacheEntry *typentry;
+		int			strategy;
+		Oid			lefttype;
+		Oid			righttype;
+		Oid			cmpproc;
+
+		if (tile_zonemap_is_attr(left, tupdesc) && right && IsA(right, Const))
+		{
+			var = (Var *) left;
+			con = (Const *) right;
+		}
+		else if (tile_zonemap_is_attr(right, tupdesc) && left && IsA(left, Const))
+		{
+			var = (Var *) right;
+			con = (Const *) left;
+			opno = get_commutator(opno);
+			if (!OidIsValid(opno))
+				return;
+		}
+		else
+			return;
+
+		if (con->constisnull)
+			return;
+
+		att = TupleDescAttr(tupdesc, var->varattno - 1);
+
+		/* bounds were computed with the attribute's collation */
+		if (opexpr->inputcollid != att->attcollation)
+			return;
+
+		typentry = lookup_type_cache(att->atttypid, TYPECACHE_BTREE_OPFAMILY);
+		if (!OidIsValid(typentry->btree_opf) ||
+			!op_in_opfamily(opno, typentry->btree_opf))
+			return;
+
+		get_op_opfamily_properties(opno, typentry->btree_opf, false,
+								   &strategy, &lefttype, &righttype);
+		cmpproc = get_opfamily_proc(typentry->btree_opf, lefttype, righttype,
+									BTORDER_PROC);
+		if (!OidIsValid(cmpproc))
+			return;
+
+		key = palloc0(sizeof(TileZoneKey));
+		key->attno = var->varattno;
+		key->attlen = att->attlen;
+		key->attbyval = att->attbyval;
+		key->strategy = strategy;
+		key->value = con->constvalue;
+		key->collation = opexpr->inputcollid;
+		fmgr_info(cmpproc, &key->cmp);
+		*keys = lappend(*keys, key);
+	}
+}
+
+/*
+ * Extract the clauses of qual that zone maps of rel's blocks can refute.
+ * Returns NIL if there are none.
+ */
+List *
+tile_zonemap_keys(Relation rel, List *qual)
+{
+	List	   *keys = NIL;
+
+	tile_zonemap_add_keys(RelationGetDescr(rel), (Node *) qual, &keys);
+
+	return keys;
+}
+
+static Datum
+tile_zonemap_fetch(TileZoneKey *key, char *ptr, uint16 len)
+{
+	char	   *copy;
+
+	/* copy to get the alignment fetch_att() expects */
+	copy = palloc(Max(len, sizeof(Datum)));
+	memcpy(copy, ptr, len);
+
+	if (key->attbyval)
+	{
+		Datum	value = fetch_att(copy, true, key->attlen);
+
+		pfree(copy);
+		return value;
+	}
+
+	return PointerGetDatum(copy);
+}
+
+/*
+ * Can the block summarized by zonemap be skipped? True if some key proves
+ * that no row of the block satisfies the qual the keys came from.
+ */
+bool
+tile_zonemap_skip(bytea *zonemap, List *keys)
+{
+	TileZoneMapHeader header;
+	TileZoneMapAttr *attrs;
+	uint32	   *offsets;
+	char	   *data;
+	ListCell   *lc;
+	bool		skip = false;
+	int			i;
+
+	if (zonemap == NULL || keys == NIL)
+		return false;
+
+	zonemap = pg_detoast_datum(zonemap);
+	memcpy(&header, zonemap, sizeof(TileZoneMapHeader));
+
+	attrs = palloc(sizeof(TileZoneMapAttr) * header.natts);
+	memcpy(attrs, (char *) zonemap + sizeof(TileZoneMapHeader),
+		   sizeof(TileZoneMapAttr) * header.natts);
+	data = (char *) zonemap + sizeof(TileZoneMapHeader) +
+		   sizeof(TileZoneMapAttr) * header.natts;
+
+	offsets = palloc(sizeof(uint32) * (header.natts + 1));
+	offsets[0] = 0;
+	for (i = 0; i < header.natts; i++)
+		offsets[i + 1] = offsets[i] + attrs[i].minLen + attrs[i].maxLen;
+
+	foreach(lc, keys)
+	{
+		TileZoneKey *key = lfirst(lc);
+		TileZoneMapAttr *attr;
+		Datum		min;
+		Datum		max;
+		int32		cmpMin;
+		int32		cmpMax;
+
+		/* attributes added after the block was written are not summarized */
+		if (key->attno > header.natts)
+			continue;
+
+		attr = &attrs[key->attno - 1];
+
+		if (key->isNullTest)
+		{
+			if (key->nullTestType == IS_NULL)
+				skip = attr->nullcount == 0;
+			else
+				skip = attr->nullcount == header.ntuples;
+		}
+		else if (attr->nullcount == header.ntuples)
+		{
+			/* btree operators are strict */
+			skip = true;
+		}
+		else if (attr->minLen > 0)
+		{
+			min = tile_zonemap_fetch(key, data + offsets[key->attno - 1],
+									 attr->minLen);
+			max = tile_zonemap_fetch(key, data + offsets[key->attno - 1] +
+									 attr->minLen, attr->maxLen);
+			cmpMin = DatumGetInt32(FunctionCall2Coll(&key->cmp, key->collation,
+													 min, key->value));
+			cmpMax = DatumGetInt32(FunctionCall2Coll(&key->cmp, key->collation,
+													 max, key->value));
+
+			switch (key->strategy)
+			{
+				case BTLessStrategyNumber:
+					skip = cmpMin >= 0;
+					break;
+				case BTLessEqualStrategyNumber:
+					skip = cmpMin > 0;
+					break;
+				case BTEqualStrategyNumber:
+					skip = cmpMin > 0 || cmpMax < 0;
+					break;
+				case BTGreaterEqualStrategyNumber:
+					skip = cmpMax < 0;
+					break;
+				case BTGreaterStrategyNumber:
+					skip = cmpMax <= 0;
+					break;
+				default:
+					break;
+			}
+
+			if (!key->attbyval)
+			{
+				pfree(DatumGetPointer(min));
+				pfree(DatumGetPointer(max));
+			}
+		}
+
+		if (skip)
+			break;
+	}
+
+	pfree(attrs);
+	pfree(offsets);
+
+	return skip;
+}
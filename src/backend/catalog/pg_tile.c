@@ -22,11 +22,12 @@ CreateTileVisiTable(Relation main_rel)
 	ObjectAddress dstObj;
 	Oid			relNameSpace;
 
-	tupdesc = CreateTemplateTupleDesc(3);
+	tupdesc = CreateTemplateTupleDesc(4);
 
 	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "filesize", INT4OID, -1, 0);
 	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "filepath", NAMEOID, -1, 0);
 	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "tupnum", INT4OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "zonemap", BYTEAOID, -1, 0);
 
 	snprintf(visiRelName, sizeof(visiRelName),
 			 "%s_%u", "visi", RelationGetRelid(main_rel));
@@ -109,6 +110,42 @@ PgTileGetVisiRelId(Oid mainRelId)
 	return visiRelId;
 }
 
+/*
+ * Find the tile table a visibility relation belongs to. Returns InvalidOid
+ * if visiRelId is not one.
+ */
+Oid
+PgTileGetMainRelId(Oid visiRelId)
+{
+	Relation	pgTile;
+	ScanKeyData scanKeys[1];
+	SysScanDesc sysScan;
+	HeapTuple	tup;
+	bool is_null;
+	Oid mainRelId = InvalidOid;
+
+	pgTile = table_open(TileRelationId, AccessShareLock);
+
+	ScanKeyInit(&scanKeys[0],
+				Anum_pg_tile_visirelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(visiRelId));
+
+	sysScan = systable_beginscan(pgTile, InvalidOid, false, NULL, 1, scanKeys);
+	tup = systable_getnext(sysScan);
+	if (HeapTupleIsValid(tup))
+	{
+		mainRelId = DatumGetObjectId(heap_getattr(tup, Anum_pg_tile_mainrelid,
+												  RelationGetDescr(pgTile), &is_null));
+		Assert(!is_null);
+	}
+
+	systable_endscan(sysScan);
+	table_close(pgTile, AccessShareLock);
+
+	return mainRelId;
+}
+
 void
 PgTileInsert(Oid mainRelid, Oid visiRelid)
 {
@@ -4,24 +4,31 @@
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/memoryheapam.h"
+#include "catalog/namespace.h"
 #include "catalog/pg_database.h"
 #include "cdb/cdbcatalogfunc.h"
 #include "cdb/cdbsrlz.h"
 #include "commands/copy.h"
 #include "commands/explain.h"
 #include "commands/sequence.h"
+#include "common/hashfn.h"
 #include "funcapi.h"
+#include "lib/ilist.h"
 #include "libpq-fe.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
 #include "libpq-int.h"
 #include "rewrite/rewriteHandler.h"
+#include "tcop/pquery.h"
 #include "tcop/tcopprot.h"
 #include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/dispatchcat.h"
+#include "utils/guc.h"
 #include "utils/inval.h"
+#include "utils/memutils.h"
 #include "utils/pickcat.h"
+#include "utils/plancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -52,12 +59,62 @@ typedef struct CcPrintUp
 	StringInfoData	buf;
 } CcPrintUp;
 
+/*
+ * Plans of the statements compute clusters send, kept by the catalog server
+ * together with the catalog tuples collected while analyzing and planning
+ * them, so that a repeated statement is neither parsed nor planned again.
+ * An entry is only used while no invalidation has been seen and no setting
+ * has changed since it was planned, which also makes the collected tuples
+ * safe to send again.
+ */
+typedef struct CsPlanCacheEntry
+{
+	uint32		hash;			/* of the key below, the hash table key */
+	char	   *query_string;
+	Oid			userid;
+	char	   *search_path;
+	CachedPlanSource *plansource;
+	uint64		invalCounter;	/* LocalInvalidationCounter when planned */
+	uint64		gucCounter;		/* GUCChangeCounter when planned */
+	char	   *catalogData;
+	int			catalogDataSize;
+	dlist_node	node;			/* most recently used first */
+} CsPlanCacheEntry;
+
 bool accessHeap = false;
 bool accessTile = false;
 PGconn	*csConn = NULL;
 bool errorFromCatalogServer = false;
 char *cs_port;
 char *cs_host_name;
+int catalog_plan_cache_size = 256;
+bool catalog_server_early_commit = false;
+
+/*
+ * State of the catalog server transaction that mirrors ours. It is started
+ * by the first message we send, and a read-only implicit transaction is
+ * committed by the catalog server together with its reply, so that a simple
+ * query costs a single round trip.
+ */
+typedef enum CcXactState
+{
+	CC_XACT_NONE,
+	CC_XACT_PENDING,			/* to be started by the next message */
+	CC_XACT_OPEN
+} CcXactState;
+
+static CcXactState ccXactState = CC_XACT_NONE;
+
+static MemoryContext csPlanCacheContext = NULL;
+static HTAB *csPlanCache = NULL;
+static dlist_head csPlanCacheLru = DLIST_STATIC_INIT(csPlanCacheLru);
+
+/* the statement being planned, or the cached one being run */
+static CachedPlanSource *csPendingSource = NULL;
+static uint64 csPendingInvalCounter = 0;
+static uint64 csPendingGucCounter = 0;
+static CsPlanCacheEntry *csCachedEntry = NULL;
+static CachedPlan *csCachedPlan = NULL;
 
 static bytea *cstring_to_bytea(char *inputText);
 static CcPrintUp *cc_printup_create_DR(PGresAttDesc *attDescs, int nattr,
@@ -66,6 +123,7 @@ static void cc_printtup_startup(CcPrintUp *myState);
 static bool cc_printtup(char **strs, CcPrintUp *myState);
 static void cc_preintup_shutdown(CcPrintUp *myState);
 static void cc_printup_destroy(CcPrintUp *myState);
+static void cs_plan_cache_save(const char *sql);
 
 static void
 SetConnOptions(CatConnectOptions *options)
@@ -227,11 +285,39 @@ cc_get_returning(PGresult *res)
 	Assert(nfields == 1);
 
 	str = PQgetvalue(res, 0, 0);
-	value = cstring_to_bytea(str);
+	if (PQfformat(res, 0) == 1)
+	{
+		int			len = PQgetlength(res, 0, 0);
+
+		value = palloc(len + VARHDRSZ);
+		memcpy(VARDATA(value), str, len);
+		SET_VARSIZE(value, len + VARHDRSZ);
+	}
+	else
+		value = cstring_to_bytea(str);
 
 	return value;
 }
 
+/*
+ * Deserialize the node carried by a catalog server reply. Replies come in
+ * binary, so the received bytes are the serialized node itself.
+ */
+Node *
+cc_get_returning_node(PGresult *res)
+{
+	bytea	   *value;
+
+	Assert(PQntuples(res) == 1);
+	Assert(PQnfields(res) == 1);
+
+	if (PQfformat(res, 0) == 1)
+		return deserializeNode(PQgetvalue(res, 0, 0), PQgetlength(res, 0, 0));
+
+	value = cc_get_returning(res);
+	return deserializeNode(VARDATA(value), VARSIZE(value) - VARHDRSZ);
+}
+
 void
 cc_pass_returning(PGresult *res)
 {
@@ -272,6 +358,20 @@ cc_pass_returning(PGresult *res)
 		pq_putmessage('C', PQcmdStatus(res), strlen(PQcmdStatus(res)) + 1);
 }
 
+/*
+ * Have the catalog server start its transaction with this message, if it is
+ * the first one of ours.
+ */
+static void
+cc_xact_attach(CsQuery *csQuery)
+{
+	if (ccXactState == CC_XACT_PENDING)
+	{
+		csQuery->xact_start = true;
+		ccXactState = CC_XACT_OPEN;
+	}
+}
+
 PGresult *
 cc_exec_plan(CsQuery *csQuery)
 {
@@ -279,6 +379,7 @@ cc_exec_plan(CsQuery *csQuery)
 	char	   *csQueryBuf;
 	int			csQeuryBufSize;
 
+	cc_xact_attach(csQuery);
 	csQueryBuf = serializeNode((Node *) csQuery, &csQeuryBufSize, NULL);
 	res = PQexecPlan(csConn, csQueryBuf, csQeuryBufSize);
 	if (!res || PQresultStatus(res) > 2)
@@ -307,13 +408,14 @@ cc_catalog_or_run(const char *sql)
 
 	PGresult   *res;
 	char *cmdStatus;
-	bytea *value;
 	CdbCatalogAuxNode *catAuxNode;
 
 	csQuery = makeNode(CsQuery);
 	csQuery->cmdType = CS_QUERY;
 	csQuery->query_string = (char *) sql;
 	csQuery->segment_count = getgpsegmentCount();
+	csQuery->catalog_version = MemoryHeapGetCatalogVersion();
+	csQuery->data = (Node *) sequence_lease_report();
 
 	res = cc_exec_plan(csQuery);
 	cmdStatus = cc_status(res);
@@ -322,13 +424,25 @@ cc_catalog_or_run(const char *sql)
 	{
 		MemoryContext oldCtx;
 
-		value = cc_get_returning(res);
-
 		InvalidateSystemCaches();
 		ClearMemoryHeapStorage();
 
 		oldCtx = MemoryContextSwitchTo(memoryHeapContext);
-		catAuxNode = (CdbCatalogAuxNode *) deserializeNode(VARDATA(value), VARSIZE(value));
+		catAuxNode = (CdbCatalogAuxNode *) cc_get_returning_node(res);
+		MemoryContextSwitchTo(oldCtx);
+
+		cdbcomponent_assignCdbComponents();
+	}
+	else if (strcmp(cmdStatus, "CatalogDelta") == 0)
+	{
+		MemoryContext oldCtx;
+
+		/*
+		 * Only the catalog tuples we do not hold yet were sent, they are
+		 * merged into the memory heap by MemoryHeapDataSetCat.
+		 */
+		oldCtx = MemoryContextSwitchTo(MemoryHeapDeltaContext());
+		catAuxNode = (CdbCatalogAuxNode *) cc_get_returning_node(res);
 		MemoryContextSwitchTo(oldCtx);
 
 		cdbcomponent_assignCdbComponents();
@@ -343,9 +457,15 @@ cc_catalog_or_run(const char *sql)
 	{
 		cc_pass_returning(res);
 
+		/* it ran on the catalog server, and may have moved sequences */
+		sequence_lease_drop();
 		catAuxNode = NULL;
 	}
 
+	/* anything we send from now on starts a new one */
+	if (catAuxNode && catAuxNode->xact_finished)
+		ccXactState = CC_XACT_PENDING;
+
 	return catAuxNode;
 }
 
@@ -375,7 +495,6 @@ cc_get_catalog(const char *sql, MemoryContext ctx)
 {
 	CsQuery *csQuery;
 	PGresult   *res;
-	bytea *value;
 	CdbCatalogAuxNode *catAuxNode;
 	MemoryContext oldCtx;
 	PGconn *conn = csConn;
@@ -396,6 +515,9 @@ cc_get_catalog(const char *sql, MemoryContext ctx)
 		csQuery->cluster_id = myClusterId;
 	}
 
+	if (sql)
+		cc_xact_attach(csQuery);
+
 	csQueryBuf = serializeNode((Node *) csQuery, &csQueryLen, NULL);
 
 	/* make the call */
@@ -414,8 +536,7 @@ cc_get_catalog(const char *sql, MemoryContext ctx)
 
 	oldCtx = MemoryContextSwitchTo(ctx);
 
-	value = cc_get_returning(res);
-	catAuxNode = (CdbCatalogAuxNode *) deserializeNode(VARDATA(value), VARSIZE(value));
+	catAuxNode = (CdbCatalogAuxNode *) cc_get_returning_node(res);
 
 	MemoryContextSwitchTo(oldCtx);
 
@@ -426,7 +547,7 @@ cc_get_catalog(const char *sql, MemoryContext ctx)
 }
 
 void
-cc_send_modify_tabble(VisiNode *visiNode)
+cc_send_modify_tabble(List *visiNodes)
 {
 	CsQuery *csQuery;
 	PGresult   *res;
@@ -435,9 +556,10 @@ cc_send_modify_tabble(VisiNode *visiNode)
 
 	csQuery = makeNode(CsQuery);
 	csQuery->cmdType = CS_MODIFY_TABLE;
-	csQuery->data = (Node*) visiNode;
+	csQuery->data = (Node*) visiNodes;
 
 	/* make the call */
+	cc_xact_attach(csQuery);
 	csQueryBuf = serializeNode((Node *) csQuery, &csQueryLen, NULL);
 	res = PQexecPlan(csConn, csQueryBuf, csQueryLen);
 	/* check and deal with errors */
@@ -453,23 +575,25 @@ cc_send_modify_tabble(VisiNode *visiNode)
 }
 
 void
-cc_next_val(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement, bool *poverflow)
+cc_next_val(Oid relid, int64 nvalues, int64 *plast, int64 *pcached,
+			int64 *pincrement, bool *poverflow)
 {
 	CsQuery	   *csQuery;
 	PGresult   *res;
 	NextValNode *nextVal;
 	char		*csQueryBuf;
 	int			 csQueryLen;
-	bytea *value;
 	
 	
 	csQuery = makeNode(CsQuery);
 	csQuery->cmdType = CS_NEXT_VAL;
 	nextVal = makeNode(NextValNode);
 	nextVal->relid = relid;
+	nextVal->nvalues = nvalues;
 	
 	csQuery->data = (Node *) nextVal;
 	/* make the call */
+	cc_xact_attach(csQuery);
 	csQueryBuf = serializeNode((Node *) csQuery, &csQueryLen, NULL);
 	res = PQexecPlan(csConn, csQueryBuf, csQueryLen);
 
@@ -483,8 +607,7 @@ cc_next_val(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement, bool *p
 		ProccessErrorMessage(errMsg);
 	}
 
-	value = cc_get_returning(res);
-	nextVal = (NextValNode *) deserializeNode(VARDATA(value), VARSIZE(value));
+	nextVal = (NextValNode *) cc_get_returning_node(res);
 	
 	*plast = nextVal->plast;
 	*pcached = nextVal->pcached;
@@ -521,6 +644,36 @@ cc_xact_command(CsType csType)
 	PQclear(res);
 }
 
+/*
+ * Our transaction started; the catalog server's one is started by the next
+ * message we send it, see cc_xact_attach.
+ */
+void
+cc_xact_begin(void)
+{
+	ccXactState = CC_XACT_PENDING;
+}
+
+/*
+ * Our transaction is ending. Nothing needs to be sent when the catalog
+ * server has not started its transaction or already committed it, nor on
+ * abort when the error came from it.
+ */
+void
+cc_xact_end(bool isAbort)
+{
+	CcXactState state = ccXactState;
+
+	ccXactState = CC_XACT_NONE;
+	if (state != CC_XACT_OPEN)
+		return;
+
+	if (!isAbort)
+		cc_xact_command(CS_XACT_FINISH);
+	else if (!errorFromCatalogServer)
+		cc_xact_command(CS_XACT_ABORT);
+}
+
 bytea *
 cc_get_conf(char *file)
 {
@@ -535,6 +688,7 @@ cc_get_conf(char *file)
 	csQuery->query_string = file;
 
 	/* make the call */
+	cc_xact_attach(csQuery);
 	csQueryBuf = serializeNode((Node *) csQuery, &csQueryLen, NULL);
 	res = PQexecPlan(csConn, csQueryBuf, csQueryLen);
 	/* check and deal with errors */
@@ -579,6 +733,20 @@ GetCatalogTupleDesc(void)
 	return tupdesc;
 }
 
+/*
+ * Replies of the catalog server are a single bytea column, see
+ * DestReceiveBytea. Have it sent in binary, so that the serialized node
+ * goes out as is instead of being escaped as text.
+ */
+void
+cs_set_reply_format(Portal portal)
+{
+	int16		format = 1;
+
+	portal->tupDesc = GetCatalogTupleDesc();
+	PortalSetResultFormat(portal, 1, &format);
+}
+
 void
 DestReceiveBytea(char *data, int dataSize, DestReceiver *dest)
 {
@@ -636,9 +804,12 @@ cs_get_conf(const char *path, DestReceiver *dest)
 }
 
 void
-cs_modify_table(VisiNode *visiNode)
+cs_modify_table(List *visiNodes)
 {
-	tile_insert_visi_cs(visiNode);
+	ListCell   *cell;
+
+	foreach(cell, visiNodes)
+		tile_insert_visi_cs((VisiNode *) lfirst(cell));
 }
 
 void
@@ -647,8 +818,8 @@ cs_next_val(NextValNode *nextVal, DestReceiver *dest)
 	char *data;
 	int dataSize;
 	
-	nextval_cs(nextVal->relid, &nextVal->plast, &nextVal->pcached, &nextVal->pincrement,
-			   &nextVal->poverflow);
+	nextval_cs(nextVal->relid, nextVal->nvalues, &nextVal->plast, &nextVal->pcached,
+			   &nextVal->pincrement, &nextVal->poverflow);
 
 	data = serializeNode((Node *) nextVal, &dataSize, NULL);
 	DestReceiveBytea(data, dataSize, dest);
@@ -684,18 +855,15 @@ IsTransactionExitStmt(Node *parsetree)
 	return false;
 }
 
-PlannedStmt *
-get_catalog_from_query(List *queries, const char *sql)
+static PlannedStmt *
+get_catalog_from_plans(List *stmt_list, const char *sql)
 {
-	List	   *stmt_list;
 	ListCell   *cell;
 	PlannedStmt	   *plannedStmt = NULL;
 	DestReceiver *dest;
 
 	dest = CreateDestReceiver(DestNone);
 
-	stmt_list = pg_plan_queries(queries, CURSOR_OPT_PARALLEL_OK, NULL);
-
 	foreach(cell, stmt_list)
 	{
 		PlannedStmt *stmt = lfirst_node(PlannedStmt, cell);
@@ -799,6 +967,8 @@ get_catalog_from_query(List *queries, const char *sql)
 			}
 			else if (IsA(stmt->utilityStmt,VariableSetStmt))
 			{
+				/* settings may change how statements are planned */
+				cs_plan_cache_reset();
 				ExecSetVariableStmt((VariableSetStmt *) parsetree, true);
 			}
 		}
@@ -807,6 +977,37 @@ get_catalog_from_query(List *queries, const char *sql)
 	return plannedStmt;
 }
 
+/*
+ * Whether the transaction can be committed together with the catalog reply:
+ * a read-only statement outside a transaction block needs nothing more from
+ * us than the snapshot its catalog and visibility data were read with.
+ *
+ * Committing releases our locks and snapshot while the compute cluster is
+ * still reading the blocks the reply lists, so a concurrent DROP, TRUNCATE
+ * or VACUUM may delete them under the query. Hence this is off by default.
+ */
+static bool
+cs_xact_can_finish(PlannedStmt *plannedStmt)
+{
+	if (!catalog_server_early_commit || IsTransactionBlock())
+		return false;
+
+	return plannedStmt != NULL &&
+		   plannedStmt->commandType == CMD_SELECT &&
+		   !plannedStmt->hasModifyingCTE &&
+		   plannedStmt->rowMarks == NIL;
+}
+
+PlannedStmt *
+get_catalog_from_query(List *queries, const char *sql)
+{
+	List	   *stmt_list;
+
+	stmt_list = pg_plan_queries(queries, CURSOR_OPT_PARALLEL_OK, NULL);
+
+	return get_catalog_from_plans(stmt_list, sql);
+}
+
 CdbCatalogAuxNode *
 cs_get_catalog_from_sql(List *queryList, const char *sql, char *command)
 {
@@ -817,7 +1018,14 @@ cs_get_catalog_from_sql(List *queryList, const char *sql, char *command)
 	{
 		Gp_role = GP_ROLE_DISPATCH;
 
-		plannedStmt = get_catalog_from_query(queryList, sql);
+		if (csCachedPlan)
+		{
+			DataDispatcherAddTuples(csCachedEntry->catalogData,
+									csCachedEntry->catalogDataSize);
+			plannedStmt = get_catalog_from_plans(csCachedPlan->stmt_list, sql);
+		}
+		else
+			plannedStmt = get_catalog_from_query(queryList, sql);
 
 		/* Be sure to advance the command counter after the last script command */
 		CommandCounterIncrement();
@@ -839,7 +1047,15 @@ cs_get_catalog_from_sql(List *queryList, const char *sql, char *command)
 			catAux->plan = plannedStmt;
 			catAux->catalog = GetCatalogNode();
 			catAux->aux = GetAuxNode();
-			strcpy(command, "Catalog");
+			catAux->xact_finished = cs_xact_can_finish(plannedStmt);
+			CatalogNodeMakeDelta(catAux->catalog);
+			if (catAux->catalog->catalog_delta)
+				strcpy(command, "CatalogDelta");
+			else
+				strcpy(command, "Catalog");
+
+			if (csPendingSource && plannedStmt)
+				cs_plan_cache_save(sql);
 		}
 		else
 			strcpy(command, "Server");
@@ -850,6 +1066,212 @@ cs_get_catalog_from_sql(List *queryList, const char *sql, char *command)
 	return catAux;
 }
 
+static uint32
+cs_plan_cache_hash(const char *sql)
+{
+	uint32		hash;
+
+	hash = DatumGetUInt32(hash_any((const unsigned char *) sql, strlen(sql)));
+	hash = hash_combine(hash, DatumGetUInt32(hash_uint32(GetUserId())));
+	hash = hash_combine(hash,
+						DatumGetUInt32(hash_any((const unsigned char *) namespace_search_path,
+												strlen(namespace_search_path))));
+
+	return hash;
+}
+
+static void
+cs_plan_cache_remove(CsPlanCacheEntry *entry)
+{
+	dlist_delete(&entry->node);
+	DropCachedPlan(entry->plansource);
+	pfree(entry->query_string);
+	pfree(entry->search_path);
+	pfree(entry->catalogData);
+
+	hash_search(csPlanCache, &entry->hash, HASH_REMOVE, NULL);
+}
+
+void
+cs_plan_cache_reset(void)
+{
+	while (!dlist_is_empty(&csPlanCacheLru))
+		cs_plan_cache_remove(dlist_head_element(CsPlanCacheEntry, node,
+												&csPlanCacheLru));
+}
+
+/*
+ * Find the cached plan of a statement, and take the locks it needs. Returns
+ * false when the statement has to be planned, see cs_plan_cache_begin.
+ */
+bool
+cs_plan_cache_lookup(const char *sql)
+{
+	CsPlanCacheEntry *entry;
+	CachedPlan *cplan;
+	uint32		hash;
+
+	csPendingSource = NULL;
+	csCachedEntry = NULL;
+	csCachedPlan = NULL;
+
+	if (csPlanCache == NULL || catalog_plan_cache_size <= 0)
+		return false;
+
+	hash = cs_plan_cache_hash(sql);
+	entry = hash_search(csPlanCache, &hash, HASH_FIND, NULL);
+	if (entry == NULL ||
+		entry->userid != GetUserId() ||
+		strcmp(entry->query_string, sql) != 0 ||
+		strcmp(entry->search_path, namespace_search_path) != 0)
+		return false;
+
+	/*
+	 * A setting the plan depended on may have been changed, or restored by
+	 * the end of the transaction that SET LOCAL or set_config() it.
+	 */
+	if (entry->gucCounter != GUCChangeCounter)
+	{
+		cs_plan_cache_remove(entry);
+		return false;
+	}
+
+	/* as in cs_get_query_list, cached statements never end a transaction */
+	if (IsAbortedTransactionBlockState())
+		ereport(ERROR,
+				(errcode(ERRCODE_IN_FAILED_SQL_TRANSACTION),
+				 errmsg("current transaction is aborted, "
+						"commands ignored until end of transaction block")));
+
+	AcceptInvalidationMessages();
+	if (entry->invalCounter != LocalInvalidationCounter)
+	{
+		cs_plan_cache_remove(entry);
+		return false;
+	}
+
+	cplan = GetCachedPlan(entry->plansource, NULL, true, NULL, NULL);
+
+	/* taking the locks may have let invalidations in */
+	if (entry->invalCounter != LocalInvalidationCounter)
+	{
+		ReleaseCachedPlan(cplan, true);
+		cs_plan_cache_remove(entry);
+		return false;
+	}
+
+	dlist_move_head(&csPlanCacheLru, &entry->node);
+	csCachedEntry = entry;
+	csCachedPlan = cplan;
+
+	return true;
+}
+
+/*
+ * Start a plan cache entry for a statement about to be analyzed. It is only
+ * kept if its catalog is sent to the compute cluster, see
+ * cs_plan_cache_save.
+ */
+void
+cs_plan_cache_begin(RawStmt *parsetree, const char *sql)
+{
+	Node	   *stmt = parsetree->stmt;
+
+	if (catalog_plan_cache_size <= 0)
+		return;
+
+	if (!IsA(stmt, SelectStmt) && !IsA(stmt, InsertStmt) &&
+		!IsA(stmt, UpdateStmt) && !IsA(stmt, DeleteStmt))
+		return;
+
+	csPendingInvalCounter = LocalInvalidationCounter;
+	csPendingGucCounter = GUCChangeCounter;
+	csPendingSource = CreateCachedPlan(parsetree, sql, CreateCommandTag(stmt));
+}
+
+void
+cs_plan_cache_complete(List *queries)
+{
+	if (csPendingSource == NULL)
+		return;
+
+	if (list_length(queries) != 1)
+	{
+		csPendingSource = NULL;
+		return;
+	}
+
+	CompleteCachedPlan(csPendingSource, queries, NULL, T_Query, NULL, 0,
+					   NULL, NULL, CURSOR_OPT_PARALLEL_OK, true);
+}
+
+static void
+cs_plan_cache_save(const char *sql)
+{
+	CsPlanCacheEntry *entry;
+	uint32		hash;
+
+	if (!csPendingSource->is_complete)
+	{
+		csPendingSource = NULL;
+		return;
+	}
+
+	if (csPlanCache == NULL)
+	{
+		HASHCTL		hashctl;
+
+		csPlanCacheContext = AllocSetContextCreate(CacheMemoryContext,
+												   "catalog plan cache",
+												   ALLOCSET_DEFAULT_SIZES);
+
+		MemSet(&hashctl, 0, sizeof(hashctl));
+		hashctl.keysize = sizeof(uint32);
+		hashctl.entrysize = sizeof(CsPlanCacheEntry);
+		hashctl.hcxt = csPlanCacheContext;
+		csPlanCache = hash_create("catalog plan cache", 256, &hashctl,
+								  HASH_CONTEXT | HASH_ELEM | HASH_BLOBS);
+	}
+
+	hash = cs_plan_cache_hash(sql);
+	entry = hash_search(csPlanCache, &hash, HASH_FIND, NULL);
+	if (entry)
+		cs_plan_cache_remove(entry);
+
+	while (hash_get_num_entries(csPlanCache) >= catalog_plan_cache_size)
+		cs_plan_cache_remove(dlist_tail_element(CsPlanCacheEntry, node,
+												&csPlanCacheLru));
+
+	SaveCachedPlan(csPendingSource);
+
+	entry = hash_search(csPlanCache, &hash, HASH_ENTER, NULL);
+	entry->query_string = MemoryContextStrdup(csPlanCacheContext, sql);
+	entry->userid = GetUserId();
+	entry->search_path = MemoryContextStrdup(csPlanCacheContext,
+											 namespace_search_path);
+	entry->plansource = csPendingSource;
+	entry->invalCounter = csPendingInvalCounter;
+	entry->gucCounter = csPendingGucCounter;
+	entry->catalogData = DataDispatcherCopyCatalog(csPlanCacheContext,
+												   &entry->catalogDataSize);
+	dlist_push_head(&csPlanCacheLru, &entry->node);
+
+	csPendingSource = NULL;
+}
+
+/*
+ * Drop our reference to the cached plan, once the reply carrying it is out.
+ */
+void
+cs_plan_cache_release(void)
+{
+	if (csCachedPlan)
+		ReleaseCachedPlan(csCachedPlan, true);
+
+	csCachedEntry = NULL;
+	csCachedPlan = NULL;
+}
+
 #define VAL(CH)			((CH) - '0')
 #define DIG(VAL)		((VAL) + '0')
 
@@ -52,7 +52,6 @@ bool gp_use_legacy_hashops = false;
 
 /* local function declarations */
 static int	ispowof2(int numsegs);
-static inline int32 jump_consistent_hash(uint64 key, int32 num_segments);
 
 /*================================================================
  *
@@ -526,7 +525,7 @@ ispowof2(int numsegs)
  * https://arxiv.org/abs/1406.2294
  */
 
-static inline int32
+int32
 jump_consistent_hash(uint64 key, int32 num_segments)
 {
 	int64 b = -1;
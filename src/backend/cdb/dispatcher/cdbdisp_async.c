@@ -1058,6 +1058,20 @@ send_sequence_response(PGconn *conn, Oid oid, int64 last, int64 cached, int64 in
 		elog(ERROR, "Failed to send sequence response: %s", PQerrorMessage(conn));
 }
 
+static inline void
+send_tile_claim_response(PGconn *conn, int32 ntuples, char *data, int len)
+{
+	if (pqPutMsgStart(TILE_CLAIM_RESPONSE, false, conn) < 0)
+		elog(ERROR, "Failed to send tile claim response: %s", PQerrorMessage(conn));
+	pqPutInt(ntuples, 4, conn);
+	if (len > 0)
+		pqPutnchar(data, len, conn);
+	if (pqPutMsgEnd(conn) < 0)
+		elog(ERROR, "Failed to send tile claim response: %s", PQerrorMessage(conn));
+	if (pqFlush(conn) < 0)
+		elog(ERROR, "Failed to send tile claim response: %s", PQerrorMessage(conn));
+}
+
 /*
  * Receive and process input from one QE.
  *
@@ -1141,6 +1155,27 @@ processResults(CdbDispatchResult *dispatchResult)
 		{
 			tile_insert_visi_notify(qnotifies->extra);
 		}
+		else if (strcmp(qnotifies->relname, CDB_NOTIFY_TILE_CLAIM) == 0)
+		{
+			/* a QE wants more blocks of a dynamic tile scan */
+			char	   *data = NULL;
+			int32		ntuples = 0;
+			int			len = 0;
+
+			CHECK_FOR_INTERRUPTS();
+
+			PG_TRY();
+			{
+				data = tile_claim_next(qnotifies->extra, &ntuples, &len);
+			}
+			PG_CATCH();
+			{
+				send_tile_claim_response(segdbDesc->conn, -1, NULL, 0);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+			send_tile_claim_response(segdbDesc->conn, ntuples, data, len);
+		}
 		else
 		{
 			/* Got an unknown PGnotify, just record it in log */
@@ -1092,17 +1092,19 @@ acquire_sample_rows(Relation onerel, int elevel,
 
 	Assert(targrows > 0);
 
+	/*
+	 * Tile tables know the tuple count of each of their blocks, and sample
+	 * rows from them on their own. See table_relation_acquire_sample_rows().
+	 */
+	if (RelationIsTile(onerel))
+		return table_relation_acquire_sample_rows(onerel, elevel, rows,
+												  targrows, totalrows,
+												  totaldeadrows);
+
 	scan = table_beginscan_analyze(onerel);
 	slot = table_slot_create(onerel, NULL);
 
-	if(RelationIsTile(onerel))
-	{
-		totalblocks = list_length(((TileScanDesc)scan)->visiInfo);
-	}
-	else
-	{
-		totalblocks = RelationGetNumberOfBlocks(onerel);
-	}
+	totalblocks = RelationGetNumberOfBlocks(onerel);
 
 	/* Need a cutoff xmin for HeapTupleSatisfiesVacuum */
 	OldestXmin = GetOldestXmin(onerel, PROCARRAY_FLAGS_VACUUM);
@@ -1687,7 +1687,7 @@ CollectCopy(ParseState *pstate, const CopyStmt *stmt,
 							 stmt->attlist, options);
 
 		if (rel)
-			table_scan_prepare_dispatch(rel, NULL);
+			table_scan_prepare_dispatch(rel, NULL, NIL);
 
 		EndCopyTo(cstate, processed);
 	}
@@ -68,6 +68,8 @@
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
+#include "cdb/cdbvars.h"
+
 
 /* non-export function prototypes */
 static void CheckPredicate(Expr *predicate);
@@ -504,8 +506,24 @@ DefineIndex(Oid relationId,
 								 PGC_USERSET, PGC_S_SESSION,
 								 GUC_ACTION_SAVE, true, 0, false);
 
+	/*
+	 * Indexes on tile tables are kept in the catalog server cluster, where
+	 * the visibility relations are, and are skipped elsewhere. Blocks that
+	 * compute clusters write are indexed as their visibility changes arrive,
+	 * see tile_insert_visi_cs(). A tile block is rewritten as a whole, so
+	 * the tuples of a block being rewritten would still be seen by a
+	 * uniqueness check.
+	 */
 	if (get_rel_relam(relationId) == TILE_TABLE_AM_OID)
-		return InvalidObjectAddress;
+	{
+		if (!IS_CATALOG_SERVER())
+			return InvalidObjectAddress;
+
+		if (stmt->unique || stmt->primary || stmt->isconstraint)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("unique indexes are not supported on tile tables")));
+	}
 
 	/*
 	 * Force non-concurrent build on temporary relations, even if CONCURRENTLY
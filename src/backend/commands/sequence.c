@@ -53,6 +53,7 @@
 #include "utils/lsyscache.h"
 #include "utils/resowner.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 #include "utils/varlena.h"
 
 #include "catalog/oid_dispatch.h"
@@ -69,6 +70,12 @@
  */
 #define SEQ_LOG_VALS	32
 
+/*
+ * A compute QD leases blocks of values from the catalog server, sized so
+ * that a lease lasts about this long at the rate values are being taken.
+ */
+#define SEQ_LEASE_TARGET_MS	1000
+
 /*
  * The "special area" of a sequence's buffer page looks like this.
  */
@@ -106,6 +113,10 @@ typedef struct SeqTableData
 	/* if last != cached, we have not used up all the cached values */
 	int64		increment;		/* copy of sequence's increment field */
 	/* note that increment is zero until we first do nextval_internal() */
+	int64		lease;			/* values to lease next, compute QD only */
+	TimestampTz leaseTime;		/* when the last lease was taken */
+	uint64		leaseServed;	/* when a leased value was last returned, or 0
+								 * if the catalog server has been told */
 } SeqTableData;
 
 typedef SeqTableData *SeqTable;
@@ -118,6 +129,15 @@ static HTAB *seqhashtab = NULL; /* hash table for SeqTable items */
  */
 static SeqTableData *last_used_seq = NULL;
 
+/* GUC */
+int			catalog_sequence_lease_max = 1024;
+
+/* on the catalog server, values the compute QD asked to lease */
+static int64 seq_lease_request = 0;
+
+/* counts the values a compute QD returns from its leases */
+static uint64 seq_lease_served = 0;
+
 static void fill_seq_with_data(Relation rel, HeapTuple tuple);
 static Relation lock_and_open_sequence(SeqTable seq);
 static void create_seq_hashtable(void);
@@ -132,6 +152,7 @@ static void init_params(ParseState *pstate, List *options, bool for_identity,
 						bool *need_seq_rewrite,
 						List **owned_by);
 static void do_setval(Oid relid, int64 next, bool iscalled);
+static void lease_sequence_values(SeqTable elm);
 static void process_owned_by(Relation seqrel, List *owned_by, bool for_identity);
 
 static void
@@ -667,21 +688,79 @@ nextval_oid(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(nextval_internal(relid, true, false));
 }
 
+/*
+ * Serve a nextval() request of a QE from the values the QD has leased.
+ * QEs get one value at a time.
+ */
 void
 nextval_qd(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement, bool *poverflow)
 {
-	cc_next_val(relid, plast, pcached, pincrement, poverflow);
+	*plast = nextval_internal(relid, false, true);
+	*pcached = *plast;
+	*pincrement = last_used_seq->increment;
+	*poverflow = !last_used_seq->last_valid;
 }
 
+/*
+ * Lease at least nvalues values of a sequence to a compute QD. The catalog
+ * server hands over every value it fetched and keeps none of them cached,
+ * as the QD serves them from now on. The QD reports the values it returned
+ * with its next statement, see sequence_lease_report().
+ */
 void
-nextval_cs(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement, bool *poverflow)
+nextval_cs(Oid relid, int64 nvalues, int64 *plast, int64 *pcached,
+		   int64 *pincrement, bool *poverflow)
 {
 	Assert(IS_QUERY_DISPATCHER());
 
-	*plast = nextval_internal(relid, false, true);
+	seq_lease_request = nvalues;
+	PG_TRY();
+	{
+		*plast = nextval_internal(relid, false, true);
+	}
+	PG_CATCH();
+	{
+		seq_lease_request = 0;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	seq_lease_request = 0;
+
 	*pcached = last_used_seq->cached;
 	*pincrement = last_used_seq->increment;
 	*poverflow = !last_used_seq->last_valid;
+
+	last_used_seq->cached = last_used_seq->last;
+}
+
+/*
+ * Take a new lease of values from the catalog server. The lease doubles when
+ * the previous one ran out in less than half of SEQ_LEASE_TARGET_MS, and
+ * halves when it lasted more than twice as long, so that a busy sequence
+ * costs a catalog server round trip about once per SEQ_LEASE_TARGET_MS.
+ * Values left in a lease when the session ends are lost, as with CACHE.
+ */
+static void
+lease_sequence_values(SeqTable elm)
+{
+	TimestampTz now = GetCurrentTimestamp();
+	int64		nvalues = elm->lease;
+	bool		overflow;
+
+	if (elm->leaseTime != 0)
+	{
+		if (!TimestampDifferenceExceeds(elm->leaseTime, now, SEQ_LEASE_TARGET_MS / 2))
+			nvalues *= 2;
+		else if (TimestampDifferenceExceeds(elm->leaseTime, now, SEQ_LEASE_TARGET_MS * 2))
+			nvalues /= 2;
+	}
+	nvalues = Max(Min(nvalues, catalog_sequence_lease_max), 1);
+
+	cc_next_val(elm->key.relid, nvalues, &elm->last, &elm->cached,
+				&elm->increment, &overflow);
+	elm->last_valid = !overflow;
+	elm->lease = nvalues;
+	elm->leaseTime = now;
 }
 
 int64
@@ -759,11 +838,16 @@ nextval_internal(Oid relid, bool check_permissions, bool called_from_dispatcher)
 		}
 		else
 		{
-			nextval_qd(relid,
-					   &elm->last,
-					   &elm->cached,
-					   &elm->increment,
-					   &elm->last_valid);
+			/* serve from the lease, or take a new one */
+			if (elm->last != elm->cached)
+			{
+				Assert(elm->last_valid);
+				Assert(elm->increment != 0);
+				elm->last += elm->increment;
+			}
+			else
+				lease_sequence_values(elm);
+			elm->leaseServed = ++seq_lease_served;
 			last_used_seq = elm;
 			relation_close(seqrel, NoLock);
 			return elm->last;
@@ -777,7 +861,7 @@ nextval_internal(Oid relid, bool check_permissions, bool called_from_dispatcher)
 	incby = pgsform->seqincrement;
 	maxv = pgsform->seqmax;
 	minv = pgsform->seqmin;
-	cache = pgsform->seqcache;
+	cache = Max(pgsform->seqcache, seq_lease_request);
 	cycle = pgsform->seqcycle;
 	ReleaseSysCache(pgstuple);
 
@@ -1306,6 +1390,9 @@ init_sequence_internal(Oid _relid, SeqTable *p_elm, Relation *p_rel,
 		elm->lxid = InvalidLocalTransactionId;
 		elm->last_valid = false;
 		elm->last = elm->cached = 0;
+		elm->lease = 1;
+		elm->leaseTime = 0;
+		elm->leaseServed = 0;
 	}
 
 	/*
@@ -2123,6 +2210,108 @@ ResetSequenceCaches(void)
 	last_used_seq = NULL;
 }
 
+static int
+seq_lease_served_cmp(const void *a, const void *b)
+{
+	SeqTable	elma = *(const SeqTable *) a;
+	SeqTable	elmb = *(const SeqTable *) b;
+
+	if (elma->leaseServed < elmb->leaseServed)
+		return -1;
+	return elma->leaseServed > elmb->leaseServed ? 1 : 0;
+}
+
+/*
+ * On a compute QD, collect the values returned from leases since the last
+ * report, as NextValNodes carrying the value in plast. The catalog server
+ * applies them before it runs our next statement, so that currval() and
+ * lastval() there see them. The sequence used last comes last.
+ */
+List *
+sequence_lease_report(void)
+{
+	HASH_SEQ_STATUS status;
+	SeqTable	elm;
+	SeqTable   *served;
+	int			nserved = 0;
+	int			i;
+	List	   *report = NIL;
+
+	if (seqhashtab == NULL)
+		return NIL;
+
+	served = palloc(sizeof(SeqTable) * hash_get_num_entries(seqhashtab));
+	hash_seq_init(&status, seqhashtab);
+	while ((elm = (SeqTable) hash_seq_search(&status)) != NULL)
+	{
+		if (elm->leaseServed != 0)
+			served[nserved++] = elm;
+	}
+	qsort(served, nserved, sizeof(SeqTable), seq_lease_served_cmp);
+
+	for (i = 0; i < nserved; i++)
+	{
+		NextValNode *nextVal = makeNode(NextValNode);
+
+		nextVal->relid = served[i]->key.relid;
+		nextVal->plast = served[i]->last;
+		report = lappend(report, nextVal);
+		served[i]->leaseServed = 0;
+	}
+	pfree(served);
+
+	return report;
+}
+
+/*
+ * On the catalog server, take the values a compute QD returned from its
+ * leases as the ones this session got last. Dropped sequences are skipped.
+ */
+void
+sequence_lease_apply(List *report)
+{
+	ListCell   *lc;
+
+	foreach(lc, report)
+	{
+		NextValNode *nextVal = lfirst(lc);
+		SeqTable	elm;
+		Relation	seqrel;
+
+		if (!SearchSysCacheExists1(RELOID, ObjectIdGetDatum(nextVal->relid)))
+			continue;
+
+		init_sequence(nextVal->relid, &elm, &seqrel);
+		elm->last = nextVal->plast;
+		elm->cached = elm->last;
+		elm->last_valid = true;
+		last_used_seq = elm;
+		relation_close(seqrel, NoLock);
+	}
+}
+
+/*
+ * On a compute QD, give up the values left in leases after a statement ran
+ * on the catalog server, where setval() or ALTER SEQUENCE may have moved the
+ * sequences. They are lost, as cached values are.
+ */
+void
+sequence_lease_drop(void)
+{
+	HASH_SEQ_STATUS status;
+	SeqTable	elm;
+
+	if (seqhashtab == NULL)
+		return;
+
+	hash_seq_init(&status, seqhashtab);
+	while ((elm = (SeqTable) hash_seq_search(&status)) != NULL)
+	{
+		elm->cached = elm->last;
+		elm->leaseTime = 0;
+	}
+}
+
 /*
  * Mask a Sequence page before performing consistency checks on it.
  */
@@ -36,6 +36,7 @@
 #include "catalog/pg_database.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_namespace.h"
+#include "catalog/pg_tile.h"
 #include "commands/cluster.h"
 #include "commands/defrem.h"
 #include "commands/vacuum.h"
@@ -50,6 +51,7 @@
 #include "utils/acl.h"
 #include "utils/fmgroids.h"
 #include "utils/guc.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
@@ -1757,6 +1759,48 @@ vacuum_rel(Oid relid, RangeVar *relation, VacuumParams *params)
 		return false;
 	}
 
+	/*
+	 * Index entries of a tile table name blocks by the TIDs of visibility
+	 * tuples, which must not be freed for reuse before the entries are
+	 * removed. Its visibility relation is only vacuumed with the table then.
+	 * Nothing else schedules the table, so autovacuum, including runs that
+	 * prevent wraparound, vacuums the table in place of the relation.
+	 */
+	if (RelationGetNamespace(onerel) == PG_AOSEGMENT_NAMESPACE &&
+		onerel->rd_rel->relkind == RELKIND_RELATION)
+	{
+		Oid			mainRelId = PgTileGetMainRelId(RelationGetRelid(onerel));
+		HeapTuple	mainTuple = NULL;
+		bool		mainIndexed = false;
+
+		if (OidIsValid(mainRelId))
+			mainTuple = SearchSysCache1(RELOID, ObjectIdGetDatum(mainRelId));
+		if (HeapTupleIsValid(mainTuple))
+		{
+			mainIndexed = ((Form_pg_class) GETSTRUCT(mainTuple))->relhasindex;
+			ReleaseSysCache(mainTuple);
+		}
+
+		if (mainIndexed)
+		{
+			bool		redirect = (IsAutoVacuumWorkerProcess() ||
+									params->is_wraparound);
+
+			if (!redirect)
+				ereport(WARNING,
+						(errmsg("skipping \"%s\" --- vacuum the tile table \"%s\" instead",
+								RelationGetRelationName(onerel),
+								get_rel_name(mainRelId))));
+			relation_close(onerel, lmode);
+			PopActiveSnapshot();
+			CommitTransactionCommand();
+
+			if (redirect)
+				return vacuum_rel(mainRelId, NULL, params);
+			return false;
+		}
+	}
+
 	/*
 	 * Silently ignore tables that are temp tables of other backends ---
 	 * trying to vacuum these will lead to great unhappiness, since their
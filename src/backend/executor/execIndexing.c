@@ -291,6 +291,13 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 	Datum		values[INDEX_MAX_KEYS];
 	bool		isnull[INDEX_MAX_KEYS];
 
+	/*
+	 * The tuples of a tile table have no lasting TIDs until their block is
+	 * written, which adds their index entries, see tile_index_block_tuples().
+	 */
+	if (RelationIsTile(estate->es_result_relation_info->ri_RelationDesc))
+		return NIL;
+
 	Assert(ItemPointerIsValid(tupleid));
 
 	/*
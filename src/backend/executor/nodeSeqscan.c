@@ -29,6 +29,7 @@
 
 #include "access/relscan.h"
 #include "access/tableam.h"
+#include "access/tileam.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
 #include "utils/rel.h"
@@ -81,6 +82,10 @@ SeqNext(SeqScanState *node)
 									  NULL,
 									  NULL);
 		node->ss.ss_currentScanDesc = scandesc;
+
+		/* lets a tile scan claim its blocks from the QD, see tileam.c */
+		if (RelationIsTile(node->ss.ss_currentRelation))
+			tile_scan_set_plan_node(scandesc, node->ss.ps.plan->plan_node_id);
 	}
 
 	/*
@@ -155,7 +160,8 @@ ExecInitSeqScanForPartition(SeqScan *node, EState *estate,
 	Assert(outerPlan(node) == NULL);
 	Assert(innerPlan(node) == NULL);
 
-	table_scan_prepare_dispatch(currentRelation, estate->es_snapshot);
+	table_scan_prepare_dispatch(currentRelation, estate->es_snapshot,
+								node->plan.qual);
 
 	/*
 	 * create state structure
@@ -952,6 +952,8 @@ _outCdbCatalogNode(StringInfo str, const CdbCatalogNode *node)
 	WRITE_STRING_FIELD(CatalogServerId);
 	WRITE_NODE_FIELD(tableList);
 	WRITE_STRING_FIELD(s3Url);
+	WRITE_UINT64_FIELD(catalog_version);
+	WRITE_BOOL_FIELD(catalog_delta);
 }
 
 static void
@@ -972,6 +974,7 @@ _outCdbCatalogAuxNode(StringInfo str, const CdbCatalogAuxNode *node)
 	WRITE_NODE_FIELD(catalog);
 	WRITE_NODE_FIELD(aux);
 	WRITE_NODE_FIELD(plan);
+	WRITE_BOOL_FIELD(xact_finished);
 }
 
 /*
@@ -168,9 +168,12 @@ static void outChar(StringInfo str, char c);
 			appendStringInfo(str, " %s", booltostr(node->fldname[i])); \
 	} while(0)
 
-/* Write a bytea field */
+/* Write a bytea field, which may be NULL */
 #define WRITE_BYTEA_FIELD(fldname) \
-	(_outDatum(str, PointerGetDatum(node->fldname), -1, false))
+	(appendStringInfoString(str, " :" CppAsString(fldname) " "), \
+	 (node->fldname ? \
+	  outDatum(str, PointerGetDatum(node->fldname), -1, false) : \
+	  appendStringInfoString(str, "0 [ ]")))
 
 /* Write a dummy field -- value not displayable or copyable */
 #define WRITE_DUMMY_FIELD(fldname) \
@@ -5527,6 +5530,7 @@ _outNextValNode(StringInfo str, const NextValNode *node)
 	WRITE_NODE_TYPE("NEXTVALNODE");
 
 	WRITE_OID_FIELD(relid);
+	WRITE_LONG_FIELD(nvalues);
 	WRITE_LONG_FIELD(plast);
 	WRITE_LONG_FIELD(pcached);
 	WRITE_LONG_FIELD(pincrement);
@@ -5543,6 +5547,7 @@ _outBlockDesc2(StringInfo str, const BlockDesc2 *node)
 	WRITE_UINT64_FIELD(newKey.seq);
 	WRITE_UINT_FIELD(block_size);
 	WRITE_UINT_FIELD(block_tuple_num);
+	WRITE_BYTEA_FIELD(zonemap);
 }
 
 static void
@@ -5555,6 +5560,8 @@ _outCsQuery(StringInfo str, const CsQuery *node)
 	WRITE_NODE_FIELD(data);
 	WRITE_INT_FIELD(cluster_id);
 	WRITE_INT_FIELD(segment_count);
+	WRITE_UINT64_FIELD(catalog_version);
+	WRITE_BOOL_FIELD(xact_start);
 };
 
 
@@ -1700,6 +1700,8 @@ _readCdbCatalogNode(void)
 	READ_STRING_FIELD(CatalogServerId);
 	READ_NODE_FIELD(tableList);
 	READ_STRING_FIELD(s3Url);
+	READ_UINT64_FIELD(catalog_version);
+	READ_BOOL_FIELD(catalog_delta);
 
 	READ_DONE();
 }
@@ -1729,6 +1731,7 @@ _readCdbCatalogAuxNode(void)
 	READ_NODE_FIELD(catalog);
 	READ_NODE_FIELD(aux);
 	READ_NODE_FIELD(plan);
+	READ_BOOL_FIELD(xact_finished);
 
 	READ_DONE();
 }
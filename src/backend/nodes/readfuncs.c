@@ -164,7 +164,11 @@
 
 /* Read a bytea field */
 #define READ_BYTEA_FIELD(fldname) \
-	local_node->fldname = (bytea *) DatumGetPointer(readDatum(false))
+	do { \
+		token = pg_strtok(&length);		/* skip :fldname */ \
+		(void) token;				/* in case not used elsewhere */ \
+		local_node->fldname = (bytea *) DatumGetPointer(readDatum(false)); \
+	} while (0)
 
 /* Set field to a given value, ignoring the value read from the input */
 #define READ_DUMMY_FIELD(fldname,fldvalue)  READ_SCALAR_FIELD(fldname, fldvalue)
@@ -4400,6 +4404,7 @@ _readBlockDesc2(void)
 	READ_UINT64_FIELD(newKey.seq);
 	READ_UINT_FIELD(block_size);
 	READ_UINT_FIELD(block_tuple_num);
+	READ_BYTEA_FIELD(zonemap);
 
 	READ_DONE();
 }
@@ -4414,6 +4419,8 @@ _readCsQuery(void)
 	READ_NODE_FIELD(data);
 	READ_INT_FIELD(cluster_id);
 	READ_INT_FIELD(segment_count);
+	READ_UINT64_FIELD(catalog_version);
+	READ_BOOL_FIELD(xact_start);
 
 	READ_DONE();
 }
@@ -4424,6 +4431,7 @@ _readNextValNode(void)
 	READ_LOCALS(NextValNode);
 
 	READ_OID_FIELD(relid);
+	READ_LONG_FIELD(nvalues);
 	READ_LONG_FIELD(plast);
 	READ_LONG_FIELD(pcached);
 	READ_LONG_FIELD(pincrement);
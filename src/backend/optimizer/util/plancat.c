@@ -50,6 +50,7 @@
 #include "statistics/statistics.h"
 #include "storage/bufmgr.h"
 #include "utils/builtins.h"
+#include "utils/dispatchcat.h"
 #include "utils/lsyscache.h"
 #include "utils/partcache.h"
 #include "utils/rel.h"
@@ -57,6 +58,7 @@
 #include "utils/snapmgr.h"
 
 #include "cdb/cdbappendonlyam.h"
+#include "cdb/cdbvars.h"
 #include "cdb/cdbrelsize.h"
 #include "catalog/pg_appendonly.h"
 #include "catalog/pg_foreign_server.h"
@@ -190,6 +192,15 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 	if (inhparent ||
 		(IgnoreSystemIndexes && IsSystemRelation(relation)))
 		hasindex = false;
+	else if (RelationIsTile(relation) &&
+			 (!IS_CATALOG_SERVER() || DataDispatcherActive()))
+	{
+		/*
+		 * Tile indexes live in the catalog server cluster, so a plan that is
+		 * built there for a compute cluster must not use them either.
+		 */
+		hasindex = false;
+	}
 	else
 		hasindex = relation->rd_rel->relhasindex;
 
@@ -283,7 +294,9 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 			for (i = 0; i < ncolumns; i++)
 			{
 				info->indexkeys[i] = index->indkey.values[i];
-				info->canreturn[i] = index_can_return(indexRelation, i + 1);
+				/* tile tables have no visibility map for index-only scans */
+				info->canreturn[i] = !RelationIsTile(relation) &&
+					index_can_return(indexRelation, i + 1);
 			}
 
 			for (i = 0; i < nkeycolumns; i++)
@@ -1,18 +1,35 @@
 #include <aws/core/Aws.h>
 #include <aws/core/auth/AWSCredentialsProvider.h>
+#include <aws/core/client/RetryStrategy.h>
+#include <aws/core/utils/threading/Executor.h>
+#include <aws/s3/model/AbortMultipartUploadRequest.h>
+#include <aws/s3/model/CompleteMultipartUploadRequest.h>
 #include <aws/s3/model/CreateBucketRequest.h>
+#include <aws/s3/model/CreateMultipartUploadRequest.h>
 #include <aws/s3/model/DeleteBucketRequest.h>
 #include <aws/s3/model/DeleteObjectRequest.h>
+#include <aws/s3/model/DeleteObjectsRequest.h>
 #include <aws/s3/model/HeadBucketRequest.h>
 #include <aws/s3/model/GetObjectRequest.h>
 #include <aws/s3/model/ListObjectsRequest.h>
 #include <aws/s3/model/ListObjectsV2Request.h>
 #include <aws/s3/model/PutObjectRequest.h>
+#include <aws/s3/model/UploadPartRequest.h>
 #include <aws/s3/S3Client.h>
+#include <aws/core/utils/stream/PreallocatedStreamBuf.h>
+
+#include <atomic>
+#include <deque>
+#include <random>
+#include <unordered_set>
+#include <vector>
 
 
 extern "C" {
 #include "postgres.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/latch.h"
 }
 
 #include "storage/objectfilerw.h"
@@ -26,6 +43,79 @@ typedef struct S3Access
 	Aws::SDKOptions *op;
 } S3Access;
 
+/*
+ * Asynchronous requests run on the pooled SDK executor. When one completes,
+ * the worker thread records its outcome, sets done and then the latch of the
+ * backend that issued it, so that a backend can wait for requests together
+ * with any other latch event. Worker threads must not call into the backend
+ * beyond SetLatch(), so outcomes are kept in SDK strings until the backend
+ * picks them up.
+ */
+
+/*
+ * An in-flight GetObject request. The response body is streamed by the SDK
+ * worker thread straight into the caller's buffer, so the buffer must stay
+ * valid until the request has been waited for or cancelled.
+ */
+typedef struct S3AsyncGet
+{
+	std::atomic<bool> done;
+	Latch	   *latch;
+	bool		failed;
+	uint32		dataSize;
+	Aws::String errMsg;
+} S3AsyncGet;
+
+static std::unordered_set<S3AsyncGet *> pendingGets;
+
+/* objects larger than this are uploaded in parts, the S3 minimum part size */
+#define S3_PART_SIZE (5 * 1024 * 1024)
+
+/*
+ * One part of an in-flight upload, or the whole object when it is small
+ * enough for a single PutObject. The body is read by the SDK worker thread
+ * straight from the caller's buffer.
+ */
+typedef struct S3PutPart
+{
+	std::atomic<bool> done;
+	Latch	   *latch;
+	bool		finished;		/* off the wire, as far as the backend knows */
+	bool		failed;
+	Aws::String etag;
+	Aws::String errMsg;
+} S3PutPart;
+
+typedef struct S3AsyncPut
+{
+	Aws::String key;
+	Aws::String uploadId;		/* empty for a single PutObject */
+	std::vector<S3PutPart *> parts;
+} S3AsyncPut;
+
+static std::unordered_set<S3AsyncPut *> pendingPuts;
+
+/* parts on the wire, oldest first, across all pending uploads */
+static std::deque<S3PutPart *> inflightParts;
+
+/* the most keys S3 takes in one DeleteObjects request */
+#define S3_DELETE_BATCH 1000
+
+/* an in-flight DeleteObjects request */
+typedef struct S3AsyncDelete
+{
+	std::atomic<bool> done;
+	Latch	   *latch;
+	bool		failed;
+	Aws::String errMsg;
+} S3AsyncDelete;
+
+/* how long to sleep between checks in case a latch wakeup is lost */
+#define S3_WAIT_POLL_MS 1000
+
+/* the longest a retry is put off, however many attempts came before */
+#define S3_RETRY_MAX_DELAY_MS 20000
+
 extern int myClusterId;
 extern char *CatalogServerId;
 
@@ -34,8 +124,78 @@ char *bucket_id = NULL;
 char *s3_url = "127.0.0.1:9000";
 char s3_url_data[NAMEDATALEN];
 
+/* GUC */
+int s3_max_connections = 25;
+int s3_connect_timeout = 1000;
+int s3_request_timeout = 3000;
+int s3_max_retries = 10;
+int s3_retry_delay = 25;
+
 static void  SetCofig(ClientConfiguration *conf);
 
+/*
+ * Exponential backoff with full jitter: retry n of a request sleeps a random
+ * time up to s3_retry_delay * 2^n, so that the backends of a host failing
+ * against the same endpoint do not come back in lockstep.
+ */
+class S3JitterRetryStrategy : public RetryStrategy
+{
+public:
+	S3JitterRetryStrategy(long maxRetries, long baseDelayMs)
+		: maxRetries(maxRetries), baseDelayMs(baseDelayMs)
+	{
+	}
+
+	bool
+	ShouldRetry(const AWSError<CoreErrors> &error,
+				long attemptedRetries) const override
+	{
+		return attemptedRetries < maxRetries && error.ShouldRetry();
+	}
+
+	long
+	CalculateDelayBeforeNextRetry(const AWSError<CoreErrors> &error,
+								  long attemptedRetries) const override
+	{
+		thread_local std::minstd_rand rng(std::random_device{}());
+		long ceiling;
+
+		ceiling = Min(baseDelayMs << Min(attemptedRetries, 16L),
+					  (long) S3_RETRY_MAX_DELAY_MS);
+
+		return std::uniform_int_distribution<long>(0, ceiling)(rng);
+	}
+
+private:
+	long maxRetries;
+	long baseDelayMs;
+};
+
+/* run by the SDK worker thread, last thing it does with a request */
+static void
+S3Complete(std::atomic<bool> &done, Latch *latch)
+{
+	done.store(true, std::memory_order_release);
+	SetLatch(latch);
+}
+
+/*
+ * Sleep on the process latch until a request has completed. Interrupts are
+ * served while waiting, unless the caller is cleaning up after an error.
+ */
+static void
+S3WaitDone(const std::atomic<bool> &done, bool interruptible)
+{
+	while (!done.load(std::memory_order_acquire))
+	{
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 S3_WAIT_POLL_MS, WAIT_EVENT_S3_REQUEST);
+		ResetLatch(MyLatch);
+		if (interruptible)
+			CHECK_FOR_INTERRUPTS();
+	}
+}
+
 void
 S3SetBucketId(char *id)
 {
@@ -112,6 +272,7 @@ S3DeleteObjects(void *s3Client, const char *prefix)
 	S3Access *s3_client = static_cast<S3Access *>(s3Client);
 
 	s3_obj.objPathList = NIL;
+	s3_obj.objSizeList = NIL;
 	req.WithBucket(default_bucket_name);
 	req.WithPrefix(prefix);
 
@@ -137,6 +298,7 @@ S3DeleteObjects(void *s3Client, const char *prefix)
 			objPath = static_cast<char *>(palloc(obj.GetKey().length() + 1));
 			strcpy(objPath, obj.GetKey().c_str());
 			s3_obj.objPathList = lappend(s3_obj.objPathList, objPath);
+			s3_obj.objSizeList = lappend_int(s3_obj.objSizeList, (int) obj.GetSize());
 		}
 	} while (!continuationToken.empty());
 
@@ -205,31 +367,582 @@ S3GetObject2(void *s3Client, const char *bucketPath, const char *objPath,
 	return dataSize;
 }
 
-void
-S3PutObject(void *s3Client, S3ObjKey s3_obj_key, S3Obj s3_obj)
+static S3AsyncGet *
+S3IssueGet(S3Access *s3_client, const char *bucketPath, const char *objPath,
+		   const char *range, char *data, uint32 capacity)
 {
-	Model::PutObjectRequest req;
-	char *name = static_cast<char *>
-		(palloc(strlen(s3_obj_key.bucketName) + strlen(s3_obj_key.objectName) + 2));
-	sprintf(name, "%s_%s", s3_obj_key.bucketName, s3_obj_key.objectName);
+	Model::GetObjectRequest req;
+	S3AsyncGet *request = new S3AsyncGet();
+
+	char *name = static_cast<char *> (palloc(strlen(bucketPath) + strlen(objPath) + 2));
+	sprintf(name, "%s_%s", bucketPath, objPath);
+
 	req.SetBucket(default_bucket_name);
 	req.SetKey(name);
 	pfree(name);
+	if (range)
+		req.SetRange(range);
+
+	/* the factory, and so the buffer, lives as long as the SDK's request */
+	auto streamBuf = Aws::MakeShared<Aws::Utils::Stream::PreallocatedStreamBuf>(
+			"S3GetObjectAsync", reinterpret_cast<unsigned char *>(data), capacity);
+	req.SetResponseStreamFactory([streamBuf]() {
+		return Aws::New<Aws::IOStream>("S3GetObjectAsync", streamBuf.get());
+	});
+
+	request->done = false;
+	request->latch = MyLatch;
+	request->failed = false;
+	request->dataSize = 0;
+	pendingGets.insert(request);
+
+	s3_client->cli->GetObjectAsync(req,
+		[request](const S3Client *, const Model::GetObjectRequest &,
+				  const Model::GetObjectOutcome &outcome,
+				  const std::shared_ptr<const AsyncCallerContext> &)
+		{
+			if (outcome.IsSuccess())
+				request->dataSize = outcome.GetResult().GetContentLength();
+			else
+			{
+				request->failed = true;
+				request->errMsg = outcome.GetError().GetMessage();
+			}
+			S3Complete(request->done, request->latch);
+		});
+
+	return request;
+}
+
+void *
+S3GetObjectAsync(void *s3Client, const char *bucketPath, const char *objPath,
+				 char *data, uint32 capacity)
+{
 	S3Access *s3_client = static_cast<S3Access *>(s3Client);
 
-	auto writer = Aws::MakeShared<Aws::StringStream>(
-			"PutObjectInputStream",
-			std::stringstream::in | std::stringstream::out | std::stringstream::binary);
-	writer->write(s3_obj.data, s3_obj.size);
+	return static_cast<void *>(S3IssueGet(s3_client, bucketPath, objPath, NULL,
+										  data, capacity));
+}
 
-	req.SetBody(writer);
-	Model::PutObjectOutcome result = s3_client->cli->PutObject(req);
+/*
+ * Like S3GetObjectAsync, but only fetch length bytes starting at offset.
+ * Reading past the end of the object returns the bytes that exist.
+ */
+void *
+S3GetObjectRangeAsync(void *s3Client, const char *bucketPath, const char *objPath,
+					  uint32 offset, uint32 length, char *data)
+{
+	S3Access *s3_client = static_cast<S3Access *>(s3Client);
+	char range[64];
 
-	if (!result.IsSuccess())
+	snprintf(range, sizeof(range), "bytes=%u-%u", offset, offset + length - 1);
+
+	return static_cast<void *>(S3IssueGet(s3_client, bucketPath, objPath, range,
+										  data, length));
+}
+
+uint32
+S3GetObjectRange(void *s3Client, const char *bucketPath, const char *objPath,
+				 uint32 offset, uint32 length, char *data)
+{
+	return S3GetObjectWait(S3GetObjectRangeAsync(s3Client, bucketPath, objPath,
+												 offset, length, data));
+}
+
+/*
+ * Whether a GET has completed, so that S3GetObjectWait() will not block.
+ */
+bool
+S3GetObjectDone(void *asyncGet)
+{
+	S3AsyncGet *request = static_cast<S3AsyncGet *>(asyncGet);
+
+	return request->done.load(std::memory_order_acquire);
+}
+
+uint32
+S3GetObjectWait(void *asyncGet)
+{
+	S3AsyncGet *request = static_cast<S3AsyncGet *>(asyncGet);
+	uint32 dataSize = 0;
+	char *errMsg = NULL;
+
+	S3WaitDone(request->done, true);
+
+	if (request->failed)
+		errMsg = pstrdup(request->errMsg.c_str());
+	else
+		dataSize = request->dataSize;
+
+	pendingGets.erase(request);
+	delete request;
+
+	if (errMsg)
+		elog(ERROR, "GetObject failed with error '%s'", errMsg);
+
+	return dataSize;
+}
+
+void
+S3GetObjectCancel(void *asyncGet)
+{
+	S3AsyncGet *request = static_cast<S3AsyncGet *>(asyncGet);
+
+	/*
+	 * The SDK cannot abort a request that is already on the wire, so the
+	 * only safe way to give the buffer back is to let the transfer finish.
+	 */
+	S3WaitDone(request->done, false);
+
+	pendingGets.erase(request);
+	delete request;
+}
+
+void
+S3GetObjectCancelAll(void)
+{
+	for (S3AsyncGet *request : pendingGets)
 	{
-		auto err = result.GetError();
-		elog(ERROR, "PutObject failed with error '%s'", err.GetMessage().c_str());
+		S3WaitDone(request->done, false);
+		delete request;
 	}
+
+	pendingGets.clear();
+}
+
+/*
+ * Wait for a part to reach the server and take it off the wire. Does not
+ * throw unless interruptible, so that it can run while cleaning up.
+ */
+static void
+S3FinishPart(S3PutPart *part, bool interruptible)
+{
+	if (part->finished)
+		return;
+
+	S3WaitDone(part->done, interruptible);
+	part->finished = true;
+
+	for (auto it = inflightParts.begin(); it != inflightParts.end(); ++it)
+	{
+		if (*it == part)
+		{
+			inflightParts.erase(it);
+			break;
+		}
+	}
+}
+
+/*
+ * A request body read straight from data. Its stream buffer goes away with
+ * it, once the SDK has let go of the request.
+ */
+static std::shared_ptr<Aws::IOStream>
+S3PartBody(char *data, uint32 size)
+{
+	auto *streamBuf = Aws::New<Aws::Utils::Stream::PreallocatedStreamBuf>(
+			"S3PutObjectAsync", reinterpret_cast<unsigned char *>(data), size);
+
+	return std::shared_ptr<Aws::IOStream>(
+			Aws::New<Aws::IOStream>("S3PutObjectAsync", streamBuf),
+			[streamBuf](Aws::IOStream *body) {
+				Aws::Delete(body);
+				Aws::Delete(streamBuf);
+			});
+}
+
+static void
+S3FreePut(S3AsyncPut *request)
+{
+	for (S3PutPart *part : request->parts)
+		delete part;
+	pendingPuts.erase(request);
+	delete request;
+}
+
+/*
+ * Start uploading size bytes of data, without copying them. Objects larger
+ * than S3_PART_SIZE go up as a multipart upload whose parts travel in
+ * parallel. At most maxParts parts are on the wire at a time across all
+ * pending uploads; issuing more waits for the oldest ones first. data must
+ * stay valid until S3PutObjectWait() has returned.
+ */
+void *
+S3PutObjectAsync(void *s3Client, const char *bucketPath, const char *objPath,
+				 char *data, uint32 size, int maxParts)
+{
+	S3Access *s3_client = static_cast<S3Access *>(s3Client);
+	S3AsyncPut *request = new S3AsyncPut();
+	uint32 offset = 0;
+	int partNumber = 1;
+
+	char *name = static_cast<char *> (palloc(strlen(bucketPath) + strlen(objPath) + 2));
+	sprintf(name, "%s_%s", bucketPath, objPath);
+	request->key = name;
+	pfree(name);
+	pendingPuts.insert(request);
+
+	if (size > S3_PART_SIZE)
+	{
+		Model::CreateMultipartUploadRequest req;
+
+		req.SetBucket(default_bucket_name);
+		req.SetKey(request->key);
+		Model::CreateMultipartUploadOutcome result =
+			s3_client->cli->CreateMultipartUpload(req);
+
+		if (!result.IsSuccess())
+		{
+			char *errMsg = pstrdup(result.GetError().GetMessage().c_str());
+
+			S3FreePut(request);
+			elog(ERROR, "CreateMultipartUpload failed with error '%s'", errMsg);
+		}
+		request->uploadId = result.GetResult().GetUploadId();
+	}
+
+	do
+	{
+		S3PutPart *part;
+		uint32 partSize = request->uploadId.empty() ? size :
+			Min(size - offset, (uint32) S3_PART_SIZE);
+
+		while ((int) inflightParts.size() >= Max(maxParts, 1))
+			S3FinishPart(inflightParts.front(), true);
+
+		part = new S3PutPart();
+		part->done = false;
+		part->latch = MyLatch;
+		part->finished = false;
+		part->failed = false;
+		request->parts.push_back(part);
+		inflightParts.push_back(part);
+
+		if (request->uploadId.empty())
+		{
+			Model::PutObjectRequest req;
+
+			req.SetBucket(default_bucket_name);
+			req.SetKey(request->key);
+			req.SetContentLength(partSize);
+			req.SetBody(S3PartBody(data, partSize));
+			s3_client->cli->PutObjectAsync(req,
+				[part](const S3Client *, const Model::PutObjectRequest &,
+					   const Model::PutObjectOutcome &outcome,
+					   const std::shared_ptr<const AsyncCallerContext> &)
+				{
+					if (!outcome.IsSuccess())
+					{
+						part->failed = true;
+						part->errMsg = outcome.GetError().GetMessage();
+					}
+					S3Complete(part->done, part->latch);
+				});
+		}
+		else
+		{
+			Model::UploadPartRequest req;
+
+			req.SetBucket(default_bucket_name);
+			req.SetKey(request->key);
+			req.SetUploadId(request->uploadId);
+			req.SetPartNumber(partNumber);
+			req.SetContentLength(partSize);
+			req.SetBody(S3PartBody(data + offset, partSize));
+			s3_client->cli->UploadPartAsync(req,
+				[part](const S3Client *, const Model::UploadPartRequest &,
+					   const Model::UploadPartOutcome &outcome,
+					   const std::shared_ptr<const AsyncCallerContext> &)
+				{
+					if (outcome.IsSuccess())
+						part->etag = outcome.GetResult().GetETag();
+					else
+					{
+						part->failed = true;
+						part->errMsg = outcome.GetError().GetMessage();
+					}
+					S3Complete(part->done, part->latch);
+				});
+		}
+
+		offset += partSize;
+		partNumber++;
+	} while (offset < size);
+
+	return static_cast<void *>(request);
+}
+
+/*
+ * Whether all parts of an upload have reached the server, so that
+ * S3PutObjectWait() will not block on them.
+ */
+bool
+S3PutObjectDone(void *asyncPut)
+{
+	S3AsyncPut *request = static_cast<S3AsyncPut *>(asyncPut);
+
+	for (S3PutPart *part : request->parts)
+	{
+		if (!part->done.load(std::memory_order_acquire))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Wait for an upload to finish, and complete it if it went up in parts.
+ * The object is not visible in the bucket before this returns.
+ */
+void
+S3PutObjectWait(void *s3Client, void *asyncPut)
+{
+	S3Access *s3_client = static_cast<S3Access *>(s3Client);
+	S3AsyncPut *request = static_cast<S3AsyncPut *>(asyncPut);
+	char *errMsg = NULL;
+
+	for (S3PutPart *part : request->parts)
+	{
+		S3FinishPart(part, true);
+		if (part->failed && !errMsg)
+			errMsg = pstrdup(part->errMsg.c_str());
+	}
+
+	if (!request->uploadId.empty())
+	{
+		if (errMsg)
+		{
+			Model::AbortMultipartUploadRequest req;
+
+			req.SetBucket(default_bucket_name);
+			req.SetKey(request->key);
+			req.SetUploadId(request->uploadId);
+			s3_client->cli->AbortMultipartUpload(req);
+		}
+		else
+		{
+			Model::CompleteMultipartUploadRequest req;
+			Model::CompletedMultipartUpload upload;
+			int partNumber = 1;
+
+			for (S3PutPart *part : request->parts)
+				upload.AddParts(Model::CompletedPart()
+								.WithETag(part->etag)
+								.WithPartNumber(partNumber++));
+
+			req.SetBucket(default_bucket_name);
+			req.SetKey(request->key);
+			req.SetUploadId(request->uploadId);
+			req.SetMultipartUpload(upload);
+			Model::CompleteMultipartUploadOutcome result =
+				s3_client->cli->CompleteMultipartUpload(req);
+
+			if (!result.IsSuccess())
+				errMsg = pstrdup(result.GetError().GetMessage().c_str());
+		}
+	}
+
+	S3FreePut(request);
+
+	if (errMsg)
+		elog(ERROR, "PutObject failed with error '%s'", errMsg);
+}
+
+/*
+ * Drain every pending upload before the buffers they read from go away,
+ * leaving the objects unwritten.
+ */
+void
+S3PutObjectCancelAll(void *s3Client)
+{
+	S3Access *s3_client = static_cast<S3Access *>(s3Client);
+
+	while (!inflightParts.empty())
+		S3FinishPart(inflightParts.front(), false);
+
+	for (S3AsyncPut *request : pendingPuts)
+	{
+		if (!request->uploadId.empty())
+		{
+			Model::AbortMultipartUploadRequest req;
+
+			req.SetBucket(default_bucket_name);
+			req.SetKey(request->key);
+			req.SetUploadId(request->uploadId);
+			s3_client->cli->AbortMultipartUpload(req);
+		}
+		for (S3PutPart *part : request->parts)
+			delete part;
+		delete request;
+	}
+
+	pendingPuts.clear();
+}
+
+void
+S3PutObject(void *s3Client, S3ObjKey s3_obj_key, S3Obj s3_obj)
+{
+	void *request;
+
+	request = S3PutObjectAsync(s3Client, s3_obj_key.bucketName,
+							   s3_obj_key.objectName, s3_obj.data, s3_obj.size,
+							   INT_MAX);
+	S3PutObjectWait(s3Client, request);
+}
+
+/*
+ * Wait for a batch delete to complete, and keep its error if it is the
+ * first one.
+ */
+static void
+S3FinishDelete(S3AsyncDelete *request, char **errMsg)
+{
+	S3WaitDone(request->done, false);
+	if (request->failed && *errMsg == NULL)
+		*errMsg = pstrdup(request->errMsg.c_str());
+	delete request;
+}
+
+/*
+ * Send one DeleteObjects request for batch, once fewer than
+ * s3_max_connections requests of inflight are outstanding.
+ */
+static void
+S3IssueDelete(S3Access *s3_client, Model::Delete &batch,
+			  std::deque<S3AsyncDelete *> &inflight, char **errMsg)
+{
+	Model::DeleteObjectsRequest req;
+	S3AsyncDelete *request;
+
+	while ((int) inflight.size() >= Max(s3_max_connections, 1))
+	{
+		S3FinishDelete(inflight.front(), errMsg);
+		inflight.pop_front();
+	}
+
+	request = new S3AsyncDelete();
+	request->done = false;
+	request->latch = MyLatch;
+	request->failed = false;
+	inflight.push_back(request);
+
+	batch.SetQuiet(true);
+	req.SetBucket(default_bucket_name);
+	req.SetDelete(batch);
+	s3_client->cli->DeleteObjectsAsync(req,
+		[request](const S3Client *, const Model::DeleteObjectsRequest &,
+				  const Model::DeleteObjectsOutcome &outcome,
+				  const std::shared_ptr<const AsyncCallerContext> &)
+		{
+			if (!outcome.IsSuccess())
+			{
+				request->failed = true;
+				request->errMsg = outcome.GetError().GetMessage();
+			}
+			else if (!outcome.GetResult().GetErrors().empty())
+			{
+				const Model::Error &err = outcome.GetResult().GetErrors().front();
+
+				request->failed = true;
+				request->errMsg = err.GetKey() + ": " + err.GetMessage();
+			}
+			S3Complete(request->done, request->latch);
+		});
+}
+
+/*
+ * Delete the objects named in objPaths, S3_DELETE_BATCH to a request, with
+ * at most s3_max_connections requests in flight. Failures are reported at
+ * elevel, once every request has completed.
+ */
+void
+S3DeleteObjectList(void *s3Client, List *objPaths, int elevel)
+{
+	S3Access *s3_client = static_cast<S3Access *>(s3Client);
+	std::deque<S3AsyncDelete *> inflight;
+	Model::Delete batch;
+	int nbatch = 0;
+	char *errMsg = NULL;
+	ListCell *lc;
+
+	foreach(lc, objPaths)
+	{
+		batch.AddObjects(Model::ObjectIdentifier().WithKey(
+				static_cast<char *>(lfirst(lc))));
+		if (++nbatch == S3_DELETE_BATCH || lnext(lc) == NULL)
+		{
+			S3IssueDelete(s3_client, batch, inflight, &errMsg);
+			batch = Model::Delete();
+			nbatch = 0;
+		}
+	}
+
+	while (!inflight.empty())
+	{
+		S3FinishDelete(inflight.front(), &errMsg);
+		inflight.pop_front();
+	}
+
+	if (errMsg)
+		elog(elevel, "DeleteObjects failed with error '%s'", errMsg);
+}
+
+/*
+ * Delete every object whose name starts with prefix. Names are listed a
+ * page of S3_DELETE_BATCH at a time, and each page is removed by a single
+ * DeleteObjects request while the next one is listed, with at most
+ * s3_max_connections of them in flight. Failures are reported at elevel,
+ * once every request has completed.
+ */
+void
+S3DeletePrefix(void *s3Client, const char *prefix, int elevel)
+{
+	S3Access *s3_client = static_cast<S3Access *>(s3Client);
+	Model::ListObjectsV2Request listReq;
+	Aws::String continuationToken;
+	std::deque<S3AsyncDelete *> inflight;
+	char *errMsg = NULL;
+
+	listReq.WithBucket(default_bucket_name);
+	listReq.WithPrefix(prefix);
+	listReq.WithMaxKeys(S3_DELETE_BATCH);
+
+	do
+	{
+		Model::Delete batch;
+
+		if (!continuationToken.empty())
+			listReq.SetContinuationToken(continuationToken);
+		auto result = s3_client->cli->ListObjectsV2(listReq);
+
+		if (!result.IsSuccess())
+		{
+			if (errMsg == NULL)
+				errMsg = pstrdup(result.GetError().GetMessage().c_str());
+			break;
+		}
+
+		const Aws::Vector<Model::Object> &objList = result.GetResult().GetContents();
+
+		continuationToken = result.GetResult().GetNextContinuationToken();
+		if (objList.empty())
+			continue;
+
+		for (const Model::Object &obj : objList)
+			batch.AddObjects(Model::ObjectIdentifier().WithKey(obj.GetKey()));
+
+		S3IssueDelete(s3_client, batch, inflight, &errMsg);
+	} while (!continuationToken.empty());
+
+	while (!inflight.empty())
+	{
+		S3FinishDelete(inflight.front(), &errMsg);
+		inflight.pop_front();
+	}
+
+	if (errMsg)
+		elog(elevel, "DeleteObjects failed with error '%s', prefix %s",
+			 errMsg, prefix);
 }
 
 void
@@ -268,4 +981,12 @@ SetCofig(ClientConfiguration *conf)
 	conf->scheme = Aws::Http::Scheme::HTTP;
 	conf->verifySSL = false;
 	conf->endpointOverride = s3_url;
+	conf->maxConnections = s3_max_connections;
+	conf->connectTimeoutMs = s3_connect_timeout;
+	conf->requestTimeoutMs = s3_request_timeout;
+	conf->retryStrategy = Aws::MakeShared<S3JitterRetryStrategy>(
+			"S3RetryStrategy", s3_max_retries, s3_retry_delay);
+	/* one worker per connection, more requests queue up in the executor */
+	conf->executor = Aws::MakeShared<Aws::Utils::Threading::PooledThreadExecutor>(
+			"S3Executor", s3_max_connections);
 }
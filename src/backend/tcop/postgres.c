@@ -47,6 +47,7 @@
 #include "catalog/pg_type.h"
 #include "catalog/namespace.h"
 #include "commands/async.h"
+#include "commands/sequence.h"
 #include "commands/extension.h"
 #include "commands/prepare.h"
 #include "executor/spi.h"
@@ -1159,7 +1160,10 @@ exec_returning_command(CsQuery *csQuery)
 
 	receiver = CreateDestReceiver(dest);
 	if (dest == DestRemote)
+	{
+		cs_set_reply_format(portal);
 		SetRemoteDestReceiverParams(receiver, portal);
+	}
 
 	PushActiveSnapshot(GetTransactionSnapshot());
 	if (csQuery->cmdType == CS_CONF)
@@ -1194,7 +1198,10 @@ exec_startup_query(void)
 
 	receiver = CreateDestReceiver(dest);
 	if (dest == DestRemote)
+	{
+		cs_set_reply_format(portal);
 		SetRemoteDestReceiverParams(receiver, portal);
+	}
 
 	PushActiveSnapshot(GetTransactionSnapshot());
 	cs_get_startup_catalog(receiver);
@@ -1222,7 +1229,7 @@ exec_simple_command(CsQuery *csQuery)
 	else if (csQuery->cmdType == CS_XACT_ABORT)
 		elog(ERROR, "Report abort");
 	else if (csQuery->cmdType == CS_MODIFY_TABLE)
-		cs_modify_table((VisiNode *) csQuery->data);
+		cs_modify_table((List *) csQuery->data);
 	else
 		elog(ERROR, "Wrong xact command type");
 
@@ -3575,7 +3582,7 @@ start_xact_command(void)
 		xact_started = true;
 
 		if (!IS_CATALOG_SERVER() && GpIdentity.segindex < 0)
-			cc_xact_command(CS_XACT_START);
+			cc_xact_begin();
 	}
 
 	/*
@@ -3609,7 +3616,8 @@ finish_xact_command(void)
 	{
 		if (!IS_CATALOG_SERVER() && GpIdentity.segindex < 0)
 		{
-			cc_xact_command(CS_XACT_FINISH);
+			tile_insert_visi_flush();
+			cc_xact_end(false);
 			releaseSegmentConfigs();
 		}
 
@@ -4995,6 +5003,8 @@ cs_get_query_list(const char *sql, bool *requiresSnapsthot)
 
 			*requiresSnapsthot = analyze_requires_snapshot(parsetree);
 
+			cs_plan_cache_begin(parsetree, sql);
+
 			if (analyze_requires_snapshot(parsetree))
 			{
 				PushActiveSnapshot(GetTransactionSnapshot());
@@ -5018,7 +5028,10 @@ cs_get_query_list(const char *sql, bool *requiresSnapsthot)
 			if (list_length(stmt_list) != 1)
 				exec_simple_query(sql, false);
 			else
+			{
+				cs_plan_cache_complete(stmt_list);
 				queries = stmt_list;
+			}
 
 			if (snapshot_set)
 				PopActiveSnapshot();
@@ -5098,7 +5111,8 @@ exec_catalog_query(List *queryList, const char *sql, bool requiresSnapsthot)
 	if (requiresSnapsthot)
 		PopActiveSnapshot();
 
-	if (strcmp(commandTag, "Catalog") == 0)
+	if (strcmp(commandTag, "Catalog") == 0 ||
+		strcmp(commandTag, "CatalogDelta") == 0)
 	{
 		int			dataSize;
 		char	   *data;
@@ -5110,12 +5124,21 @@ exec_catalog_query(List *queryList, const char *sql, bool requiresSnapsthot)
 
 		receiver = CreateDestReceiver(dest);
 		if (dest == DestRemote)
+		{
+			cs_set_reply_format(portal);
 			SetRemoteDestReceiverParams(receiver, portal);
+		}
 
 		data = serializeNode((Node *) catAux, &dataSize, NULL);
 		DestReceiveBytea(data, dataSize, receiver);
 		PortalDrop(portal, false);
 		EndCommand(commandTag, dest);
+
+		if (catAux->xact_finished)
+		{
+			cs_plan_cache_release();
+			finish_xact_command();
+		}
 	}
 	else if (strcmp(commandTag, "Server") == 0)
 	{
@@ -5127,6 +5150,8 @@ exec_catalog_query(List *queryList, const char *sql, bool requiresSnapsthot)
 
 		EndCommand(commandTag, dest);
 	}
+
+	cs_plan_cache_release();
 }
 
 static void
@@ -5139,6 +5164,13 @@ cs_run_on_catalogserver(const char *sql)
 	accessHeap = false;
 	accessTile = false;
 
+	/* a repeated statement skips parsing and planning */
+	if (cs_plan_cache_lookup(sql))
+	{
+		exec_catalog_query(NIL, sql, true);
+		return;
+	}
+
 	stmt_list = cs_get_query_list(sql, &requiresSnapsthot);
 
 	runType = cs_get_run_type(stmt_list);
@@ -5531,10 +5563,11 @@ PostgresMain(int argc, char *argv[],
 			debug_query_string = NULL;
 		}
 
-		if (!IS_CATALOG_SERVER() && GpIdentity.segindex < 0 && !errorFromCatalogServer)
+		if (!IS_CATALOG_SERVER() && GpIdentity.segindex < 0)
 		{
-			cc_xact_command(CS_XACT_ABORT);
-			releaseSegmentConfigs();
+			cc_xact_end(true);
+			if (!errorFromCatalogServer)
+				releaseSegmentConfigs();
 		}
 
 
@@ -5868,11 +5901,17 @@ PostgresMain(int argc, char *argv[],
 
 				csQuery = (CsQuery *) deserializeNode(csQuerybuf, csQuerybufLen);
 
+				if (csQuery->xact_start)
+					start_xact_command();
+
 				if (csQuery->cmdType == CS_QUERY)
 				{
 					DataDispatcherClear();
 					DataDispatcherInit();
+					if (dataDispatcher)
+						dataDispatcher->catalogVersion = csQuery->catalog_version;
 					segment_count = csQuery->segment_count;
+					sequence_lease_apply((List *) csQuery->data);
 					cs_run_on_catalogserver(csQuery->query_string);
 					DataDispatcherClear();
 				}
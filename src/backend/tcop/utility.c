@@ -1409,7 +1409,8 @@ ProcessUtilitySlow(ParseState *pstate,
 												 RangeVarCallbackOwnsRelation,
 												 NULL);
 
-					if (get_rel_relam(relid) == TILE_TABLE_AM_OID)
+					if (get_rel_relam(relid) == TILE_TABLE_AM_OID &&
+						!IS_CATALOG_SERVER())
 						break;
 
 					/*
@@ -3,8 +3,11 @@
 #include "access/tileam.h"
 #include "access/xact.h"
 #include "catalog/namespace.h"
+#include "cdb/cdbhash.h"
 #include "cdb/cdbvars.h"
 #include "cdb/cdbsrlz.h"
+#include "common/hashfn.h"
+#include "lib/binaryheap.h"
 #include "utils/pickcat.h"
 #include "utils/dispatchcat.h"
 #include "utils/inval.h"
@@ -16,6 +19,15 @@ static CacheGetter		cacheGetterData;
 static CacheGetter	   *cacheGetter = NULL;
 CdbCatalogAuxNode   *cdbCatAuxNode = NULL;
 bool			isInTrigger = false;
+int				tile_block_assignment = TILE_ASSIGN_SIZE;
+
+/*
+ * Catalog tuples shipped to the compute cluster on this session since the
+ * catalog last changed, and the version the cluster holds them as.
+ */
+static HTAB	   *shippedKeyHt = NULL;
+static uint64	shippedVersion = 0;
+static uint64	shippedInvalCounter = 0;
 
 static void  TestAndCreateCtx(void);
 
@@ -264,6 +276,49 @@ DataDispatcherClear(void)
 	isInTrigger = false;
 }
 
+/*
+ * Copy the catalog tuples collected so far into ctx, for them to be added
+ * again by DataDispatcherAddTuples.
+ */
+char *
+DataDispatcherCopyCatalog(MemoryContext ctx, int *size)
+{
+	HASH_SEQ_STATUS status;
+	CatalogTableHtValue	*ht_value;
+	StringInfoData	buf;
+	MemoryContext	oldCtx;
+
+	oldCtx = MemoryContextSwitchTo(ctx);
+	initStringInfo(&buf);
+	MemoryContextSwitchTo(oldCtx);
+
+	hash_seq_init(&status, dataDispatcher->tableDataHt);
+	while ((ht_value = hash_seq_search(&status)))
+	{
+		if (ht_value->relId >= FirstNormalObjectId)
+			continue;
+
+		appendBinaryStringInfo(&buf, ht_value->stringInfo.data,
+							   ht_value->stringInfo.len);
+	}
+
+	*size = buf.len;
+	return buf.data;
+}
+
+void
+DataDispatcherAddTuples(char *data, int size)
+{
+	HeapTuple	tuple;
+	int			curIndex = 0;
+
+	if (!DataDispatcherActive())
+		return;
+
+	while ((tuple = TupleDataGetNext(data, &curIndex, size)))
+		CdbGetTupleInternal(tuple);
+}
+
 static CdbCatalogNode *
 GetCatalogNodeFromDispatcher(void)
 {
@@ -330,6 +385,86 @@ GetCatalogNode(void)
 		return GetCatalogNodeFromDispatcher();
 }
 
+/*
+ * Stamp the catalog tuples about to be sent to the compute cluster with a
+ * new version. If the cluster still holds what was shipped under the version
+ * it sent, and no invalidation has been seen since, the tuples it already
+ * has are left out and the node is marked as a delta. A changed catalog
+ * tuple is always written as a new one, so its key is never in the set.
+ */
+void
+CatalogNodeMakeDelta(CdbCatalogNode *catalog)
+{
+	ListCell   *lc;
+	ListCell   *prev = NULL;
+	ListCell   *next;
+	bool		delta;
+
+	delta = shippedKeyHt != NULL &&
+			dataDispatcher->catalogVersion == shippedVersion &&
+			LocalInvalidationCounter == shippedInvalCounter;
+
+	if (!delta)
+	{
+		HASHCTL		hashctl;
+
+		if (shippedKeyHt)
+			hash_destroy(shippedKeyHt);
+
+		MemSet(&hashctl, 0, sizeof(hashctl));
+		hashctl.keysize = sizeof(MemoryHeapKey);
+		hashctl.entrysize = sizeof(MemoryHeapKey);
+		shippedKeyHt = hash_create("shipped tuple key", 1024, &hashctl,
+								   HASH_ELEM | HASH_BLOBS);
+		shippedInvalCounter = LocalInvalidationCounter;
+	}
+
+	for (lc = list_head(catalog->tableList); lc; lc = next)
+	{
+		CatalogTableNode *tableNode = lfirst(lc);
+		StringInfoData	newData;
+		HeapTuple		tuple;
+		int				curIndex = 0;
+
+		next = lnext(lc);
+
+		if (delta)
+			initStringInfo(&newData);
+
+		while ((tuple = TupleDataGetNext(tableNode->tupleData, &curIndex,
+										 tableNode->tupleDataSize)))
+		{
+			MemoryHeapKey	memory_heap_key;
+			bool			shipped;
+
+			memory_heap_key.relId = tuple->t_tableOid;
+			memory_heap_key.ip_blkid = tuple->t_self.ip_blkid;
+			memory_heap_key.ip_posid = tuple->t_self.ip_posid;
+			hash_search(shippedKeyHt, &memory_heap_key, HASH_ENTER, &shipped);
+
+			if (delta && !shipped)
+				AddTupleToStringInfo(&newData, tuple);
+		}
+
+		if (delta)
+		{
+			if (newData.len == 0)
+			{
+				catalog->tableList = list_delete_cell(catalog->tableList, lc, prev);
+				continue;
+			}
+
+			tableNode->tupleData = newData.data;
+			tableNode->tupleDataSize = newData.len;
+		}
+
+		prev = lc;
+	}
+
+	catalog->catalog_version = ++shippedVersion;
+	catalog->catalog_delta = delta;
+}
+
 AuxNode *
 GetAuxNode(void)
 {
@@ -364,6 +499,118 @@ GetAuxNode(void)
 	return node;
 }
 
+typedef struct AuxBlock
+{
+	HeapTuple	tuple;
+	uint32		size;
+	int			segNo;
+} AuxBlock;
+
+/*
+ * The leading columns of a tile visibility tuple, the block size as int4 and
+ * the block name as name, are never null and so sit at fixed offsets. Tuples
+ * are packed back to back in the TupleData stream, so the size is copied out
+ * rather than read in place.
+ */
+static void
+AuxBlockInit(AuxBlock *block, HeapTuple tuple)
+{
+	char	   *data = (char *) tuple->t_data + tuple->t_data->t_hoff;
+	int32		size;
+
+	memcpy(&size, data, sizeof(int32));
+
+	block->tuple = tuple;
+	block->size = (uint32) size;
+	block->segNo = 0;
+}
+
+static const char *
+AuxBlockName(AuxBlock *block)
+{
+	return (char *) block->tuple->t_data + block->tuple->t_data->t_hoff +
+		sizeof(int32);
+}
+
+static int
+AuxBlockSizeCmp(const void *a, const void *b)
+{
+	const AuxBlock *ba = *(AuxBlock *const *) a;
+	const AuxBlock *bb = *(AuxBlock *const *) b;
+
+	if (ba->size != bb->size)
+		return ba->size > bb->size ? -1 : 1;
+	return 0;
+}
+
+/* the least loaded segment first, the lower one on ties */
+static int
+SegmentLoadCmp(Datum a, Datum b, void *arg)
+{
+	uint64	   *loads = (uint64 *) arg;
+	int			sa = DatumGetInt32(a);
+	int			sb = DatumGetInt32(b);
+
+	if (loads[sa] != loads[sb])
+		return loads[sa] < loads[sb] ? 1 : -1;
+	return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+/*
+ * Spread the blocks of a tile table over the segments, see
+ * tile_block_assignment. Blocks are balanced by stored size, largest first,
+ * each going to the segment with the least bytes so far. In hash mode a
+ * block goes to the segment its name hashes to, so that repeated scans find
+ * it in the same host-local cache.
+ */
+static void
+AssignAuxBlocks(AuxBlock *blocks, int nblocks, int gangSize)
+{
+	AuxBlock  **sorted;
+	uint64	   *loads;
+	binaryheap *heap;
+	int			i;
+
+	if (tile_block_assignment == TILE_ASSIGN_HASH)
+	{
+		for (i = 0; i < nblocks; i++)
+		{
+			const char *name = AuxBlockName(&blocks[i]);
+			uint32		hash;
+
+			hash = DatumGetUInt32(hash_any((const unsigned char *) name,
+										   strnlen(name, NAMEDATALEN)));
+			blocks[i].segNo = jump_consistent_hash(hash, gangSize);
+		}
+		return;
+	}
+
+	sorted = palloc(sizeof(AuxBlock *) * nblocks);
+	for (i = 0; i < nblocks; i++)
+		sorted[i] = &blocks[i];
+	qsort(sorted, nblocks, sizeof(AuxBlock *), AuxBlockSizeCmp);
+
+	loads = palloc0(sizeof(uint64) * gangSize);
+	heap = binaryheap_allocate(gangSize, SegmentLoadCmp, loads);
+	for (i = 0; i < gangSize; i++)
+		binaryheap_add_unordered(heap, Int32GetDatum(i));
+	binaryheap_build(heap);
+
+	for (i = 0; i < nblocks; i++)
+	{
+		int			segNo = DatumGetInt32(binaryheap_first(heap));
+
+		sorted[i]->segNo = segNo;
+		/* empty blocks still cost a request */
+		loads[segNo] += Max(sorted[i]->size, 1);
+		binaryheap_replace_first(heap, Int32GetDatum(segNo));
+	}
+
+	binaryheap_free(heap);
+	pfree(loads);
+	pfree(sorted);
+}
+
 AuxNode **
 GetAuxNodeArray(int gangSize)
 {
@@ -388,7 +635,9 @@ GetAuxNodeArray(int gangSize)
 		HeapTuple			tuple;
 		int					curIndex;
 		StringInfoData	   *stringInfoArray;
-		uint32				segNo;
+		AuxBlock		   *blocks;
+		int					nblocks;
+		int					maxblocks;
 
 		stringInfoArray = palloc(sizeof(StringInfoData) * gangSize);
 		for (i = 0; i < gangSize; ++i)
@@ -396,14 +645,29 @@ GetAuxNodeArray(int gangSize)
 
 		tableNode = lfirst(lc);
 
-		segNo = 0;
+		maxblocks = 64;
+		blocks = palloc(sizeof(AuxBlock) * maxblocks);
+		nblocks = 0;
 		curIndex = 0;
 		while ((tuple = TupleDataGetNext(tableNode->tupleData, &curIndex,
 				tableNode->tupleDataSize)) != NULL)
 		{
-			AddTupleToStringInfo(&stringInfoArray[segNo++%gangSize], tuple);
+			if (nblocks == maxblocks)
+			{
+				maxblocks *= 2;
+				blocks = repalloc(blocks, sizeof(AuxBlock) * maxblocks);
+			}
+			AuxBlockInit(&blocks[nblocks++], tuple);
 		}
 
+		AssignAuxBlocks(blocks, nblocks, gangSize);
+
+		/* each segment still reads its blocks in visibility relation order */
+		for (i = 0; i < nblocks; i++)
+			AddTupleToStringInfo(&stringInfoArray[blocks[i].segNo],
+								 blocks[i].tuple);
+		pfree(blocks);
+
 		for (i = 0; i < gangSize; ++i)
 		{
 			CatalogTableNode *tableNodeSeg;
@@ -227,6 +227,15 @@ static struct RELCACHECALLBACK
 
 static int	relcache_callback_count = 0;
 
+/*
+ * Number of invalidation messages applied to the local caches, including
+ * those of our own transactions, which SharedInvalidMessageCounter does not
+ * see. Messages for other databases, and smgr messages, are not counted.
+ * The catalog server compares it to tell whether catalog tuples it has
+ * shipped to a compute cluster may have changed since.
+ */
+uint64		LocalInvalidationCounter = 0;
+
 /* ----------------------------------------------------------------
  *				Invalidation list support functions
  *
@@ -576,6 +585,8 @@ LocalExecuteInvalidationMessage(SharedInvalidationMessage *msg)
 	{
 		if (msg->cc.dbId == MyDatabaseId || msg->cc.dbId == InvalidOid)
 		{
+			LocalInvalidationCounter++;
+
 			InvalidateCatalogSnapshot();
 
 			SysCacheInvalidate(msg->cc.id, msg->cc.hashValue);
@@ -587,6 +598,8 @@ LocalExecuteInvalidationMessage(SharedInvalidationMessage *msg)
 	{
 		if (msg->cat.dbId == MyDatabaseId || msg->cat.dbId == InvalidOid)
 		{
+			LocalInvalidationCounter++;
+
 			InvalidateCatalogSnapshot();
 
 			CatalogCacheFlushCatalog(msg->cat.catId);
@@ -600,6 +613,8 @@ LocalExecuteInvalidationMessage(SharedInvalidationMessage *msg)
 		{
 			int			i;
 
+			LocalInvalidationCounter++;
+
 			if (msg->rc.relId == InvalidOid)
 				RelationCacheInvalidate(false);
 			else
@@ -629,17 +644,29 @@ LocalExecuteInvalidationMessage(SharedInvalidationMessage *msg)
 	{
 		/* We only care about our own database and shared catalogs */
 		if (msg->rm.dbId == InvalidOid)
+		{
+			LocalInvalidationCounter++;
 			RelationMapInvalidate(true);
+		}
 		else if (msg->rm.dbId == MyDatabaseId)
+		{
+			LocalInvalidationCounter++;
 			RelationMapInvalidate(false);
+		}
 	}
 	else if (msg->id == SHAREDINVALSNAPSHOT_ID)
 	{
 		/* We only care about our own database and shared catalogs */
 		if (msg->sn.dbId == InvalidOid)
+		{
+			LocalInvalidationCounter++;
 			InvalidateCatalogSnapshot();
+		}
 		else if (msg->sn.dbId == MyDatabaseId)
+		{
+			LocalInvalidationCounter++;
 			InvalidateCatalogSnapshot();
+		}
 	}
 	else
 		elog(FATAL, "unrecognized SI message ID: %d", msg->id);
@@ -667,6 +694,8 @@ InvalidateSystemCachesExtended(bool debug_discard)
 {
 	int			i;
 
+	LocalInvalidationCounter++;
+
 	InvalidateCatalogSnapshot();
 	ResetCatalogCaches();
 	RelationCacheInvalidate(debug_discard); /* gets smgr and relmap too */
@@ -176,7 +176,7 @@ PickModifyRelation(ResultRelInfo *info)
 	}
 
 	PickRelation(info->ri_RelationDesc);
-	table_scan_prepare_dispatch(info->ri_RelationDesc, NULL);
+	table_scan_prepare_dispatch(info->ri_RelationDesc, NULL, NIL);
 }
 
 void
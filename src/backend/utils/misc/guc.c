@@ -35,6 +35,7 @@
 #include "access/gin.h"
 #include "access/rmgr.h"
 #include "access/tableam.h"
+#include "access/tileam.h"
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
@@ -44,6 +45,7 @@
 #include "cdb/cdbcatalogfunc.h"
 #include "commands/async.h"
 #include "commands/prepare.h"
+#include "commands/sequence.h"
 #include "commands/tablespace.h"
 #include "commands/user.h"
 #include "commands/vacuum.h"
@@ -358,6 +360,24 @@ static const struct config_enum_entry xmlbinary_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry tile_block_assignment_options[] = {
+	{"size", TILE_ASSIGN_SIZE, false},
+	{"hash", TILE_ASSIGN_HASH, false},
+	{"dynamic", TILE_ASSIGN_DYNAMIC, false},
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry tile_compresstype_options[] = {
+	{"none", TILE_COMPRESS_NONE, false},
+#ifdef HAVE_LIBZ
+	{"zlib", TILE_COMPRESS_ZLIB, false},
+#endif
+#ifdef USE_ZSTD
+	{"zstd", TILE_COMPRESS_ZSTD, false},
+#endif
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry xmloption_options[] = {
 	{"content", XMLOPTION_CONTENT, false},
 	{"document", XMLOPTION_DOCUMENT, false},
@@ -2030,6 +2050,16 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"catalog_server_early_commit", PGC_SIGHUP, QUERY_TUNING_OTHER,
+			gettext_noop("Commits read-only implicit transactions on the catalog server together with the catalog reply."),
+			gettext_noop("Tile blocks a running query reads may then be deleted by a concurrent DROP, TRUNCATE or VACUUM.")
+		},
+		&catalog_server_early_commit,
+		false,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, false, NULL, NULL, NULL
@@ -3295,6 +3325,135 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"tile_prefetch_blocks", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the number of tile blocks a sequential scan reads ahead."),
+			gettext_noop("Each block read ahead holds one tile block buffer in memory. "
+						 "Zero disables read-ahead.")
+		},
+		&tile_prefetch_blocks,
+		4, 0, 64,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"tile_upload_parts", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the number of tile block upload parts a backend keeps in flight."),
+			gettext_noop("Blocks are uploaded in the background while the next one is "
+						 "filled. Each part in flight holds up to 5MB of block data in memory.")
+		},
+		&tile_upload_parts,
+		4, 1, 64,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"tile_merge_threshold", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the fill percentage below which VACUUM merges tile blocks."),
+			gettext_noop("Blocks whose tuples take up less than this percentage of a "
+						 "full block are merged together. Zero disables merging.")
+		},
+		&tile_merge_threshold,
+		50, 0, 100,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"s3_max_connections", PGC_BACKEND, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the number of connections a backend opens to the S3 server."),
+			gettext_noop("Asynchronous requests run on as many worker threads, "
+						 "further requests wait for one of them.")
+		},
+		&s3_max_connections,
+		25, 1, 1024,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"s3_connect_timeout", PGC_BACKEND, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum time to wait for a connection to the S3 server."),
+			NULL,
+			GUC_UNIT_MS
+		},
+		&s3_connect_timeout,
+		1000, 1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"s3_request_timeout", PGC_BACKEND, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum time an S3 request may go without receiving data."),
+			NULL,
+			GUC_UNIT_MS
+		},
+		&s3_request_timeout,
+		3000, 1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"s3_max_retries", PGC_BACKEND, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the number of times a failed S3 request is retried."),
+			NULL
+		},
+		&s3_max_retries,
+		10, 0, 100,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"s3_retry_delay", PGC_BACKEND, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the base delay before retrying a failed S3 request."),
+			gettext_noop("Each retry waits a random time up to this delay doubled "
+						 "once per previous attempt."),
+			GUC_UNIT_MS
+		},
+		&s3_retry_delay,
+		25, 1, 10000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"tile_compresslevel", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the compression level used for new tile blocks."),
+			NULL
+		},
+		&tile_compresslevel,
+		1, 1, 19,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"tile_cache_size", PGC_POSTMASTER, RESOURCES_DISK,
+			gettext_noop("Sets the size of the local cache of tile objects."),
+			gettext_noop("Zero disables the cache."),
+			GUC_UNIT_MB
+		},
+		&tile_cache_size,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"catalog_plan_cache_size", PGC_SIGHUP, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of statement plans the catalog server keeps."),
+			gettext_noop("Zero disables the cache.")
+		},
+		&catalog_plan_cache_size,
+		256, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"catalog_sequence_lease_max", PGC_SIGHUP, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the most sequence values a compute cluster leases from the catalog server at once."),
+			gettext_noop("Leases grow up to this size while nextval() is called at a high rate.")
+		},
+		&catalog_sequence_lease_max,
+		1024, 1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, 0, 0, 0, NULL, NULL, NULL
@@ -4358,6 +4517,30 @@ static struct config_string ConfigureNamesString[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"tile_cache_directory", PGC_POSTMASTER, FILE_LOCATIONS,
+			gettext_noop("Sets the directory holding the local cache of tile objects."),
+			gettext_noop("A relative path is taken relative to the data directory. "
+						 "The directory is emptied at server start.")
+		},
+		&tile_cache_directory,
+		"pg_tilecache",
+		NULL, NULL, NULL
+	},
+
+	{
+		{"tile_sort_key", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the column rows inserted into tile tables are sorted by."),
+			gettext_noop("Rows are sorted up to maintenance_work_mem at a time, so that the zone maps "
+						 "of the blocks written cover narrow ranges of the column. Tables "
+						 "without such a column, or with indexes or triggers, are not sorted. "
+						 "An empty string disables sorting.")
+		},
+		&tile_sort_key,
+		"",
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, NULL, NULL, NULL, NULL
@@ -4708,6 +4891,28 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"tile_compresstype", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the compression used for the column chunks of new tile blocks."),
+			NULL
+		},
+		&tile_compresstype,
+		TILE_COMPRESS_DEFAULT, tile_compresstype_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"tile_block_assignment", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets how the blocks of a tile scan are spread over the segments."),
+			gettext_noop("\"size\" balances the stored bytes, \"hash\" keeps each block "
+						 "on the same segment from run to run, \"dynamic\" lets the "
+						 "segments of a sequential scan claim blocks as they go.")
+		},
+		&tile_block_assignment,
+		TILE_ASSIGN_SIZE, tile_block_assignment_options,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, 0, NULL, NULL, NULL, NULL
@@ -4749,6 +4954,13 @@ static bool reporting_enabled;	/* true to enable GUC_REPORT */
 
 static int	GUCNestLevel = 0;	/* 1 when in main transaction */
 
+/*
+ * Number of times a setting has been given a new value, including values
+ * restored at transaction or function exit. The catalog server compares it
+ * to tell whether a cached plan may have been built under other settings.
+ */
+uint64		GUCChangeCounter = 0;
+
 
 static int	guc_var_compare(const void *a, const void *b);
 static void InitializeGUCOptionsFromEnvironment(void);
@@ -6265,6 +6477,9 @@ AtEOXact_GUC(bool isCommit, int nestLevel)
 			gconf->stack = prev;
 			pfree(stack);
 
+			if (changed)
+				GUCChangeCounter++;
+
 			/* Report new value if we changed it */
 			if (changed && (gconf->flags & GUC_REPORT))
 				ReportGUCOption(gconf);
@@ -7353,6 +7568,7 @@ set_config_option(const char *name, const char *value,
 									newextra);
 					conf->gen.source = source;
 					conf->gen.scontext = context;
+					GUCChangeCounter++;
 				}
 				if (makeDefault)
 				{
@@ -7447,6 +7663,7 @@ set_config_option(const char *name, const char *value,
 									newextra);
 					conf->gen.source = source;
 					conf->gen.scontext = context;
+					GUCChangeCounter++;
 				}
 				if (makeDefault)
 				{
@@ -7541,6 +7758,7 @@ set_config_option(const char *name, const char *value,
 									newextra);
 					conf->gen.source = source;
 					conf->gen.scontext = context;
+					GUCChangeCounter++;
 				}
 				if (makeDefault)
 				{
@@ -7661,6 +7879,7 @@ set_config_option(const char *name, const char *value,
 									newextra);
 					conf->gen.source = source;
 					conf->gen.scontext = context;
+					GUCChangeCounter++;
 				}
 
 				if (makeDefault)
@@ -7760,6 +7979,7 @@ set_config_option(const char *name, const char *value,
 									newextra);
 					conf->gen.source = source;
 					conf->gen.scontext = context;
+					GUCChangeCounter++;
 				}
 				if (makeDefault)
 				{
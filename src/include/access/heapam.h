@@ -106,7 +106,8 @@ typedef enum
  *		True iff the heap scan is valid.
  */
 #define HeapScanIsValid(scan) PointerIsValid(scan)
-extern void heap_scan_scan_prepare_dispatch(Relation rel, Snapshot snapshot);
+extern void heap_scan_scan_prepare_dispatch(Relation rel, Snapshot snapshot,
+											List *qual);
 extern TableScanDesc heap_beginscan(Relation relation, Snapshot snapshot,
 									int nkeys, ScanKey key,
 									ParallelTableScanDesc parallel_scan,
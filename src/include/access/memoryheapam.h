@@ -3,6 +3,8 @@
 
 #include "executor/tuptable.h"
 
+typedef struct MemoryHeapIndexEntry MemoryHeapIndexEntry;
+
 typedef struct MemoryHeapDescData
 {
 	TableScanDescData rs_base;
@@ -10,6 +12,11 @@ typedef struct MemoryHeapDescData
 	int			tupleDataSize;
 	char	   *tupleData;
 	int			curIndex;
+
+	/* index entries left to visit, when a scan key is served by an index */
+	MemoryHeapIndexEntry *idxEntries;
+	int			idxCur;
+	int			idxEnd;
 } MemoryHeapDescData;
 
 typedef MemoryHeapDescData *MemoryHeapDesc;
@@ -34,5 +41,7 @@ extern char *initCatalogBuf;
 extern int initCatalogBufSize;
 
 extern uint64 MemoryHeapGetFullXid(void);
+extern uint64 MemoryHeapGetCatalogVersion(void);
+extern MemoryContext MemoryHeapDeltaContext(void);
 
 #endif //MEMORYHEAPAM_H
@@ -205,7 +205,12 @@ typedef struct TableAmRoutine
 	 */
 	const TupleTableSlotOps *(*slot_callbacks) (Relation rel);
 
-	void (*scan_prepare_dispatch) (Relation rel, Snapshot snapshot);
+	/*
+	 * Collect what the catalog server must ship for a scan of rel. qual is
+	 * the scan's implicitly ANDed qual list, or NIL, and may be used to leave
+	 * out data that cannot match.
+	 */
+	void (*scan_prepare_dispatch) (Relation rel, Snapshot snapshot, List *qual);
 
 	/* ------------------------------------------------------------------------
 	 * Table scan callbacks.
@@ -850,10 +855,10 @@ extern TupleTableSlot *table_slot_create(Relation rel, List **reglist);
  */
 
 static inline void
-table_scan_prepare_dispatch(Relation rel, Snapshot snapshot)
+table_scan_prepare_dispatch(Relation rel, Snapshot snapshot, List *qual)
 {
 	if (rel->rd_tableam && rel->rd_tableam->scan_prepare_dispatch)
-		rel->rd_tableam->scan_prepare_dispatch(rel, snapshot);
+		rel->rd_tableam->scan_prepare_dispatch(rel, snapshot, qual);
 }
 
 /*
@@ -2,12 +2,93 @@
 #define TILEAM_H
 
 #include "access/heapam.h"
+#include "access/relscan.h"
 #include "access/tableam.h"
+#include "port/atomics.h"
 
 #define TILE_BLOCK_SIZE (16*1024*1024)
 #define TILE_PATH_SIZE 40
 #define TILE_KEY_SIZE 16
 
+/*
+ * Columnar on-object layout of a tile block, see tileblock.c.
+ */
+#define TILE_BLOCK_MAGIC 0x454C4954	/* "TILE" */
+#define TILE_BLOCK_VERSION 1
+
+typedef struct TileBlockHeader
+{
+	uint32 magic;
+	uint16 version;
+	uint16 natts;
+	uint32 ntuples;
+	uint32 headerSize;	// header plus chunk directory
+} TileBlockHeader;
+
+typedef struct TileChunkDesc
+{
+	uint32 offset;		// from the start of the object
+	uint32 size;		// stored size
+	uint32 rawSize;		// size after decompression
+	uint8 compressType;
+	uint8 pad[3];
+} TileChunkDesc;
+
+#define TILE_BLOCK_HEADER_SIZE(natts) \
+	(sizeof(TileBlockHeader) + (natts) * sizeof(TileChunkDesc))
+
+/*
+ * Blocks stored row by row end with the offset of every tuple, followed by
+ * this trailer, so that tuples can be located without walking the block.
+ */
+#define TILE_TRAILER_MAGIC 0x52544954	/* "TITR" */
+
+typedef struct TileBlockTrailer
+{
+	uint32 ntuples;
+	uint32 magic;
+} TileBlockTrailer;
+
+/* upper bound of the tuples a block can hold, to size offset arrays */
+#define TILE_MAX_TUPLES (TILE_BLOCK_SIZE / MAXALIGN(SizeofMinimalTupleHeader))
+
+typedef struct TileBlockRange
+{
+	uint32 offset;
+	uint32 length;
+} TileBlockRange;
+
+/* how the blocks of a scan are spread over the segments, see GetAuxNodeArray */
+typedef enum TileBlockAssignment
+{
+	TILE_ASSIGN_SIZE,		// balance the stored bytes
+	TILE_ASSIGN_HASH,		// by block name, for cache affinity
+	TILE_ASSIGN_DYNAMIC		// sequential scans claim blocks from the QD
+} TileBlockAssignment;
+
+/* message type of the QD's reply to a tile claim, see tile_claim_blocks */
+#define TILE_CLAIM_RESPONSE '&'
+
+typedef enum TileCompressType
+{
+	TILE_COMPRESS_NONE,
+	TILE_COMPRESS_ZLIB,
+	TILE_COMPRESS_ZSTD
+} TileCompressType;
+
+/*
+ * Per-block column summaries kept in the visibility relation, see
+ * tilezonemap.c. Visibility relations created before the column existed
+ * have only the first three attributes.
+ */
+#define TILE_VISI_ZONEMAP_ATTNUM 4
+
+#ifdef USE_ZSTD
+#define TILE_COMPRESS_DEFAULT TILE_COMPRESS_ZSTD
+#else
+#define TILE_COMPRESS_DEFAULT TILE_COMPRESS_NONE
+#endif
+
 typedef struct TileKey
 {
 	uint64 tid;
@@ -20,16 +101,17 @@ typedef struct TileBuf
 	TileKey key;
 	char *bufStartPtr;  //starting point
 	uint32 bufSize;
+	uint32 *tupleOffsets;  // where each tuple starts in bufStartPtr
+	uint32 tupleNum;
 } TileBuf;
 
 typedef struct TileFetchDescData
 {
 	Relation mainRel;
 	Relation visibilityRel;
+	Oid visiRelid;
 	TileBuf *buffer;
 	bool	bufferShouldFree;
-	uint32 bufferCurPtrTupNum;
-	uint32 bufferCurPtrDiff;  //current point
 } TileFetchDescData;
 
 typedef TileFetchDescData *TileFetchDesc;
@@ -52,8 +134,26 @@ typedef struct BlockDesc2
 	TileKey	newKey;
 	uint32			block_size;
 	uint32			block_tuple_num;
+	bytea		   *zonemap;
 } BlockDesc2;
 
+/*
+ * One slot of the scan's read-ahead ring. A slot either holds a block that
+ * has been read, or has asynchronous GETs streaming into it: one for the
+ * whole object, or one per range of chunks when the scan is projected. The
+ * ranges of a projected block are known once its header has been read.
+ */
+typedef struct TilePrefetchBuf
+{
+	int		pageIdx;	// index into visiInfo, -1 when the slot is unused
+	void   *header;		// in-flight GET of the block header, or NULL
+	uint32	headerLen;
+	List   *requests;	// in-flight S3 requests, NIL once the data is here
+	List   *cacheFill;	// TileBlockRanges to add to the local cache once read
+	char   *data;
+	uint32	dataLen;
+} TilePrefetchBuf;
+
 typedef struct TileScanDescData
 {
 	TableScanDescData rs_base;
@@ -64,25 +164,62 @@ typedef struct TileScanDescData
 	List *visiInfo;
 	uint32 curPageIdx; // the next blockno to be read, starting from zero
 	HTSV_Result cur_buf_block_vacuum_status;
-	char *bufTupleLenArr;
-	char *bufTupleLenArrPtr;
+	uint32 *tupleOffsets;	// where each tuple starts in buffer
 	uint32 bufTupleNum;
 	uint32 blockid;
 	TileKey key;
 	uint32 seq;
-	char *tuple;
 	MemoryContext scanCtx;
+	char *bucketPath;
+	TilePrefetchBuf *ring;
+	int ringSize;
+	bool *proj;			// attributes the scan needs, NULL for all
+	char *rowBuffer;	// decoded tuples of a columnar block
+	uint32 *claimedPages;	// parallel scan: blocks taken but not yet reached
+	int nclaimedPages;
+	List *zoneKeys;		// to skip blocks by their zone maps
+	bool dynamic;		// blocks are claimed from the QD while scanning
+	bool claimsDone;	// the QD has no more blocks for a dynamic scan
+	int planNodeId;		// tells the dynamic scans of a slice apart
+	SubTransactionId subid;	// subtransaction the scan was started in
 } TileScanDescData;
 
 typedef TileScanDescData *TileScanDesc;
 
+/*
+ * Shared state of a parallel tile scan. Every participant lists the same
+ * blocks, and takes the next one to read from a shared cursor into them.
+ */
+typedef struct ParallelTileScanDescData
+{
+	ParallelTableScanDescData base;
+	pg_atomic_uint32 nextPageIdx;
+} ParallelTileScanDescData;
+
+typedef ParallelTileScanDescData *ParallelTileScanDesc;
+
 extern void *s3Client;
 
+/* GUC */
+extern int tile_prefetch_blocks;
+extern int tile_upload_parts;
+extern int tile_merge_threshold;
+extern char *tile_sort_key;
+extern int tile_compresstype;
+extern int tile_compresslevel;
+extern int tile_cache_size;
+extern char *tile_cache_directory;
+extern int tile_block_assignment;
+
 typedef struct VisiNode VisiNode;
 
 extern void tile_insert_visi_notify(char *message);
+extern void tile_insert_visi_flush(void);
 extern void tile_insert_visi_cs(VisiNode *visiNode);
 
+extern void tile_scan_set_plan_node(TableScanDesc sscan, int planNodeId);
+extern char *tile_claim_next(const char *message, int32 *ntuples, int *len);
+
 
 extern void tile_clear_table(RelFileNode rd_node);
 extern void tile_clear_db(Oid spcNode, Oid dbNode);
@@ -102,8 +239,7 @@ extern bool blockkey_is_valid(TileKey key);
 extern bool blockkey_equal(TileKey key1, TileKey key2);
 extern uint32 tile_tid_get_seq(ItemPointer tid);
 extern uint32 tile_tid_get_blockid(ItemPointerData tid);
-extern ItemPointerData blockid_seq_get_tile_tid(uint32 blockid, uint32 seq,
-												 TileKey key);
+extern ItemPointerData blockid_seq_get_tile_tid(uint32 blockid, uint32 seq);
 extern ItemPointerData blockid_to_heaptid(uint32 blockid);
 extern uint32 heaptid_to_blockid(ItemPointerData tid);
 extern char *GetBlockNameFromKey(TileKey key);
@@ -111,4 +247,31 @@ extern TileKey GetBlockKeyFromBlockName(char *blockname);
 extern char *TileMakeBucketPath(RelFileNode relFileNode);
 extern char *TileMakeDbPrefix(Oid spcNode, Oid dbNode);
 
+extern bool tile_block_is_columnar(char *data, uint32 dataLen);
+extern char *tile_block_encode(TupleDesc tupdesc, char *rows, uint32 rowsLen,
+							   uint32 ntuples, uint32 *encodedLen,
+							   bytea **zonemap);
+extern int tile_block_ranges(char *block, bool *proj, int natts,
+							 TileBlockRange *ranges);
+extern uint32 tile_block_decode(TupleDesc tupdesc, char *block, bool *proj,
+								char *rows, uint32 *offsets);
+extern uint32 tile_block_row_offsets(char *rows, uint32 *rowsLen,
+									 uint32 *offsets);
+extern uint32 tile_block_ntuples(char *block);
+extern bool tile_block_chunk(char *block, int attno, TileBlockRange *range);
+
+extern bytea *tile_zonemap_build(TupleDesc tupdesc, Datum *values, bool *isnull,
+								 uint32 ntuples);
+extern List *tile_zonemap_keys(Relation rel, List *qual);
+extern bool tile_zonemap_skip(bytea *zonemap, List *keys);
+
+extern Size TileCacheShmemSize(void);
+extern void TileCacheShmemInit(void);
+extern int32 tile_cache_read(const char *bucketPath, const char *blockName,
+							 uint32 offset, uint32 length, char *data);
+extern void tile_cache_insert(const char *bucketPath, const char *blockName,
+							  uint32 offset, uint32 length, char *data,
+							  uint32 size);
+extern void tile_cache_drop(const char *prefix);
+
 #endif //TILEAM_H
@@ -14,4 +14,5 @@ typedef FormData_pg_tile *Form_pg_tile;
 extern void PgTileInsert(Oid mainRelid, Oid visiRelid);
 extern void CreateTileVisiTable(Relation main_rel);
 extern Oid PgTileGetVisiRelId(Oid mainRelId);
+extern Oid PgTileGetMainRelId(Oid visiRelId);
 #endif // PG_TILE_H
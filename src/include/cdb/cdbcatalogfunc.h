@@ -5,6 +5,7 @@
 #include "access/tileam.h"
 #include "nodes/plannodes.h"
 #include "tcop/utility.h"
+#include "utils/portal.h"
 
 typedef enum CsType
 {
@@ -35,6 +36,8 @@ typedef struct CsQuery
 	Node *data;
 	int	cluster_id;
 	int segment_count;
+	uint64 catalog_version;	/* of the catalog tuples we hold, 0 for none */
+	bool xact_start;		/* start a transaction before running this */
 } CsQuery;
 
 typedef struct NextValNode
@@ -42,6 +45,7 @@ typedef struct NextValNode
 	NodeTag	type;
 	
 	Oid		relid;
+	int64	nvalues;	/* values the compute QD wants to lease */
 	int64	plast;
 	int64	pcached;
 	int64	pincrement;
@@ -57,6 +61,8 @@ extern PGconn	*csConn;
 extern bool errorFromCatalogServer;
 extern char *cs_port;
 extern char *cs_host_name;
+extern int catalog_plan_cache_size;
+extern bool catalog_server_early_commit;
 
 typedef struct CdbCatalogAuxNode CdbCatalogAuxNode;
 
@@ -67,18 +73,22 @@ extern CdbCatalogAuxNode *cc_get_catalog(const char *sql, MemoryContext ctx);
 extern void cc_conn(char *dbname);
 extern void cc_finish(void);
 extern void cc_xact_command(CsType csType);
-extern void cc_send_modify_tabble(VisiNode  *visiNode);
-extern void cc_next_val(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement,
-						bool *poverflow);
+extern void cc_xact_begin(void);
+extern void cc_xact_end(bool isAbort);
+extern void cc_send_modify_tabble(List *visiNodes);
+extern void cc_next_val(Oid relid, int64 nvalues, int64 *plast, int64 *pcached,
+						int64 *pincrement, bool *poverflow);
 extern bytea *cc_get_conf(char *file);
 extern void cc_run_on_catalog_server(const char *sql);
 extern bytea *cc_get_returning(PGresult *res);
+extern Node *cc_get_returning_node(PGresult *res);
 extern void cc_pass_returning(PGresult *res);
 extern PGresult *cc_exec_plan(CsQuery *csQuery);
 extern char *cc_status(PGresult *res);
 
 extern CdbCatalogAuxNode *cc_catalog_or_run(const char *sql);
 extern void DestReceiveBytea(char *data, int dataSize, DestReceiver *dest);
+extern void cs_set_reply_format(Portal portal);
 
 /*
  * Catalog server side
@@ -87,9 +97,14 @@ extern CdbCatalogAuxNode *cs_get_catalog_from_sql(List *queryList, const char *s
 												  char *command);
 extern PlannedStmt *get_catalog_from_query(List *queries, const char *sql);
 extern void cs_get_startup_catalog(DestReceiver *dest);
-extern void cs_modify_table(VisiNode *visiNode);
+extern void cs_modify_table(List *visiNodes);
 extern void cs_next_val(NextValNode *nextVal, DestReceiver *dest);
 extern void cs_get_conf(const char *path, DestReceiver *dest);
+extern bool cs_plan_cache_lookup(const char *sql);
+extern void cs_plan_cache_begin(RawStmt *parsetree, const char *sql);
+extern void cs_plan_cache_complete(List *queries);
+extern void cs_plan_cache_release(void);
+extern void cs_plan_cache_reset(void);
 
 
 #endif //CDBCATALOGFUNC_H
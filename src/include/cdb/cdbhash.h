@@ -72,6 +72,11 @@ extern unsigned int cdbhashreduce(CdbHash *h);
  */
 extern unsigned int cdbhashrandomseg(int numsegs);
 
+/*
+ * Map a 64-bit key to a segment, moving few keys when numsegs changes.
+ */
+extern int32 jump_consistent_hash(uint64 key, int32 num_segments);
+
 /*
  * Catalog lookup functions related to distribution keys and hash opclasses.
  */
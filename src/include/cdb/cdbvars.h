@@ -780,5 +780,6 @@ extern const char * lookup_autostats_mode_by_value(GpAutoStatsModeValue val);
 #define CDB_NOTIFY_ENDPOINT_ACK "ack_notify"
 
 #define CDB_NOTIFY_TILE "tile_notify"
+#define CDB_NOTIFY_TILE_CLAIM "tile_claim"
 
 #endif   /* CDBVARS_H */
@@ -65,11 +65,17 @@ typedef struct xl_seq_rec
 	/* SEQUENCE TUPLE DATA FOLLOWS AT THE END */
 } xl_seq_rec;
 
+extern int	catalog_sequence_lease_max;
+
 extern int64 nextval_internal(Oid relid, bool check_permissions, bool called_from_dispatcher);
 extern int64 fdb_nextval_internal(Oid relid, bool check_permissions);
 extern Datum nextval(PG_FUNCTION_ARGS);
 extern void nextval_qd(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement, bool *poverflow);
-extern void nextval_cs(Oid relid, int64 *plast, int64 *pcached, int64  *pincrement, bool *poverflow);
+extern void nextval_cs(Oid relid, int64 nvalues, int64 *plast, int64 *pcached,
+					   int64 *pincrement, bool *poverflow);
+extern List *sequence_lease_report(void);
+extern void sequence_lease_apply(List *report);
+extern void sequence_lease_drop(void);
 extern List *sequence_options(Oid relid);
 
 extern ObjectAddress DefineSequence(ParseState *pstate, CreateSeqStmt *stmt);
@@ -36,9 +36,7 @@
 typedef struct ItemPointerData
 {
 	BlockIdData ip_blkid;
-    OffsetNumber ip_posid;
-	uint64		xid;
-	uint64		seq;
+	OffsetNumber ip_posid;
 }
 
 /* If compiler understands packed and aligned pragmas, use those */
@@ -50,8 +48,6 @@ ItemPointerData;
 
 typedef ItemPointerData *ItemPointer;
 
-#define ItemPointerMaxSeq		0xffffffffffffffff
-
 /* ----------------
  *		special values used in heap tuples (t_ctid)
  * ----------------
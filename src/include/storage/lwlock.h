@@ -223,6 +223,7 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_PARALLEL_APPEND,
 	LWTRANCHE_SXACT,
 	LWTRANCHE_DISTRIBUTEDLOG_BUFFERS,
+	LWTRANCHE_TILE_CACHE,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
@@ -10,6 +10,7 @@ extern "C" {
 typedef struct S3Objs
 {
 	List *objPathList;
+	List *objSizeList;	/* size of each object, in the same order */
 } S3Objs;
 
 typedef struct S3ObjKey
@@ -36,6 +37,13 @@ extern char default_bucket_name[NAMEDATALEN];
 extern char *s3_url;
 extern char s3_url_data[];
 
+/* GUC */
+extern int s3_max_connections;
+extern int s3_connect_timeout;
+extern int s3_request_timeout;
+extern int s3_max_retries;
+extern int s3_retry_delay;
+
 extern void *S3InitAccess();
 extern void S3DestroyAccess(void *s3Client);
 extern void S3CreateBucket(void *s3Client, const char *bucketPath);
@@ -44,8 +52,28 @@ extern S3Objs S3DeleteObjects(void *s3Client, const char *prefix);
 extern S3Obj S3GetObject(void *s3Client, S3ObjKey s3_obj_key);
 extern uint32 S3GetObject2(void *s3Client, const char *bucketPath,
 							   const char *objPath, char *data);
+extern void *S3GetObjectAsync(void *s3Client, const char *bucketPath,
+							  const char *objPath, char *data, uint32 capacity);
+extern void *S3GetObjectRangeAsync(void *s3Client, const char *bucketPath,
+								   const char *objPath, uint32 offset,
+								   uint32 length, char *data);
+extern uint32 S3GetObjectRange(void *s3Client, const char *bucketPath,
+							   const char *objPath, uint32 offset,
+							   uint32 length, char *data);
+extern bool S3GetObjectDone(void *asyncGet);
+extern uint32 S3GetObjectWait(void *asyncGet);
+extern void S3GetObjectCancel(void *asyncGet);
+extern void S3GetObjectCancelAll(void);
 extern void S3PutObject(void *s3Client, S3ObjKey s3_obj_key, S3Obj s3_obj);
+extern void *S3PutObjectAsync(void *s3Client, const char *bucketPath,
+							  const char *objPath, char *data, uint32 size,
+							  int maxParts);
+extern bool S3PutObjectDone(void *asyncPut);
+extern void S3PutObjectWait(void *s3Client, void *asyncPut);
+extern void S3PutObjectCancelAll(void *s3Client);
 extern void S3DeleteObject(void *s3Client, char *objPath);
+extern void S3DeleteObjectList(void *s3Client, List *objPaths, int elevel);
+extern void S3DeletePrefix(void *s3Client, const char *prefix, int elevel);
 extern bool S3BucketExist(void *s3Client, const char *bucketName);
 extern void S3SetBucketId(char *id);
 
@@ -29,6 +29,7 @@ typedef struct DataDispatcher
 	uint64	fullXid;
 	uint64	seq;
 	bool	hasPlOrTigger;
+	uint64	catalogVersion;	/* of the catalog tuples the client holds */
 } DataDispatcher;
 
 #define MAX_CACHE_LEVEL 5
@@ -76,6 +77,7 @@ typedef struct CdbTableHtValue
 	Oid		relId;
 	int		tupleDataSize;
 	char   *tupleData;
+	List   *indexes;	/* MemoryHeapIndex built over tupleData, see memoryheapam.c */
 } CdbTableHtValue;
 
 typedef struct CdbCatalogNode
@@ -89,6 +91,8 @@ typedef struct CdbCatalogNode
 	char   *CatalogServerId;
 	List   *tableList;
 	char   *s3Url;
+	uint64	catalog_version;
+	bool	catalog_delta;	/* tableList only adds to an earlier version */
 } CdbCatalogNode;
 
 typedef struct CdbCatalogAuxNode
@@ -98,6 +102,7 @@ typedef struct CdbCatalogAuxNode
 	CdbCatalogNode *catalog;
 	AuxNode		   *aux;
 	PlannedStmt	   *plan;
+	bool			xact_finished;	/* catalog server committed with the reply */
 } CdbCatalogAuxNode;
 
 extern DataDispatcher *dataDispatcher;
@@ -106,6 +111,7 @@ typedef struct MemoryHeapData
 {
 	HTAB   *memTableHash;
 	uint64	fullxid;
+	uint64	catalogVersion;
 } MemoryHeapData;
 
 extern MemoryContext	dataDispatchCtx;
@@ -123,8 +129,12 @@ extern void DataDispatcherClear(void);
 extern HeapTuple CdbGetTuple(HeapTuple heapTuple);
 extern AuxNode *GetAuxNode(void);
 extern CdbCatalogNode *GetCatalogNode(void);
+extern void CatalogNodeMakeDelta(CdbCatalogNode *catalog);
 extern AuxNode **GetAuxNodeArray(int gangSize);
 
+extern char *DataDispatcherCopyCatalog(MemoryContext ctx, int *size);
+extern void DataDispatcherAddTuples(char *data, int size);
+
 extern void FreeCacheTuples(CacheNode *cacheNode);
 extern HeapTuple TupleDataGetNext(char *tuple_data, int *curIndex, int len);
 
@@ -255,6 +255,9 @@ extern List    *gp_guc_list_for_no_plan;
 extern List *gp_guc_restore_list;
 extern bool gp_guc_need_restore;
 
+/* bumped whenever a setting changes value, see guc.c */
+extern uint64 GUCChangeCounter;
+
 /* GUC vars that are actually declared in guc.c, rather than elsewhere */
 extern bool log_duration;
 extern bool Debug_print_plan;
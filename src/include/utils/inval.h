@@ -22,6 +22,7 @@
 typedef void (*SyscacheCallbackFunction) (Datum arg, int cacheid, uint32 hashvalue);
 typedef void (*RelcacheCallbackFunction) (Datum arg, Oid relid);
 
+extern uint64 LocalInvalidationCounter;
 
 extern void AcceptInvalidationMessages(void);
 
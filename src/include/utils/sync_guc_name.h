@@ -159,6 +159,13 @@
 		"temp_buffers",
 		"temp_tablespaces",
 		"test_copy_qd_qe_split",
+		"tile_block_assignment",
+		"tile_compresslevel",
+		"tile_compresstype",
+		"tile_merge_threshold",
+		"tile_prefetch_blocks",
+		"tile_sort_key",
+		"tile_upload_parts",
 		"TimeZone",
 		"timezone_abbreviations",
 		"trace_syncscan",
@@ -25,6 +25,9 @@
 		"block_size",
 		"bonjour",
 		"bonjour_name",
+		"catalog_plan_cache_size",
+		"catalog_sequence_lease_max",
+		"catalog_server_early_commit",
 		"catalog_server_host",
 		"catalog_server_id",
 		"catalog_server_port",
@@ -495,6 +498,11 @@
 		"shared_buffers",
 		"shared_memory_type",
 		"shared_preload_libraries",
+		"s3_connect_timeout",
+		"s3_max_connections",
+		"s3_max_retries",
+		"s3_request_timeout",
+		"s3_retry_delay",
 		"s3_url",
 		"sql_inheritance",
 		"ssl",
@@ -524,6 +532,8 @@
 		"temp_file_limit",
 		"test_AppendOnlyHash_eviction_vs_just_marking_not_inuse",
 		"test_print_direct_dispatch_info",
+		"tile_cache_directory",
+		"tile_cache_size",
 		"trace_lock_oidmin",
 		"trace_locks",
 		"trace_lock_table",
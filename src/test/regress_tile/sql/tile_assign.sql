@@ -0,0 +1,35 @@
+--
+-- tile_block_assignment spreads the blocks of a scan over the segments.
+-- Every mode must have each block read exactly once.
+--
+CREATE TABLE tile_assign (a int, b text);
+DO $$
+BEGIN
+  FOR n IN 1..30 LOOP
+    INSERT INTO tile_assign SELECT g, repeat('x', n * 10)
+    FROM generate_series(n * 100 - 99, n * 100 - 100 + n * 3) g;
+  END LOOP;
+END $$;
+SELECT visirelid::regclass AS visi FROM pg_tile
+WHERE mainrelid = 'tile_assign'::regclass \gset
+SELECT count(*) >= 30 AS blocks, sum(tupnum) FROM :visi;
+SET tile_block_assignment = size;
+SELECT count(*), count(DISTINCT a), sum(a), sum(length(b)) FROM tile_assign;
+SELECT length(b) / 10 AS n, count(*) FROM tile_assign GROUP BY 1 HAVING count(*) <> min(length(b)) / 10 * 3;
+SET tile_block_assignment = hash;
+SELECT count(*), count(DISTINCT a), sum(a), sum(length(b)) FROM tile_assign;
+SELECT length(b) / 10 AS n, count(*) FROM tile_assign GROUP BY 1 HAVING count(*) <> min(length(b)) / 10 * 3;
+SET tile_block_assignment = dynamic;
+SELECT count(*), count(DISTINCT a), sum(a), sum(length(b)) FROM tile_assign;
+SELECT length(b) / 10 AS n, count(*) FROM tile_assign GROUP BY 1 HAVING count(*) <> min(length(b)) / 10 * 3;
+-- a rescanned dynamic scan reads every block again
+SET enable_material = off;
+SET enable_hashjoin = off;
+SET enable_mergejoin = off;
+SELECT count(*), sum(x), sum(a) FROM generate_series(0, 2) s(x), tile_assign
+WHERE a % 3 = x;
+RESET enable_material;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET tile_block_assignment;
+DROP TABLE tile_assign;
@@ -0,0 +1,24 @@
+--
+-- Tile TIDs name a block by the TID of its visibility tuple. Put more
+-- than 256 visibility tuples on one page and modify the blocks past
+-- line pointer 256. point has no btree opclass, which keeps the zone
+-- maps, and so the visibility tuples, small.
+--
+CREATE TABLE tile_blockid (p point);
+DO $$
+BEGIN
+  FOR n IN 1..600 LOOP
+    INSERT INTO tile_blockid VALUES (point(n, n));
+  END LOOP;
+END $$;
+SELECT visirelid::regclass AS visi FROM pg_tile
+WHERE mainrelid = 'tile_blockid'::regclass \gset
+SELECT count(*) > 256 AS packed FROM :visi WHERE (ctid::text::point)[0] = 0;
+DELETE FROM tile_blockid WHERE p[0]::int % 3 = 0;
+UPDATE tile_blockid SET p = point(p[0], -p[1]) WHERE p[0]::int % 3 = 1;
+SELECT count(*), sum(p[0]), sum(p[1]) FROM tile_blockid;
+SELECT p FROM tile_blockid WHERE p[0] IN (297, 298, 299, 598, 599, 600) ORDER BY p[0];
+VACUUM tile_blockid;
+SELECT count(*), sum(p[0]), sum(p[1]) FROM tile_blockid;
+SELECT p FROM tile_blockid WHERE p[0] IN (297, 298, 299, 598, 599, 600) ORDER BY p[0];
+DROP TABLE tile_blockid;
@@ -0,0 +1,44 @@
+--
+-- B-tree indexes on tile tables are built and kept in the catalog server
+-- cluster, which indexes the blocks this cluster writes as they are
+-- committed. Plans built for this cluster must not use them.
+--
+CREATE TABLE tile_index (a int, b int, c text);
+DO $$
+BEGIN
+  FOR n IN 1..5 LOOP
+    INSERT INTO tile_index SELECT g, g % 10, 'row ' || g
+    FROM generate_series(n * 200 - 199, n * 200) g;
+  END LOOP;
+END $$;
+UPDATE tile_index SET c = 'updated' WHERE a % 100 = 0;
+DELETE FROM tile_index WHERE a % 100 = 1;
+-- index build
+CREATE INDEX tile_index_a ON tile_index (a);
+CREATE INDEX tile_index_bc ON tile_index (b, c);
+SELECT indexrelid::regclass, indisvalid, indisready FROM pg_index
+WHERE indrelid = 'tile_index'::regclass ORDER BY 1;
+CREATE UNIQUE INDEX tile_index_unique ON tile_index (a);
+-- index and index-only scan candidates
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+EXPLAIN (COSTS OFF)
+SELECT a, b, c FROM tile_index WHERE a BETWEEN 99 AND 102 ORDER BY a;
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM tile_index WHERE b = 0 AND c = 'updated';
+SELECT a, b, c FROM tile_index WHERE a BETWEEN 99 AND 102 ORDER BY a;
+SELECT a FROM tile_index WHERE a < 5 ORDER BY a;
+SELECT count(*) FROM tile_index WHERE b = 0 AND c = 'updated';
+SELECT count(*), min(a), max(a) FROM tile_index WHERE a > 900;
+-- DML on an indexed tile table
+INSERT INTO tile_index VALUES (1001, 1, 'new');
+UPDATE tile_index SET c = 'changed' WHERE a = 2;
+DELETE FROM tile_index WHERE a = 3;
+SELECT a, b, c FROM tile_index WHERE a BETWEEN 99 AND 102 ORDER BY a;
+SELECT a FROM tile_index WHERE a < 5 ORDER BY a;
+SELECT a, b, c FROM tile_index WHERE a IN (2, 3, 1001) ORDER BY a;
+SELECT count(*), min(a), max(a) FROM tile_index WHERE a > 900;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+SELECT count(*) FROM tile_index;
+DROP TABLE tile_index;
@@ -0,0 +1,44 @@
+--
+-- Statements run twice, so that the second run uses the plan the catalog
+-- server has cached. The date literal is read under the DateStyle of the
+-- session, so a plan kept across a change of it returns the wrong row.
+--
+CREATE TABLE tile_plancache (a int, d date);
+INSERT INTO tile_plancache VALUES (1, '2020-03-04'), (2, '2020-04-03');
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+SET datestyle = 'ISO, DMY';
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+RESET datestyle;
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+-- settings restored at transaction end
+BEGIN;
+SET LOCAL datestyle = 'ISO, DMY';
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+COMMIT;
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+BEGIN;
+SET LOCAL datestyle = 'ISO, DMY';
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+ROLLBACK;
+SELECT a FROM tile_plancache WHERE d = '03/04/2020';
+-- catalog changes between runs
+SELECT * FROM tile_plancache WHERE a = 1 ORDER BY d;
+SELECT * FROM tile_plancache WHERE a = 1 ORDER BY d;
+ALTER TABLE tile_plancache ADD COLUMN b int DEFAULT 5;
+SELECT * FROM tile_plancache WHERE a = 1 ORDER BY d;
+INSERT INTO tile_plancache VALUES (1, '2020-05-06', 6);
+SELECT * FROM tile_plancache WHERE a = 1 ORDER BY d;
+CREATE INDEX tile_plancache_a ON tile_plancache (a);
+SELECT * FROM tile_plancache WHERE a = 1 ORDER BY d;
+DELETE FROM tile_plancache WHERE a = 3;
+DELETE FROM tile_plancache WHERE a = 3;
+-- a cached statement must still fail in an aborted transaction block
+BEGIN;
+SELECT 1 / 0;
+SELECT count(*) FROM tile_plancache;
+DELETE FROM tile_plancache WHERE a = 3;
+ROLLBACK;
+SELECT count(*) FROM tile_plancache;
+DROP TABLE tile_plancache;
@@ -0,0 +1,29 @@
+--
+-- nextval() in a statement on a tile table runs on the compute cluster,
+-- which leases values from the catalog server and reports the ones it
+-- returned with its next statement. currval(), lastval() and setval() run
+-- on the catalog server and must still see every value.
+--
+CREATE SEQUENCE tile_seq;
+CREATE TABLE tile_seq_tab (a int, b bigint DEFAULT nextval('tile_seq'));
+INSERT INTO tile_seq_tab SELECT g FROM generate_series(1, 1000) g;
+SELECT currval('tile_seq'), lastval();
+SELECT count(DISTINCT b), min(b), max(b) FROM tile_seq_tab;
+SELECT setval('tile_seq', 5000);
+INSERT INTO tile_seq_tab SELECT g FROM generate_series(1001, 1010) g;
+SELECT currval('tile_seq'), lastval();
+SELECT min(b), max(b) FROM tile_seq_tab WHERE a > 1000;
+-- leases are not bounded by CACHE
+CREATE SEQUENCE tile_seq_cached CACHE 20;
+INSERT INTO tile_seq_tab SELECT g, nextval('tile_seq_cached')
+FROM generate_series(2001, 2100) g;
+SELECT currval('tile_seq_cached'), lastval();
+SELECT count(DISTINCT b), min(b), max(b) FROM tile_seq_tab WHERE a > 2000;
+DELETE FROM tile_seq_tab WHERE a > 2000;
+DROP SEQUENCE tile_seq_cached;
+ALTER SEQUENCE tile_seq RESTART WITH 100;
+INSERT INTO tile_seq_tab VALUES (1011);
+SELECT b FROM tile_seq_tab WHERE a = 1011;
+SELECT currval('tile_seq');
+DROP TABLE tile_seq_tab;
+DROP SEQUENCE tile_seq;
@@ -0,0 +1,30 @@
+--
+-- tile_sort_key sorts the rows an insert writes. Tile TIDs order the rows
+-- of a block, whose id is the TID's block number over 16.
+--
+CREATE TABLE tile_sort (k int, v text);
+CREATE TABLE tile_nosort (k int, v text);
+CREATE VIEW tile_sort_descents AS
+SELECT 'tile_sort' AS tab, count(*) FILTER (WHERE prev > k) AS descents, count(*)
+FROM (SELECT k, lag(k) OVER (PARTITION BY floor((ctid::text::point)[0] / 16)
+                             ORDER BY ctid) AS prev
+      FROM tile_sort) s
+UNION ALL
+SELECT 'tile_nosort', count(*) FILTER (WHERE prev > k), count(*)
+FROM (SELECT k, lag(k) OVER (PARTITION BY floor((ctid::text::point)[0] / 16)
+                             ORDER BY ctid) AS prev
+      FROM tile_nosort) s;
+SET tile_sort_key = 'k';
+INSERT INTO tile_sort SELECT g, 'row ' || g FROM generate_series(1000, 1, -1) g;
+RESET tile_sort_key;
+INSERT INTO tile_nosort SELECT g, 'row ' || g FROM generate_series(1000, 1, -1) g;
+SELECT tab, descents > 0 AS unsorted, count FROM tile_sort_descents ORDER BY tab DESC;
+-- a text key, whose order matches that of k here
+SET tile_sort_key = 'v';
+INSERT INTO tile_sort SELECT g, 'row ' || g FROM generate_series(2000, 1001, -1) g;
+RESET tile_sort_key;
+SELECT tab, descents > 0 AS unsorted, count FROM tile_sort_descents ORDER BY tab DESC;
+SELECT count(*), min(k), max(k), count(DISTINCT v) FROM tile_sort;
+DROP VIEW tile_sort_descents;
+DROP TABLE tile_sort;
+DROP TABLE tile_nosort;
@@ -0,0 +1,45 @@
+--
+-- Subtransactions that abort while a tile scan is reading ahead.
+--
+CREATE TABLE tile_subxact (a int, b text);
+DO $$
+BEGIN
+  FOR n IN 1..20 LOOP
+    INSERT INTO tile_subxact SELECT g, repeat('x', 100)
+    FROM generate_series(n * 100 - 99, n * 100) g;
+  END LOOP;
+END $$;
+-- the error leaves the scan's reads ahead in flight
+DO $$
+BEGIN
+  BEGIN
+    PERFORM 1 / (a - 1000) FROM tile_subxact;
+  EXCEPTION WHEN division_by_zero THEN
+    RAISE NOTICE 'caught division by zero';
+  END;
+END $$;
+-- block changes of a subtransaction that aborts are not published
+DO $$
+BEGIN
+  INSERT INTO tile_subxact VALUES (3001, 'kept');
+  BEGIN
+    INSERT INTO tile_subxact VALUES (3002, 'rolled back');
+    DELETE FROM tile_subxact WHERE a <= 100;
+    UPDATE tile_subxact SET b = 'rolled back' WHERE a = 200;
+    RAISE EXCEPTION 'roll back';
+  EXCEPTION WHEN raise_exception THEN
+    NULL;
+  END;
+  BEGIN
+    INSERT INTO tile_subxact VALUES (3003, 'kept');
+  END;
+END $$;
+SELECT a, b FROM tile_subxact WHERE a > 3000 OR b <> repeat('x', 100) ORDER BY a;
+SELECT count(*) FROM tile_subxact;
+BEGIN;
+SAVEPOINT s1;
+DECLARE c CURSOR FOR SELECT a FROM tile_subxact ORDER BY a;
+FETCH 2 FROM c;
+ROLLBACK TO SAVEPOINT s1;
+SELECT count(*) FROM tile_subxact;
+COMMIT;
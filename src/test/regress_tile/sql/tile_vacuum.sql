@@ -0,0 +1,26 @@
+--
+-- VACUUM merges small blocks into bigger ones and removes the objects of
+-- the blocks merged away.
+--
+CREATE TABLE tile_vacuum (a int, b int);
+DO $$
+BEGIN
+  FOR n IN 1..40 LOOP
+    INSERT INTO tile_vacuum VALUES (n, 1), (n, 2);
+  END LOOP;
+END $$;
+DELETE FROM tile_vacuum WHERE b = 2 AND a % 2 = 0;
+SELECT visirelid::regclass AS visi FROM pg_tile
+WHERE mainrelid = 'tile_vacuum'::regclass \gset
+SELECT count(*), sum(a), sum(b) FROM tile_vacuum;
+SELECT count(*) AS blocks, sum(tupnum) AS tuples FROM :visi;
+VACUUM tile_vacuum;
+SELECT count(*), sum(a), sum(b) FROM tile_vacuum;
+SELECT count(*) AS blocks, sum(tupnum) AS tuples FROM :visi;
+-- the merged block can be modified and vacuumed again
+DELETE FROM tile_vacuum WHERE a <= 10;
+UPDATE tile_vacuum SET b = 3 WHERE a > 30;
+VACUUM tile_vacuum;
+SELECT count(*), sum(a), sum(b) FROM tile_vacuum;
+SELECT count(*) AS blocks, sum(tupnum) AS tuples FROM :visi;
+DROP TABLE tile_vacuum;
@@ -0,0 +1,60 @@
+--
+-- Blocks whose zone maps show that no row can match the qual are skipped.
+-- Each count is taken twice: from a scan that may skip blocks, and with a
+-- FILTER over a scan that cannot, so both must agree.
+--
+CREATE TABLE tile_zonemap (a int, c int, d text COLLATE "C");
+INSERT INTO tile_zonemap SELECT g, NULL, 'apple' || g
+FROM generate_series(1, 100) g;
+INSERT INTO tile_zonemap SELECT g, g % 7, 'Banana' || g
+FROM generate_series(101, 200) g;
+INSERT INTO tile_zonemap SELECT g, CASE WHEN g % 2 = 0 THEN g END, 'cherry' || g
+FROM generate_series(201, 300) g;
+ALTER TABLE tile_zonemap ADD COLUMN e int DEFAULT 7;
+INSERT INTO tile_zonemap SELECT g, g, 'date' || g, g
+FROM generate_series(301, 400) g;
+-- range and equality
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a BETWEEN 150 AND 250),
+       count(*) FILTER (WHERE a BETWEEN 150 AND 250) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a < 101),
+       count(*) FILTER (WHERE a < 101) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a >= 400),
+       count(*) FILTER (WHERE a >= 400) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a > 400),
+       count(*) FILTER (WHERE a > 400) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a = 42),
+       count(*) FILTER (WHERE a = 42) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE 42 = a),
+       count(*) FILTER (WHERE 42 = a) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a + 0 = 42),
+       count(*) FILTER (WHERE a + 0 = 42) FROM tile_zonemap;
+-- NULL tests and NULLs among the values
+SELECT (SELECT count(*) FROM tile_zonemap WHERE c IS NULL),
+       count(*) FILTER (WHERE c IS NULL) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE c IS NOT NULL),
+       count(*) FILTER (WHERE c IS NOT NULL) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE c = 3),
+       count(*) FILTER (WHERE c = 3) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE c > 250),
+       count(*) FILTER (WHERE c > 250) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE a > 250 AND c IS NULL),
+       count(*) FILTER (WHERE a > 250 AND c IS NULL) FROM tile_zonemap;
+-- the bounds of d are in its collation, "C"
+SELECT (SELECT count(*) FROM tile_zonemap WHERE d < 'b'),
+       count(*) FILTER (WHERE d < 'b') FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE d < 'b' COLLATE "POSIX"),
+       count(*) FILTER (WHERE d < 'b' COLLATE "POSIX") FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE d >= 'c'),
+       count(*) FILTER (WHERE d >= 'c') FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE d = 'Banana150'),
+       count(*) FILTER (WHERE d = 'Banana150') FROM tile_zonemap;
+-- a column added after the first blocks were written
+SELECT (SELECT count(*) FROM tile_zonemap WHERE e = 7),
+       count(*) FILTER (WHERE e = 7) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE e > 350),
+       count(*) FILTER (WHERE e > 350) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE e IS NULL),
+       count(*) FILTER (WHERE e IS NULL) FROM tile_zonemap;
+SELECT (SELECT count(*) FROM tile_zonemap WHERE e IS NOT NULL),
+       count(*) FILTER (WHERE e IS NOT NULL) FROM tile_zonemap;
+DROP TABLE tile_zonemap;